@@ -0,0 +1,152 @@
+// Measures what the card-marking write barrier costs on code that mostly
+// stores pointers, by running the same list operations over nodes whose
+// links have no barrier and over nodes whose links have one:
+//
+//  - reverse: reverses a list in place, which is nothing but pointer
+//    stores;
+//  - append: copies one list onto the front of another, as in
+//    test/linked_list.h, which allocates a node per store.
+//
+// Usage: precisepp-bench-barrier [length] [rounds]
+
+// The standard headers come first, because logger.h defines `log`.
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+#include "precisepp/gc.h"
+
+template <typename Barrier>
+struct node
+{
+    using link_t = gc::traced_ptr<node, std::allocator<gc::Traced<node>>,
+                                  Barrier>;
+
+    node(long f, link_t r) : first{f}, rest{r} { }
+
+    long first;
+    link_t rest;
+};
+
+template <typename Barrier>
+DEFINE_TRACEABLE(node<Barrier>) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const node<Barrier>& n)
+    {
+        TRACE(n.rest);
+    }
+};
+
+template <typename Barrier>
+using list = typename node<Barrier>::link_t;
+
+template <typename Barrier>
+list<Barrier> cons(long first, list<Barrier> rest)
+{
+    return gc::make_traced<node<Barrier>>(first, std::move(rest));
+}
+
+template <typename Barrier>
+list<Barrier> iota(size_t length)
+{
+    list<Barrier> result;
+    for (size_t i = length; i > 0; --i)
+        result = cons<Barrier>(long(i), result);
+    return result;
+}
+
+template <typename Barrier>
+void reverse(list<Barrier>& lst)
+{
+    list<Barrier> done;
+    while (lst) {
+        list<Barrier> next = lst->rest;
+        lst->rest = done;
+        done = lst;
+        lst = next;
+    }
+    lst = done;
+}
+
+template <typename Barrier>
+list<Barrier> append(list<Barrier> before, list<Barrier> after)
+{
+    if (!before) return after;
+
+    auto new_node = cons<Barrier>(before->first, nullptr);
+    auto result = new_node;
+    before = before->rest;
+
+    while (before) {
+        new_node->rest = cons<Barrier>(before->first, nullptr);
+        new_node = new_node->rest;
+        before = before->rest;
+    }
+
+    new_node->rest = after;
+
+    return result;
+}
+
+// Runs `f` `rounds` times and returns the nanoseconds per list element.
+template <typename F>
+double time_ns(size_t length, size_t rounds, F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; ++i) f();
+    auto stop  = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / double(length * rounds);
+}
+
+struct Result
+{
+    double reverse_ns;
+    double append_ns;
+};
+
+template <typename Barrier>
+Result run(size_t length, size_t rounds)
+{
+    Result result;
+    list<Barrier> lst = iota<Barrier>(length);
+
+    result.reverse_ns = time_ns(length, rounds, [&] {
+        reverse<Barrier>(lst);
+    });
+
+    list<Barrier> tail = iota<Barrier>(4);
+    result.append_ns = time_ns(length, rounds, [&] {
+        list<Barrier> copy = append<Barrier>(lst, tail);
+        if (copy->first < 0) std::abort();   // Keep the copy.
+    });
+
+    lst = nullptr;
+    tail = nullptr;
+    gc::Collector::instance().collect();
+    return result;
+}
+
+static void report(const char* what, double without, double with)
+{
+    std::cout << what << ": " << without << " ns/op without barrier, "
+              << with << " ns/op with, "
+              << (with / without - 1) * 100 << "% overhead\n";
+}
+
+int main(int argc, char* argv[])
+{
+    size_t length = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100'000;
+    size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 50;
+
+    // Once each to warm up the spaces, then for real.
+    run<gc::no_barrier>(length, 1);
+    run<gc::card_marking_barrier>(length, 1);
+    Result without = run<gc::no_barrier>(length, rounds);
+    Result with    = run<gc::card_marking_barrier>(length, rounds);
+
+    std::cout << length << " elements, " << rounds << " rounds\n";
+    report("reverse", without.reverse_ns, with.reverse_ns);
+    report("append ", without.append_ns,  with.append_ns);
+}
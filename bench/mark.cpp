@@ -0,0 +1,81 @@
+// Times collections of a large random graph, where marking is dominated by
+// cache misses: each node has a few edges to nodes chosen at random, and
+// nodes are allocated in an order unrelated to how they’re reached.
+//
+// Usage: precisepp-bench-mark [nodes] [edges per node] [collections]
+
+// The standard headers come first, because logger.h defines `log`.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "precisepp/gc.h"
+#include "precisepp/stl/array.h"
+
+static constexpr size_t max_edges = 4;
+
+struct graph_node
+{
+    std::array<gc::traced_ptr<graph_node>, max_edges> edges;
+    size_t payload[4];
+};
+
+GC_TRACE_FIELDS(graph_node, edges);
+
+int main(int argc, char* argv[])
+{
+    size_t nodes       = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                  : 4'000'000;
+    size_t edges       = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2;
+    size_t collections = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 5;
+    edges = std::min(std::max(edges, size_t(1)), max_edges);
+
+    std::mt19937_64 rng{42};
+    auto& collector = gc::Collector::instance();
+
+    gc::traced_ptr<graph_node> root;
+    {
+        std::vector<gc::traced_ptr<graph_node>> all;
+        all.reserve(nodes);
+        for (size_t i = 0; i < nodes; ++i)
+            all.push_back(gc::make_traced<graph_node>());
+
+        // A random Hamiltonian path makes every node reachable from the
+        // root; the other edges are uniformly random.
+        std::vector<size_t> order(nodes);
+        for (size_t i = 0; i < nodes; ++i) order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+
+        std::uniform_int_distribution<size_t> pick{0, nodes - 1};
+        for (size_t i = 0; i < nodes; ++i) {
+            graph_node& node = *all[order[i]];
+            if (i + 1 < nodes) node.edges[0] = all[order[i + 1]];
+            for (size_t e = 1; e < edges; ++e)
+                node.edges[e] = all[pick(rng)];
+        }
+
+        root = all[order[0]];
+    }
+
+    // The first collection also clears out the allocation’s leftovers.
+    collector.collect();
+
+    double total_ms = 0;
+    for (size_t i = 0; i < collections; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        collector.collect();
+        auto stop  = std::chrono::steady_clock::now();
+        double ms  = std::chrono::duration<double, std::milli>(stop - start)
+                             .count();
+        total_ms += ms;
+        std::cout << "collection " << i << ": " << ms << " ms\n";
+    }
+
+    std::cout << nodes << " nodes, " << edges << " edges each: "
+              << total_ms / collections << " ms per collection, "
+              << total_ms / collections * 1e6 / nodes << " ns per node\n";
+}
@@ -0,0 +1,235 @@
+#include "Allocation_profiler.h"
+#include "Heap_dump.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define PRECISEPP_BACKTRACE 1
+#endif
+
+namespace gc
+{
+
+namespace detail
+{
+
+Sampling_state sampling{std::numeric_limits<std::ptrdiff_t>::max(), 0};
+
+} // end namespace detail
+
+namespace
+{
+
+// The most return addresses a sample keeps.
+constexpr int max_frames = 16;
+
+// The profiler’s own frame, which every backtrace starts with.
+constexpr int skipped_frames = 1;
+
+} // end anonymous namespace
+
+using detail::sampling;
+
+Allocation_profiler& Allocation_profiler::instance()
+{
+    static Allocation_profiler profiler;
+    return profiler;
+}
+
+Allocation_profiler::Allocation_profiler()
+        : running_{false}
+        , mean_interval_{0}
+        , backtraces_{false}
+        , random_{0x9E3779B97F4A7C15}
+        , tag_{nullptr}
+{ }
+
+bool Allocation_profiler::Site::operator<(const Site& other) const
+{
+    if (type != other.type) return type->before(*other.type);
+    if (tag != other.tag) return std::less<const char*>{}(tag, other.tag);
+    return frames < other.frames;
+}
+
+void Allocation_profiler::start(size_t mean_interval, bool backtraces)
+{
+    running_       = true;
+    mean_interval_ = double(std::max(mean_interval, size_t(1)));
+    backtraces_    = backtraces;
+    sampling.bytes_until_sample = next_interval_();
+}
+
+void Allocation_profiler::stop()
+{
+    running_ = false;
+    sampling.bytes_until_sample = std::numeric_limits<std::ptrdiff_t>::max();
+}
+
+void Allocation_profiler::reset()
+{
+    sites_.clear();
+    live_.clear();
+    collections_.clear();
+    this_collection_ = Collection_stats{};
+    sampling.live_samples = 0;
+}
+
+std::ptrdiff_t Allocation_profiler::next_interval_()
+{
+    random_ ^= random_ >> 12;
+    random_ ^= random_ << 25;
+    random_ ^= random_ >> 27;
+    uint64_t bits = random_ * 0x2545F4914F6CDD1D;
+
+    // A uniform draw from (0, 1], turned into an exponential one.
+    double u = (double(bits >> 11) + 1) / 9007199254740992.0;
+    double interval = -std::log(u) * mean_interval_;
+    return std::ptrdiff_t(std::min(interval, 1e15));
+}
+
+void Allocation_profiler::sample_(const std::type_info& type, size_t size,
+                                  const void* ptr)
+{
+    // The countdown only runs out while stopped after ~2^63 bytes.
+    if (!running_) {
+        stop();
+        return;
+    }
+
+    sampling.bytes_until_sample = next_interval_();
+
+    Site site{&type, tag_, {}};
+#ifdef PRECISEPP_BACKTRACE
+    if (backtraces_) {
+        void* frames[max_frames + skipped_frames];
+        int n = backtrace(frames, max_frames + skipped_frames);
+        if (n > skipped_frames)
+            site.frames.assign(frames + skipped_frames, frames + n);
+    }
+#endif
+
+    // An object of `size` bytes is sampled with probability
+    // 1 - exp(-size / mean_interval_), so it stands for 1/that objects.
+    double weight = 1 / -std::expm1(-double(size) / mean_interval_);
+
+    Site_stats& stats = sites_[std::move(site)];
+    ++stats.samples;
+    stats.objects += weight;
+    stats.bytes   += weight * double(size);
+
+    // A slot is only reused once it has been swept, so any sample already
+    // at this address was missed dying (say, by a `reset` in between).
+    live_[ptr] = Sample{&stats, size, weight};
+    sampling.live_samples = live_.size();
+}
+
+void Allocation_profiler::death_(const void* ptr)
+{
+    auto found = live_.find(ptr);
+    if (found == live_.end()) return;
+
+    const Sample& sample = found->second;
+    double bytes = sample.weight * double(sample.size);
+    ++sample.site->deaths;
+    sample.site->dead_bytes += bytes;
+    ++this_collection_.deaths;
+    this_collection_.dead_bytes += bytes;
+
+    live_.erase(found);
+    sampling.live_samples = live_.size();
+}
+
+void Allocation_profiler::collected_()
+{
+    if (!running_ && sampling.live_samples == 0
+            && this_collection_.deaths == 0)
+        return;
+    collections_.push_back(this_collection_);
+    this_collection_ = Collection_stats{};
+}
+
+void Allocation_profiler::report(std::ostream& out) const
+{
+    using detail::type_name;
+
+    size_t samples = 0;
+    for (const auto& entry : sites_) samples += entry.second.samples;
+
+    out << "Allocation profile: " << samples << " samples, one per "
+        << size_t(mean_interval_) << " bytes on average, "
+        << collections_.size() << " collections\n";
+
+    // Totals by type, from the sites with that type.
+    std::map<std::string, Site_stats> types;
+    for (const auto& entry : sites_) {
+        Site_stats& stats = types[type_name(*entry.first.type)];
+        stats.samples    += entry.second.samples;
+        stats.deaths     += entry.second.deaths;
+        stats.bytes      += entry.second.bytes;
+        stats.objects    += entry.second.objects;
+        stats.dead_bytes += entry.second.dead_bytes;
+    }
+
+    auto write_stats = [&out](const Site_stats& stats) {
+        out << "  " << size_t(stats.bytes) << '\t' << size_t(stats.objects)
+            << '\t' << size_t(stats.dead_bytes) << '\t' << stats.samples
+            << '\t' << stats.deaths << '\t';
+    };
+
+    const char* columns = "(est. bytes, est. objects, est. bytes died,"
+                          " samples, sampled deaths)";
+
+    std::vector<const std::pair<const std::string, Site_stats>*> by_type;
+    for (const auto& entry : types) by_type.push_back(&entry);
+    std::sort(by_type.begin(), by_type.end(), [](auto a, auto b) {
+        return a->second.bytes > b->second.bytes;
+    });
+
+    out << "\nBy type " << columns << ":\n";
+    for (auto entry : by_type) {
+        write_stats(entry->second);
+        out << entry->first << '\n';
+    }
+
+    std::vector<const std::pair<const Site, Site_stats>*> by_site;
+    for (const auto& entry : sites_) by_site.push_back(&entry);
+    std::sort(by_site.begin(), by_site.end(), [](auto a, auto b) {
+        return a->second.bytes > b->second.bytes;
+    });
+
+    out << "\nBy call site " << columns << ":\n";
+    for (auto entry : by_site) {
+        const Site& site = entry->first;
+        write_stats(entry->second);
+        out << type_name(*site.type);
+        if (site.tag != nullptr) out << " [" << site.tag << ']';
+        out << '\n';
+
+#ifdef PRECISEPP_BACKTRACE
+        if (!site.frames.empty()) {
+            std::unique_ptr<char*, void (*)(void*)> symbols{
+                    backtrace_symbols(site.frames.data(),
+                                      int(site.frames.size())),
+                    std::free};
+            for (size_t i = 0; i < site.frames.size(); ++i)
+                out << "      "
+                    << (symbols ? symbols.get()[i] : "?") << '\n';
+        }
+#endif
+    }
+
+    out << "\nSampled deaths by collection (deaths, est. bytes died):\n";
+    for (size_t i = 0; i < collections_.size(); ++i)
+        out << "  " << i + 1 << '\t' << collections_[i].deaths << '\t'
+            << size_t(collections_[i].dead_bytes) << '\n';
+}
+
+} // end namespace gc
@@ -0,0 +1,188 @@
+// The `Allocation_profiler` samples allocations to find out which types and
+// call sites allocate the most, and how much of what they allocate dies in
+// each collection. It samples by bytes rather than by count: the gaps
+// between samples are exponentially distributed with a chosen mean, so
+// each allocated byte is equally likely to be sampled and the samples can
+// be scaled up to unbiased estimates.
+//
+// Each sample records the object’s type and size, the innermost
+// `Allocation_tag` in effect, and optionally a backtrace. Sampled objects
+// are then followed until a sweep finds them dead.
+//
+// Profiling costs nothing but a subtraction and a predictable branch per
+// allocation when it’s stopped, so it can be left compiled in:
+//
+//     auto& profiler = gc::Allocation_profiler::instance();
+//     profiler.start();
+//     {
+//         gc::Allocation_tag tag{"parse"};
+//         parse(input);
+//     }
+//     profiler.report(std::cerr);
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace gc
+{
+
+class Collector;
+class Allocation_profiler;
+
+namespace detail
+{
+
+// What the allocation and sweep paths check before calling into the
+// profiler. While the profiler is stopped, `bytes_until_sample` is so
+// large that it never runs out.
+struct Sampling_state
+{
+    std::ptrdiff_t bytes_until_sample;
+    size_t         live_samples;   // Sampled objects not yet found dead
+};
+
+extern Sampling_state sampling;
+
+inline void sample_allocation(const std::type_info&, size_t, const void*);
+inline void sample_death(const void*);
+
+} // end namespace detail
+
+class Allocation_profiler
+{
+public:
+    static Allocation_profiler& instance();
+
+    // Starts sampling, once per `mean_interval` bytes allocated on
+    // average. If `backtraces` is true, each sample records the return
+    // addresses of its callers (where the platform supports it).
+    void start(size_t mean_interval = 512 * 1024, bool backtraces = false);
+
+    // Stops sampling. Objects already sampled are still followed, and
+    // what was recorded is kept for `report`.
+    void stop();
+
+    bool running() const
+    {
+        return running_;
+    }
+
+    // Discards everything recorded so far.
+    void reset();
+
+    // Writes the estimated allocation by type, by call site, and the
+    // sampled deaths in each collection.
+    void report(std::ostream&) const;
+
+private:
+    // Where sampled objects were allocated: their type, the innermost tag,
+    // and the backtrace if recorded.
+    struct Site
+    {
+        const std::type_info* type;
+        const char*           tag;
+        std::vector<void*>    frames;
+
+        bool operator<(const Site&) const;
+    };
+
+    struct Site_stats
+    {
+        size_t samples = 0;        // Objects sampled
+        size_t deaths = 0;         // Of those, found dead
+        double bytes = 0;          // Estimated bytes allocated
+        double objects = 0;        // Estimated objects allocated
+        double dead_bytes = 0;     // Estimated bytes since collected
+    };
+
+    struct Sample
+    {
+        Site_stats* site;
+        size_t      size;
+        double      weight;        // How many objects this one stands for
+    };
+
+    // The sampled deaths found by one collection.
+    struct Collection_stats
+    {
+        size_t deaths = 0;
+        double dead_bytes = 0;
+    };
+
+    bool                 running_;
+    double               mean_interval_;
+    bool                 backtraces_;
+    uint64_t             random_;  // xorshift64* state
+    std::map<Site, Site_stats>               sites_;
+    std::unordered_map<const void*, Sample>  live_;
+    std::vector<Collection_stats>            collections_;
+    Collection_stats                         this_collection_;
+    const char*          tag_;     // Innermost `Allocation_tag`
+
+    Allocation_profiler();
+
+    // The number of bytes to the next sample.
+    std::ptrdiff_t next_interval_();
+
+    void sample_(const std::type_info&, size_t size, const void* ptr);
+    void death_(const void* ptr);
+    void collected_();
+
+    friend void detail::sample_allocation(const std::type_info&, size_t,
+                                          const void*);
+    friend void detail::sample_death(const void*);
+    friend class Collector;
+    friend class Allocation_tag;
+};
+
+// Tags the allocations sampled during its lifetime, so the profiler’s
+// report can tell call sites apart without backtraces. Tags nest; the
+// innermost wins. The tag string must outlive the profile.
+class Allocation_tag
+{
+public:
+    explicit Allocation_tag(const char* tag)
+            : outer_{Allocation_profiler::instance().tag_}
+    {
+        Allocation_profiler::instance().tag_ = tag;
+    }
+
+    ~Allocation_tag()
+    {
+        Allocation_profiler::instance().tag_ = outer_;
+    }
+
+    Allocation_tag(const Allocation_tag&) = delete;
+    Allocation_tag& operator=(const Allocation_tag&) = delete;
+
+private:
+    const char* outer_;
+};
+
+namespace detail
+{
+
+// Called by a space after allocating `size` bytes at `ptr`.
+inline void sample_allocation(const std::type_info& type, size_t size,
+                              const void* ptr)
+{
+    if ((sampling.bytes_until_sample -= std::ptrdiff_t(size)) < 0)
+        Allocation_profiler::instance().sample_(type, size, ptr);
+}
+
+// Called by a space when sweeping finds `ptr` dead.
+inline void sample_death(const void* ptr)
+{
+    if (sampling.live_samples != 0)
+        Allocation_profiler::instance().death_(ptr);
+}
+
+} // end namespace detail
+
+} // end namespace gc
@@ -0,0 +1,695 @@
+// An `Array_space<T>` manages variable-length arrays of one type, `T`. Each
+// array is a single block holding a `Traced_array<T>` followed by its
+// elements. Small arrays are allocated from pages segregated by size class,
+// and large arrays get a block to themselves in a `Large_object_space`. Like
+// `Typed_space`, it implements the interface `Space`, which the `Collector`
+// uses to manage it.
+#pragma once
+
+#include "forward.h"
+#include "Space.h"
+#include "Collector.h"
+#include "Large_object_space.h"
+#include "logger.h"
+#include "Root_registry.h"
+#include "Traced.h"
+#include "Trace_recorder.h"
+#include "traced_array.h"
+#include "Traceable.h"
+#include "Type_graph.h"
+#include "write_barrier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace gc {
+
+// The number of units (see below) in the first page of each size class.
+static constexpr size_t initial_array_page_units = 4096;
+
+template <typename T, typename Allocator>
+class Array_space : private detail::Space
+{
+public:
+    // Returns the singleton instance for allocating arrays of type `T`.
+    static Array_space& instance() noexcept
+    {
+        static Array_space instance_;
+        return instance_;
+    }
+
+    // Allocates an array of `size` objects of type `T`, constructing each
+    // element from the given arguments.
+    template <typename... Args>
+    traced_array<T, Allocator>
+    allocate(size_t size, const Args&... args)
+    {
+        // The block comes back holding one reference, which we adopt.
+        traced_array<T, Allocator> result;
+        result.ptr_ = allocate_(size, args...);
+        detail::record_store(&result, result.ptr_);
+        return result;
+    };
+
+    // Allocates an empty array with room for at least `capacity` elements,
+    // which can be added with `traced_array::emplace_back`.
+    traced_array<T, Allocator>
+    reserve(size_t capacity)
+    {
+        traced_array<T, Allocator> result;
+        result.ptr_ = allocate_block_(capacity);
+        detail::record_store(&result, result.ptr_);
+        return result;
+    }
+
+private:
+    friend struct detail::Image_type<Traced_array<T>>;
+
+    // The type of pointer we are managing.
+    using ptr_t = Traced_array<T>*;
+
+    // Produces a friendly error if the given allocator doesn’t actually
+    // allocate the right type.
+    static_assert(std::is_same<Traced_array<T>,
+                               typename Allocator::value_type>::value,
+                  "Invalid Allocator");
+
+    // Blocks are measured in *units* of `sizeof(Traced_array<T>)`, the first
+    // of which holds the block’s metadata. Size class `c` holds blocks of
+    // 2^c units.
+    static constexpr size_t unit_size_       = sizeof(Traced_array<T>);
+    static constexpr size_t max_small_units_ =
+            std::max(size_t(1), large_object_size / unit_size_);
+
+    static constexpr size_t ceil_log2_(size_t n)
+    {
+        size_t result = 0;
+        while ((size_t(1) << result) < n) ++result;
+        return result;
+    }
+
+    static constexpr size_t size_classes_ = ceil_log2_(max_small_units_) + 1;
+
+    // The free list and page list for one size class. Each page starts
+    // with a header unit, followed by its blocks.
+    struct Size_class
+    {
+        ptr_t  pages          = nullptr;
+        ptr_t  free_list      = nullptr;
+        size_t total_blocks   = 0;
+        size_t used_blocks    = 0;
+        size_t next_page_size = 0;
+    };
+
+    Allocator allocator_;      // For allocating size-class pages
+    Collector& collector_;     // The collector managing this space
+    size_t heap_size_;         // The capacity of this space, in elements
+    size_t live_size_;         // The capacity of used blocks, in elements
+    size_t page_bytes_;        // The memory in size-class pages
+    Size_class classes_[size_classes_];
+    detail::Large_object_space<Traced_array<T>> large_; // Large arrays
+    std::vector<ptr_t> finalize_queue_; // Dead, awaiting destruction
+    std::vector<ptr_t> quarantine_;     // Destroyed, awaiting poisoning
+
+    explicit Array_space(Collector& collector = Collector::instance())
+            : collector_{collector}
+            , heap_size_{0}
+            , live_size_{0}
+            , page_bytes_{0}
+    {
+        for (size_t c = 0; c < size_classes_; ++c)
+            classes_[c].next_page_size =
+                    std::max(size_t(1), initial_array_page_units >> c);
+
+        (void) &record_edges_;
+        collector_.register_space(*this);
+    }
+
+    // Never called: instantiating it records the type graph’s edges out of
+    // `Traced_array<T>` (see Type_graph.h).
+    static void record_edges_(ptr_t ptr)
+    {
+        ptr->trace_object_(detail::Edge_type_tracer<Traced_array<T>>{});
+    }
+
+    // The number of units needed for an array of `capacity` elements.
+    static size_t units_for_(size_t capacity)
+    {
+        return 1 + (capacity * sizeof(T) + unit_size_ - 1) / unit_size_;
+    }
+
+    // The number of elements that fit in a block of `units` units.
+    static size_t capacity_of_(size_t units)
+    {
+        return (units - 1) * unit_size_ / sizeof(T);
+    }
+
+    // The `i`th block of a page in size class `c`.
+    static ptr_t block_(ptr_t page, size_t c, size_t i)
+    {
+        return page + 1 + (i << c);
+    }
+
+    // Adds a new page to size class `c`, adding its blocks to the free list
+    // and doubling the page size for next time.
+    void add_page_(size_t c)
+    {
+        Size_class& sc = classes_[c];
+
+        log(debug2) << "add_page_(" << c << ")";
+        log(debug3) << "next_page_size = " << sc.next_page_size;
+
+        ptr_t page = allocator_.allocate(1 + (sc.next_page_size << c));
+        if (page == nullptr) throw std::bad_alloc{};
+        page_bytes_ += page_bytes_for_(c);
+        detail::add_heap_range(page, page_bytes_for_(c));
+
+        page[0].initialize_header_(sc.next_page_size, sc.pages);
+        sc.pages = page;
+
+        for (size_t i = 0; i < sc.next_page_size; ++i)
+            add_to_free_list_(c, block_(page, c, i));
+
+        sc.total_blocks += sc.next_page_size;
+        heap_size_      += sc.next_page_size * capacity_of_(size_t(1) << c);
+        sc.next_page_size *= 2;
+
+        log(debug2) << "heap_size_ = " << heap_size_;
+    }
+
+    // The memory in the next page of size class `c`.
+    size_t page_bytes_for_(size_t c) const
+    {
+        return (1 + (classes_[c].next_page_size << c)) * unit_size_;
+    }
+
+    // Adds a page to size class `c` because allocation needs one, as far as
+    // the heap limits allow (see `Collector::may_grow_`). Making room may
+    // free blocks instead.
+    void grow_(size_t c)
+    {
+        for (int attempt = 0;
+             !collector_.may_grow_(page_bytes_for_(c), attempt); ++attempt)
+            if (classes_[c].free_list != nullptr) return;
+
+        add_page_(c);
+    }
+
+    // Adds the given block to the free list of size class `c`, poisoning
+    // its elements if the collector is verifying.
+    void add_to_free_list_(size_t c, ptr_t ptr)
+    {
+        ptr->initialize_free_(classes_[c].free_list);
+        classes_[c].free_list = ptr;
+        if (collector_.verifying()) poison_block_(c, ptr);
+    }
+
+    // The bytes after the metadata of a block in size class `c`.
+    static size_t free_bytes_size_(size_t c)
+    {
+        return ((size_t(1) << c) - 1) * unit_size_;
+    }
+
+    // Poisons a free block in size class `c`, for heap verification.
+    static void poison_block_(size_t c, ptr_t ptr)
+    {
+        poison_link_(&ptr->next_free_());
+        poison_(ptr + 1, free_bytes_size_(c));
+    }
+
+    static bool is_block_poisoned_(size_t c, ptr_t ptr)
+    {
+        return is_link_poisoned_(&ptr->next_free_()) &&
+               is_poisoned_(ptr + 1, free_bytes_size_(c));
+    }
+
+    // Takes a block from size class `c`, collecting or adding the first
+    // page if its free list is empty. (If the collector declines to run, or
+    // `collect` is false, we grow instead.)
+    ptr_t allocate_small_(size_t c, bool collect = true)
+    {
+        Size_class& sc = classes_[c];
+
+        if (sc.free_list == nullptr) {
+            log(debug2) << "allocate_small_(" << c << "): free_list == nullptr";
+            if (sc.pages == nullptr || !collect) {
+                grow_(c);
+            } else {
+                collector_.collect_(this);
+                if (sc.free_list == nullptr) grow_(c);
+            }
+
+            assert(sc.free_list != nullptr);
+        }
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+        // As in `Typed_space::allocate_slot_`.
+        if (collector_.busy_) detail::apply_count_logs();
+#endif
+
+        ptr_t result = sc.free_list;
+        if (collector_.verifying() && !is_block_poisoned_(c, result))
+            Collector::verify_failed_("free block was written to",
+                                      typeid(T[]), result->elements_());
+        sc.free_list = sc.free_list->next_free_();
+        ++sc.used_blocks;
+        return result;
+    }
+
+    // Maps a block of its own for a large array, collecting first if we
+    // have allocated enough large arrays since the last collection (and
+    // `collect` is true).
+    ptr_t allocate_large_(size_t units, bool collect = true)
+    {
+        size_t bytes = units * unit_size_;
+
+        if (collect && large_.should_collect(bytes)) {
+            log(debug2) << "allocate_large_: going to collect";
+            collector_.collect_(this);
+        }
+
+        collector_.make_room_(bytes);
+        ptr_t result = large_.allocate(bytes);
+        result->size_class_ = Traced_array<T>::large_class;
+        heap_size_ += result->capacity_();
+        return result;
+    }
+
+    // Allocates a block with room for `capacity` elements, holding none
+    // yet. The resulting block holds one reference.
+    ptr_t allocate_block_(size_t capacity, bool collect = true)
+    {
+        log(debug4) << "allocate_block_(" << capacity << " elements)";
+
+        if (collect && detail::cycle_collector.full())
+            collector_.collect_cycles();
+
+        size_t units = units_for_(capacity);
+        size_t c     = ceil_log2_(units);
+
+        ptr_t result;
+        if (units > max_small_units_) {
+            result = allocate_large_(units, collect);
+            result->initialize_used_(Traced_array<T>::large_class);
+        } else {
+            result = allocate_small_(c, collect);
+            result->initialize_used_((unsigned char) c);
+        }
+
+        live_size_ += result->capacity_();
+        detail::record_allocate(typeid(T), result, result->elements_(),
+                                result->capacity_() * sizeof(T), false);
+
+        log(debug4) << "allocate_block_() == " << result->elements_()
+                    << " (live_size_ == " << live_size_ << ")";
+
+        return result;
+    }
+
+    // Allocates an array of `size` elements copied from a heap image,
+    // given their bytes, with their pointers still null (see
+    // Heap_image.h). The resulting block holds one reference. Nothing
+    // loaded can be garbage yet, so this grows rather than collecting.
+    ptr_t allocate_image_(const char* bytes, size_t size)
+    {
+        ptr_t result = allocate_block_(size, false);
+        std::memcpy(static_cast<void*>(result->elements_()), bytes,
+                    size * sizeof(T));
+        result->size_() = size;
+        return result;
+    }
+
+    // Allocates and initializes an array of `size` elements, each
+    // constructed from `args`. The resulting block holds one reference.
+    template <typename... Args>
+    ptr_t allocate_(size_t size, const Args&... args)
+    {
+        ptr_t result = allocate_block_(size);
+
+        // The block is reachable (by its reference count) while we construct
+        // its elements, and its size counts only the elements constructed so
+        // far, so it is safe for an element constructor to collect. If one
+        // throws we release the block.
+        T* elements = result->elements_();
+        try {
+            detail::Heap_construction construction{elements,
+                                                   size * sizeof(T)};
+            while (result->size_() < size) {
+                ::new(&elements[result->size_()]) T(args...);
+                ++result->size_();
+            }
+        } catch (...) {
+            bool large = result->large_();
+            deallocate_(result);
+            if (large) large_.deallocate(result);
+            throw;
+        }
+
+        return result;
+    }
+
+    static void destroy_elements_(ptr_t ptr)
+    {
+        T* elements = ptr->elements_();
+        for (size_t i = 0; i < ptr->size_(); ++i)
+            elements[i].~T();
+    }
+
+    // Destroys an array and deallocates its block. (A dead large array’s
+    // block was already queued for unmapping when it was swept.)
+    void deallocate_(ptr_t ptr)
+    {
+        size_t capacity = ptr->capacity_();
+        live_size_ -= capacity;
+        {
+            detail::Recording_pause pause;
+            destroy_elements_(ptr);
+        }
+        detail::record_deallocate(ptr);
+        if (ptr->large_())
+            heap_size_ -= capacity;
+        else
+            deallocate_small_(ptr->size_class_, ptr);
+    }
+
+    // Deallocates a dead array, or queues it for `finalize` if the collector
+    // batches finalization.
+    void sweep_dead_(ptr_t ptr)
+    {
+        if (collector_.finalization() == finalization_t::during_sweep)
+            deallocate_(ptr);
+        else
+            finalize_queue_.push_back(ptr);
+    }
+
+    // Returns a small block to the free list of size class `c`.
+    void deallocate_small_(size_t c, ptr_t ptr)
+    {
+        if (collector_.verifying()) {
+            // Quarantined until `release`, like `Typed_space`’s slots.
+            ptr->free_ = true;
+            quarantine_.push_back(ptr);
+        } else {
+            add_to_free_list_(c, ptr);
+        }
+        --classes_[c].used_blocks;
+    }
+
+    // Calls the given function on each used block in size class `c`.
+    template <typename F>
+    void for_class_(size_t c, F f)
+    {
+        for (ptr_t page = classes_[c].pages; page != nullptr;
+             page = page->next_page_()) {
+            for (size_t i = 0; i < page->page_size_(); ++i) {
+                ptr_t block = block_(page, c, i);
+                if (!block->free_)
+                    f(block);
+            }
+        }
+    }
+
+    // Calls the given function on each used block in the heap.
+    template <typename F>
+    void for_heap_(F f)
+    {
+        log(debug1) << "for_heap_()";
+        for (size_t c = 0; c < size_classes_; ++c)
+            for_class_(c, f);
+        large_.for_each(f);
+    }
+
+    // The remaining member functions are implementations of Space’s pure
+    // virtual members.
+
+    //
+    // Collection interface — the seven phases of collection (see Space.h)
+    //
+
+    // GC phase 1: Copies every ref_count_ to root_count_
+    void save_counts() override
+    {
+        for_heap_([](ptr_t ptr) {
+            ptr->merge_counts_();
+            ptr->root_count_() = ptr->ref_count_();
+        });
+    }
+
+    // GC phase 2: Decrements root_count_ for every in-edge coming from
+    // another Traced object. If `T` has no pointers there are none.
+    void find_roots() override
+    {
+        if (!contains_pointers<T>) return;
+
+        for_heap_([](ptr_t ptr) {
+            ptr->trace_object_(detail::Root_tracer{});
+        });
+    }
+
+    // GC phase 3: Marks the live heap, starting from each root.
+    void mark() override
+    {
+        for_heap_([](ptr_t ptr) {
+            if (ptr->root_count_() > 0)
+                mark_from_(ptr);
+        });
+    }
+
+    // Arrays keep their root counts inline.
+    void discard_root_counts() override
+    { }
+
+    // GC phase 4: There are no weak pointers to arrays.
+    void clear_weak() override
+    { }
+
+    // GC phase 5: Sweeps away the dead heap, deallocating (or queueing) dead
+    // arrays and resetting marks. Dead large arrays’ blocks are unmapped by
+    // `release`.
+    void sweep() override
+    {
+        for (size_t c = 0; c < size_classes_; ++c) {
+            for_class_(c, [this](ptr_t ptr) {
+                if (ptr->mark_)
+                    ptr->mark_ = false;
+                else
+                    sweep_dead_(ptr);
+            });
+        }
+
+        large_.sweep([this](ptr_t ptr) {
+            sweep_dead_(ptr);
+        });
+
+        for (size_t c = 0; c < size_classes_; ++c) {
+            const Size_class& sc = classes_[c];
+            if (sc.pages != nullptr &&
+                    double(sc.used_blocks) / sc.total_blocks > max_live_ratio &&
+                    collector_.may_grow_early_(page_bytes_for_(c)))
+                add_page_(c);
+        }
+    }
+
+    // GC phase 5, in parallel: Arrays are always swept serially.
+    void plan_sweep(detail::Sweep_tasks&) override
+    { }
+
+    // GC phase 6: Destroys and deallocates the arrays queued by `sweep`.
+    void finalize() override
+    {
+        for (ptr_t ptr : finalize_queue_)
+            deallocate_(ptr);
+        finalize_queue_.clear();
+    }
+
+    // GC phase 7: Unmaps dead large arrays, and frees (and poisons) the
+    // blocks quarantined while verifying.
+    void release() override
+    {
+        large_.release();
+        for (ptr_t ptr : quarantine_)
+            add_to_free_list_(ptr->size_class_, ptr);
+        quarantine_.clear();
+    }
+
+    void dump(detail::Heap_dump& dump) override
+    {
+        dump.space(typeid(T), "array", sizeof(T));
+        for_heap_([&dump](ptr_t ptr) {
+            ptr->trace_object_(dump.edge_tracer());
+            dump.object(ptr, sizeof(Traced_array<T>)
+                                     + ptr->capacity_() * sizeof(T),
+                        ptr->ref_count_(), ptr->root_count_());
+        });
+    }
+
+    // Heap verification: one step of checking the counts against the
+    // marks (see `Verify_step`).
+    void verify(detail::Verify_step step) override
+    {
+        using detail::Verify_step;
+
+        if (step == Verify_step::count_dead_refs && !contains_pointers<T>)
+            return;
+
+        for_heap_([step](ptr_t ptr) {
+            if (step == Verify_step::check_root_counts) {
+                if (ptr->root_count_() > ptr->ref_count_())
+                    Collector::verify_failed_(
+                            "root count underflowed; something traces a "
+                            "pointer to this array that it doesn’t count",
+                            typeid(T[]), ptr->elements_());
+                return;
+            }
+
+            if (ptr->marked_()) return;
+
+            switch (step) {
+            case Verify_step::save_counts:
+                ptr->root_count_() = ptr->ref_count_();
+                break;
+
+            case Verify_step::count_dead_refs:
+                ptr->trace_object_(detail::Unmarked_tracer{});
+                break;
+
+            case Verify_step::check_unmarked:
+                if (ptr->root_count_() > ptr->ref_count_())
+                    Collector::verify_failed_(
+                            "dead objects trace more pointers to this "
+                            "array than it counts",
+                            typeid(T[]), ptr->elements_());
+                if (ptr->root_count_() > 0)
+                    Collector::verify_failed_(
+                            "unmarked array is still referred to by a "
+                            "live object or root; is a TRACE missing?",
+                            typeid(T[]), ptr->elements_());
+                break;
+
+            default:
+                break;
+            }
+        });
+    }
+
+    void poison_free() override
+    {
+        for (size_t c = 0; c < size_classes_; ++c)
+            for (ptr_t ptr = classes_[c].free_list; ptr != nullptr;
+                 ptr = ptr->next_free_())
+                poison_block_(c, ptr);
+    }
+
+    const std::type_info& traced_type() const override
+    {
+        return typeid(Traced_array<T>);
+    }
+
+    bool count_dropped() const override
+    {
+        return detail::Count_dropped<Traced_array<T>>::value;
+    }
+
+    void clear_count_dropped() override
+    {
+        detail::Count_dropped<Traced_array<T>>::value = false;
+    }
+
+    size_t heap_bytes() const override
+    {
+        return page_bytes_ + large_.bytes();
+    }
+
+    //
+    // Cycle collection interface (see Cycle_collector.h)
+    //
+
+    // There are no weak pointers to arrays.
+    void cycle_clear_weak(const std::vector<const void*>&) override
+    { }
+
+    void cycle_destroy(void* ptr) override
+    {
+        auto block = static_cast<ptr_t>(ptr);
+        {
+            detail::Recording_pause pause;
+            destroy_elements_(block);
+        }
+        detail::record_deallocate(block);
+    }
+
+    void cycle_free(void* ptr) override
+    {
+        auto   block    = static_cast<ptr_t>(ptr);
+        size_t capacity = block->capacity_();
+        live_size_ -= capacity;
+        if (block->large_()) {
+            heap_size_ -= capacity;
+            large_.deallocate(block);
+        } else {
+            add_to_free_list_(block->size_class_, block);
+            --classes_[block->size_class_].used_blocks;
+        }
+    }
+
+    //
+    // Stats interface – see comments in `Space`
+    //
+
+public:
+    size_t element_size() const override
+    {
+        return sizeof(T);
+    }
+
+    size_t total_slots() const override
+    {
+        return heap_size_;
+    }
+
+    size_t used_slots() const override
+    {
+        return live_size_;
+    }
+};
+
+// Allocates an array of `size` objects of type `T` given a space to allocate
+// in and arguments to construct each element from.
+template <typename T,
+          typename Allocator  = std::allocator<Traced_array<T>>,
+          typename... Args>
+traced_array<T, Allocator>
+make_traced_array_in(Array_space<T, Allocator>& space,
+                     size_t size, const Args&... args)
+{
+    return space.allocate(size, args...);
+}
+
+// Allocates an array of `size` objects of type `T` in the default space,
+// given arguments to construct each element from.
+template <typename T,
+          typename Allocator  = std::allocator<Traced_array<T>>,
+          typename... Args>
+traced_array<T, Allocator>
+make_traced_array(size_t size, const Args&... args)
+{
+    auto& space = Array_space<T, Allocator>::instance();
+    return space.allocate(size, args...);
+}
+
+// Allocates an empty array of `T` with room for at least `capacity` elements
+// in the default space.
+template <typename T,
+          typename Allocator  = std::allocator<Traced_array<T>>>
+traced_array<T, Allocator>
+reserve_traced_array(size_t capacity)
+{
+    return Array_space<T, Allocator>::instance().reserve(capacity);
+}
+
+} // end namespace gc
@@ -1,15 +1,45 @@
 #include "Collector.h"
 
+#include "Allocation_profiler.h"
+#include "Count_log.h"
+#include "Cycle_collector.h"
 #include "logger.h"
+#include "Root_registry.h"
+#include "Shared_scope.h"
+#include "Sweep_pool.h"
+#include "Trace_recorder.h"
+#include "Type_graph.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace gc
 {
 
 using namespace detail;
 
-Collector::Collector() = default;
+Collector::Collector()
+        : finalization_{finalization_t::during_sweep}
+        , busy_{false}
+        , verify_{false}
+        , partial_{false}
+        , heap_limit_{0}
+        , soft_heap_limit_{0}
+        , collections_{0}
+        , last_pause_{0}
+{ }
+
+Collector::~Collector() = default;
 
 Collector& Collector::instance()
 {
@@ -23,18 +53,400 @@ void Collector::register_space(Space& space)
 }
 
 void Collector::collect()
+{
+    record_collect();
+    collect_(nullptr);
+}
+
+bool Collector::collect_(const Space* trigger)
 {
     using std::mem_fn;
 
+    // Objects still queued from last time hold counts on the rest of the
+    // heap, so they have to go before we look for roots.
+    run_finalizers();
+
+    // A destructor that allocates can land here; the allocating space will
+    // grow instead.
+    if (busy_) {
+        log(debug2) << "collect: already busy";
+        return false;
+    }
+
+#ifdef PRECISEPP_ROOT_REGISTRY
+    // Likewise a constructor, since the object it’s constructing holds
+    // pointers that aren’t registered as roots.
+    if (Root_registry::instance().constructing()) {
+        log(debug2) << "collect: constructing";
+        return false;
+    }
+#endif
+
+#ifdef PRECISEPP_BIASED_COUNTS
+    // Other threads count only in `Shared_scope`s, so none may be open while
+    // we read the counts.
+    Shared_scope_exclusion exclusion;
+    if (!exclusion) {
+        log(debug2) << "collect: shared scopes open";
+        return false;
+    }
+#endif
+
+    choose_spaces_(trigger);
+    if (active_.empty()) {
+        log(debug2) << "collect: nothing can be garbage";
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    busy_ = true;
+
+    // The collection may free candidates for cycle collection, and the
+    // destructors it runs drop references to objects it frees.
+    cycle_collector.forget();
+    Cycle_pause cycle_pause;
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    log(debug2) << "collect: apply_count_logs";
+    apply_count_logs();
+#endif
+
+    // Counts that drop from here on, even while sweeping, count toward the
+    // next collection.
+    for_active_(mem_fn(&Space::clear_count_dropped));
+
+#ifdef PRECISEPP_ROOT_REGISTRY
+    log(debug2) << "collect: mark_roots";
+    Root_registry::instance().mark_roots();
+#else
     log(debug2) << "collect: save_counts";
-    for_spaces_(mem_fn(&Space::save_counts));
+    for_active_(mem_fn(&Space::save_counts));
     log(debug2) << "collect: find_roots";
-    for_spaces_(mem_fn(&Space::find_roots));
+    for_active_(mem_fn(&Space::find_roots));
     log(debug2) << "collect: mark";
-    for_spaces_(mem_fn(&Space::mark));
+    for_active_(mem_fn(&Space::mark));
+#endif
+    if (verify_) {
+        log(debug2) << "collect: verify";
+        verify_heap_();
+    }
+    for_active_(mem_fn(&Space::discard_root_counts));
+    log(debug2) << "collect: clear_weak";
+    for_active_(mem_fn(&Space::clear_weak));
     log(debug2) << "collect: sweep";
-    for_spaces_(mem_fn(&Space::sweep));
+    sweep_();
+    Allocation_profiler::instance().collected_();
+
+    active_.clear();
+    busy_ = false;
+
+    if (finalization_ != finalization_t::deferred)
+        run_finalizers();
+
+    ++collections_;
+    last_pause_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+    record_collection(uint64_t(last_pause_.count()));
+
     log(debug2) << "collect: done";
+    return true;
+}
+
+void Collector::sweep_()
+{
+    using std::mem_fn;
+
+    if (sweep_pool_ != nullptr) {
+        Sweep_tasks tasks;
+        for_active_([&tasks](Space* space) { space->plan_sweep(tasks); });
+        log(debug2) << "collect: " << tasks.size() << " parallel sweep tasks";
+        sweep_pool_->run(tasks);
+    }
+
+    for_active_(mem_fn(&Space::sweep));
+}
+
+// The spaces to process are those reachable in the type graph from a space
+// whose counts have dropped, since only they can hold garbage. No edge
+// leads out of that set, so marking stays inside it, and pointers into it
+// from skipped spaces keep their pointees alive, just as roots do. With a
+// trigger, only the dropped spaces that can reach the trigger are worth
+// starting from.
+void Collector::choose_spaces_(const Space* trigger)
+{
+    active_.clear();
+
+#ifndef PRECISEPP_ROOT_REGISTRY
+#ifdef PRECISEPP_BIASED_COUNTS
+    // Drops on other threads aren’t noted by space, so after any scope has
+    // opened, every space could hold garbage.
+    bool scopes_opened = shared_scopes_opened();
+#else
+    bool scopes_opened = false;
+#endif
+
+    if (partial_ && !scopes_opened) {
+        using node_t  = std::type_index;
+        using nodes_t = std::unordered_set<node_t>;
+        using graph_t = std::unordered_map<node_t, std::vector<node_t>>;
+
+        graph_t forward, backward;
+        for (const Type_graph::edge_t& edge : Type_graph::edges()) {
+            forward[*edge.first].push_back(*edge.second);
+            backward[*edge.second].push_back(*edge.first);
+        }
+
+        // Adds everything reachable from `start` to `seen`.
+        auto search = [](graph_t& graph, std::vector<node_t> start,
+                         nodes_t& seen) {
+            seen.insert(start.begin(), start.end());
+            while (!start.empty()) {
+                node_t node = start.back();
+                start.pop_back();
+                for (node_t next : graph[node])
+                    if (seen.insert(next).second) start.push_back(next);
+            }
+        };
+
+        nodes_t upstream;
+        if (trigger != nullptr)
+            search(backward, {trigger->traced_type()}, upstream);
+
+        std::vector<node_t> dropped;
+        for (Space* space : spaces_) {
+            node_t node = space->traced_type();
+            if (space->count_dropped() &&
+                    (trigger == nullptr || upstream.count(node)))
+                dropped.push_back(node);
+        }
+
+        nodes_t affected;
+        search(forward, std::move(dropped), affected);
+
+        for (Space* space : spaces_)
+            if (affected.count(space->traced_type()))
+                active_.push_back(space);
+
+        log(debug2) << "collect: " << active_.size() << " of "
+                    << spaces_.size() << " spaces";
+        return;
+    }
+#else
+    (void) trigger;
+#endif
+
+    active_ = spaces_;
+}
+
+size_t Collector::sweep_threads() const
+{
+    return sweep_pool_ != nullptr ? sweep_pool_->threads() : 1;
+}
+
+void Collector::set_sweep_threads(size_t threads)
+{
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    if (threads == sweep_threads()) return;
+
+    sweep_pool_.reset();
+    if (threads > 1)
+        sweep_pool_.reset(new Sweep_pool{threads});
+}
+
+void Collector::dump_heap(std::ostream& out)
+{
+    using std::mem_fn;
+
+    run_finalizers();
+    if (busy_) return;
+
+#ifdef PRECISEPP_BIASED_COUNTS
+    Shared_scope_exclusion exclusion;
+    if (!exclusion) return;
+#endif
+
+    busy_ = true;
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    apply_count_logs();
+#endif
+
+    // Phases 1 and 2 find each object’s count of references from outside
+    // the heap, whichever way the collector finds roots.
+    log(debug2) << "dump_heap: save_counts";
+    for_spaces_(mem_fn(&Space::save_counts));
+    log(debug2) << "dump_heap: find_roots";
+    for_spaces_(mem_fn(&Space::find_roots));
+
+    Heap_dump dump{out};
+    for_spaces_([&dump](Space* space) { space->dump(dump); });
+    for_spaces_(mem_fn(&Space::discard_root_counts));
+
+    busy_ = false;
+}
+
+bool Collector::cycle_collection() const
+{
+    return cycle_collector.enabled();
+}
+
+void Collector::set_cycle_collection(bool enabled)
+{
+    cycle_collector.set_enabled(enabled);
+}
+
+void Collector::collect_cycles()
+{
+    cycle_collector.collect();
+}
+
+void Collector::set_verify(bool verify)
+{
+    using std::mem_fn;
+
+    if (verify && !verify_)
+        for_spaces_(mem_fn(&Space::poison_free));
+    verify_ = verify;
+}
+
+size_t Collector::heap_bytes() const
+{
+    size_t result = 0;
+    for (const Space* space : spaces_)
+        result += space->heap_bytes();
+    return result;
+}
+
+bool Collector::may_grow_(size_t bytes, int attempt)
+{
+    size_t wanted  = heap_bytes() + bytes;
+    bool over_hard = heap_limit_ != 0 && wanted > heap_limit_;
+    bool over_soft = soft_heap_limit_ != 0 && wanted > soft_heap_limit_;
+
+    if (busy_ || !(over_hard || (over_soft && attempt == 0)))
+        return true;
+
+    if (attempt == 0) {
+        log(debug1) << "may_grow_: collecting for room";
+    } else if (attempt == 1 && limit_handler_) {
+        log(debug1) << "may_grow_: calling the limit handler";
+        limit_handler_(wanted);
+    } else {
+        log(debug1) << "may_grow_: out of room";
+        throw std::bad_alloc{};
+    }
+
+    // If no collection can run now, there’s no telling whether one would
+    // make room, so the space grows, as it does during a collection. Only
+    // collections that ran count as attempts.
+    if (!collect_(nullptr)) {
+        log(debug1) << "may_grow_: can’t collect now";
+        return true;
+    }
+
+    // Deferred finalization would keep the dead objects’ memory until the
+    // program asks, which it can’t while it’s allocating.
+    run_finalizers();
+    return false;
+}
+
+void Collector::make_room_(size_t bytes)
+{
+    for (int attempt = 0; !may_grow_(bytes, attempt); ++attempt)
+    { }
+}
+
+bool Collector::may_grow_early_(size_t bytes) const
+{
+    size_t wanted = heap_bytes() + bytes;
+    return (heap_limit_ == 0 || wanted <= heap_limit_) &&
+           (soft_heap_limit_ == 0 || wanted <= soft_heap_limit_);
+}
+
+namespace
+{
+
+// Reads one number from the start of a file, or returns zero.
+size_t read_limit_file(const char* path)
+{
+    std::ifstream in{path};
+    size_t result = 0;
+    if (!(in >> result)) return 0;   // Including cgroup v2’s “max”
+    return result;
+}
+
+// The machine’s physical memory, from /proc/meminfo, or zero.
+size_t physical_memory()
+{
+    std::ifstream in{"/proc/meminfo"};
+    std::string key;
+    size_t      kilobytes;
+    while (in >> key >> kilobytes) {
+        if (key == "MemTotal:") return kilobytes * 1024;
+        in.ignore(256, '\n');
+    }
+    return 0;
+}
+
+} // end anonymous namespace
+
+size_t Collector::system_memory_limit()
+{
+    size_t result = physical_memory();
+
+    // cgroup v2, and then v1, which reports no limit as a huge number.
+    for (const char* path : {"/sys/fs/cgroup/memory.max",
+                             "/sys/fs/cgroup/memory/memory.limit_in_bytes"}) {
+        size_t limit = read_limit_file(path);
+        if (limit != 0 && (result == 0 || limit < result)) result = limit;
+    }
+
+    return result;
+}
+
+void Collector::verify_heap_()
+{
+    auto step = [this](Verify_step step) {
+        for_active_([step](Space* space) { space->verify(step); });
+    };
+
+#ifndef PRECISEPP_ROOT_REGISTRY
+    // Registry mode doesn’t find roots by counting.
+    step(Verify_step::check_root_counts);
+#endif
+    step(Verify_step::save_counts);
+    step(Verify_step::count_dead_refs);
+    step(Verify_step::check_unmarked);
+}
+
+void Collector::verify_failed_(const char* problem,
+                               const std::type_info& type, const void* ptr)
+{
+    std::cerr << "precisepp: heap verification failed: " << problem
+              << " (" << type_name(type) << " at " << ptr << ")\n";
+    std::abort();
+}
+
+void Collector::run_finalizers()
+{
+    using std::mem_fn;
+
+    if (busy_) return;
+
+    busy_ = true;
+    Cycle_pause cycle_pause;
+    log(debug2) << "collect: finalize";
+    for_spaces_(mem_fn(&Space::finalize));
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    // Destructors may have logged decrements for dead objects whose slots
+    // are about to be freed.
+    apply_count_logs();
+#endif
+    log(debug2) << "collect: release";
+    for_spaces_(mem_fn(&Space::release));
+    busy_ = false;
 }
 
 } // end namespace gc
@@ -6,11 +6,42 @@
 #include "Space.h"
 #include "forward.h"
 
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <typeinfo>
 #include <vector>
 
 namespace gc
 {
 
+namespace detail
+{
+
+class Cycle_collector;
+class Region_state;
+class Sweep_pool;
+
+} // end namespace detail
+
+// When the destructors of dead objects run.
+enum class finalization_t
+{
+    // Each space destroys its dead objects as it sweeps. (The default.)
+    during_sweep,
+
+    // Dead objects are queued while sweeping, and destroyed in a batch once
+    // every space has swept.
+    after_sweep,
+
+    // Dead objects are queued while sweeping, and destroyed in a batch when
+    // the program calls `Collector::run_finalizers` (or at the start of the
+    // next collection). This keeps expensive destructors out of the pause.
+    deferred,
+};
+
 class Collector
 {
 public:
@@ -18,18 +49,214 @@ public:
 
     void collect();
 
+    // Destroys any dead objects queued by a collection with deferred
+    // finalization, and returns their memory.
+    void run_finalizers();
+
+    // Writes a snapshot of the heap to `out`, in the format described in
+    // Heap_dump.h. The snapshot is written as the heap is walked, so it
+    // needs little memory of its own.
+    void dump_heap(std::ostream& out);
+
+    finalization_t finalization() const
+    {
+        return finalization_;
+    }
+
+    void set_finalization(finalization_t finalization)
+    {
+        finalization_ = finalization;
+    }
+
+    // Whether each collection verifies the heap. When it does, after
+    // marking it checks that no object that marking missed is referred to
+    // by a live object or a root, and that no root count underflowed;
+    // and freed slots are poisoned, and checked when they’re reused. A
+    // failed check reports the object and its type to `std::cerr` and
+    // aborts. This costs a few extra passes over the heap per collection
+    // and a fill and a check per object, so it’s meant for testing and
+    // canary deployments.
+    bool verifying() const
+    {
+        return verify_;
+    }
+
+    void set_verify(bool verify);
+
+    // How many threads sweep, counting the collecting thread. With more
+    // than one, the spaces of types whose destructors can run concurrently
+    // are swept in pieces spread over the threads, before the other spaces
+    // are swept as usual. Only types that specialize `parallel_destructible`
+    // (see Typed_space.h) take part: types with trivial destructors and no
+    // pointers, the ones it covers by default, are swept lazily instead,
+    // which is cheaper still. Setting zero means one thread per hardware
+    // thread. The default is one, which starts no threads.
+    size_t sweep_threads() const;
+
+    void set_sweep_threads(size_t threads);
+
+    // Whether collections are partial. A partial collection skips the
+    // spaces that can’t hold garbage. Only a space where some object has
+    // lost a reference since it was last collected can; so can the spaces
+    // its objects can point to, going by the type graph of Type_graph.h.
+    // A collection started because one space ran out of room narrows that
+    // further, to the spaces whose garbage could be keeping its objects
+    // alive. Skipped spaces cost nothing, which matters with many types.
+    // The default is false. Collections are never partial with a root
+    // registry, since marking from the registry can reach every space.
+    bool partial() const
+    {
+        return partial_;
+    }
+
+    void set_partial(bool partial)
+    {
+        partial_ = partial;
+    }
+
+    // Whether objects that lose a reference are buffered as candidates for
+    // `collect_cycles`, which then runs by itself whenever
+    // `cycle_buffer_size` have been buffered. This costs a branch on every
+    // drop while off, and a store while on. The default is false.
+    bool cycle_collection() const;
+    void set_cycle_collection(bool enabled);
+
+    // Frees the garbage reachable from the buffered candidates, by trial
+    // deletion over just that part of the heap (see Cycle_collector.h).
+    // Does nothing unless cycle collection is on.
+    void collect_cycles();
+
+    // The heap limit, in bytes of pages and large-object blocks, or zero
+    // for none (the default). When allocation needs the heap to grow past
+    // it, the collector first collects everything it can. If that doesn’t
+    // make room, it calls the limit handler and collects again, and if
+    // there’s still no room, allocation throws `std::bad_alloc`. (The heap
+    // may pass the limit while a collection is running, since destructors
+    // that allocate can’t wait for another, and likewise whenever one
+    // can’t start: while a `Shared_scope` is open, or with a root registry,
+    // while an object is being constructed.)
+    size_t heap_limit() const
+    {
+        return heap_limit_;
+    }
+
+    void set_heap_limit(size_t bytes)
+    {
+        heap_limit_ = bytes;
+    }
+
+    // The soft heap limit, or zero for none (the default). Past it, the heap
+    // grows only when a full collection fails to make room, and never
+    // grows ahead of need after a collection. For a service in a
+    // container, something like
+    //
+    //     collector.set_soft_heap_limit(Collector::system_memory_limit() / 2);
+    //
+    // leaves room for the rest of the process.
+    size_t soft_heap_limit() const
+    {
+        return soft_heap_limit_;
+    }
+
+    void set_soft_heap_limit(size_t bytes)
+    {
+        soft_heap_limit_ = bytes;
+    }
+
+    // Called when the heap reaches its limit, with the size it would have
+    // to grow to. The handler may drop references to free memory, or raise
+    // the limit.
+    using limit_handler_t = std::function<void(size_t)>;
+
+    void set_limit_handler(limit_handler_t handler)
+    {
+        limit_handler_ = std::move(handler);
+    }
+
+    // The number of bytes the heap holds now, counted as for the limits.
+    size_t heap_bytes() const;
+
+    // The number of collections so far, and how long the last one took
+    // (counting finalization, unless it’s deferred).
+    size_t collections() const
+    {
+        return collections_;
+    }
+
+    std::chrono::nanoseconds last_pause() const
+    {
+        return last_pause_;
+    }
+
+    // The memory available to this process: the limit of its cgroup, if
+    // it has one, or else the machine’s physical memory, as reported by
+    // /proc/meminfo. Zero if neither can be read.
+    static size_t system_memory_limit();
+
 private:
     std::vector<detail::Space*> spaces_;
+    finalization_t finalization_;
+    bool busy_;   // Collecting or finalizing, so we can’t start again
+    bool verify_; // Verifying the heap (see `set_verify`)
+    std::unique_ptr<detail::Sweep_pool> sweep_pool_; // If multithreaded
+    bool partial_;  // Skipping spaces (see `set_partial`)
+    std::vector<detail::Space*> active_; // The spaces being collected
+    size_t heap_limit_;         // See `set_heap_limit`
+    size_t soft_heap_limit_;    // See `set_soft_heap_limit`
+    limit_handler_t limit_handler_;
+    size_t collections_;        // See `collections`
+    std::chrono::nanoseconds last_pause_;
 
     Collector();
+    ~Collector();
+
+    // Collects, on behalf of the space that ran out of room, if any.
+    // Returns false if no collection could start (see `heap_limit`).
+    bool collect_(const detail::Space* trigger);
+
+    // Sets `active_` to the spaces that a collection must process.
+    void choose_spaces_(const detail::Space* trigger);
+
+    // GC phase 5, in parallel and then serially.
+    void sweep_();
+
+    // Whether a space that has to grow by `bytes` to allocate may do so
+    // now. If not, the collector has tried to make room (depending on
+    // `attempt`, which counts up from zero for each growth), and the space
+    // should check whether it still has to grow before asking again. Throws
+    // `std::bad_alloc` once there is nothing more to try.
+    bool may_grow_(size_t bytes, int attempt);
+
+    // Asks `may_grow_` until it says yes, for a space that can’t gain room
+    // from a collection.
+    void make_room_(size_t bytes);
+
+    // Whether a space may grow by `bytes` ahead of need, after sweeping.
+    bool may_grow_early_(size_t bytes) const;
 
     void register_space(detail::Space&);
 
     template <typename F>
     void for_spaces_(F);
 
+    template <typename F>
+    void for_active_(F);
+
+    void verify_heap_();
+
+    // Reports a failed heap check and aborts.
+    [[noreturn]] static void verify_failed_(const char* problem,
+                                            const std::type_info& type,
+                                            const void* ptr);
+
     template <typename T, typename Allocator>
     friend class Typed_space;
+
+    template <typename T, typename Allocator>
+    friend class Array_space;
+
+    friend class detail::Cycle_collector;
+    friend class detail::Region_state;
 };
 
 template <typename F>
@@ -39,4 +266,11 @@ void Collector::for_spaces_(F f)
         f(space);
 }
 
+template <typename F>
+void Collector::for_active_(F f)
+{
+    for (detail::Space* space : active_)
+        f(space);
+}
+
 } // end namespace gc
\ No newline at end of file
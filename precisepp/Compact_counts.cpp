@@ -0,0 +1,61 @@
+#include "Compact_counts.h"
+
+#ifdef PRECISEPP_COMPACT_HEADERS
+
+#include <unordered_map>
+
+namespace gc
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// The real counts of saturated objects. An entry may outlive its object,
+// but it’s only read while the count in the object is saturated, and a
+// count that saturates again overwrites it.
+std::unordered_map<const void*, size_t>& overflow_table()
+{
+    static std::unordered_map<const void*, size_t> table;
+    return table;
+}
+
+} // end anonymous namespace
+
+void increment_saturating(uint32_t& count, const void* object)
+{
+    if (count == saturated_count) {
+        ++overflow_table()[object];
+    } else {
+        count = saturated_count;
+        overflow_table()[object] = saturated_count;
+    }
+}
+
+void decrement_saturated(uint32_t& count, const void* object)
+{
+    auto entry = overflow_table().find(object);
+    if (--entry->second < saturated_count) {
+        count = uint32_t(entry->second);
+        overflow_table().erase(entry);
+    }
+}
+
+size_t saturated_value(const void* object)
+{
+    return overflow_table().at(object);
+}
+
+void set_saturated(uint32_t& count, const void* object, size_t value)
+{
+    count = saturated_count;
+    overflow_table()[object] = value;
+}
+
+} // end namespace detail
+
+} // end namespace gc
+
+#endif // PRECISEPP_COMPACT_HEADERS
@@ -0,0 +1,91 @@
+// In compact-header mode (when `PRECISEPP_COMPACT_HEADERS` is defined for
+// the whole program), each `Traced<T>` carries only a 32-bit reference
+// count and its slot index beside its object, which is 8 bytes in all
+// rather than 24, and an array block’s metadata shrinks from 32 bytes to
+// 24.
+//
+// A count that would reach `saturated_count` saturates there instead, and
+// the object’s real count moves to an overflow table keyed by its address
+// until it drops back below. (That takes four billion references, so the
+// table is almost always empty.)
+//
+// The root counts of objects in pages, which are only needed from phase 1
+// of a collection until marking is done, are kept in a scratch array for
+// each page while they are needed (see `Traced<T>::root_count_`). Large
+// objects keep theirs in their block headers, and array blocks keep
+// theirs inline.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(PRECISEPP_COMPACT_HEADERS) && defined(PRECISEPP_BIASED_COUNTS)
+#error "PRECISEPP_COMPACT_HEADERS can't be combined with PRECISEPP_BIASED_COUNTS"
+#endif
+
+#if defined(PRECISEPP_COMPACT_HEADERS) && defined(PRECISEPP_DEFERRED_COUNTS)
+#error "PRECISEPP_COMPACT_HEADERS can't be combined with PRECISEPP_DEFERRED_COUNTS"
+#endif
+
+#ifdef PRECISEPP_COMPACT_HEADERS
+
+namespace gc
+{
+
+namespace detail
+{
+
+static constexpr uint32_t saturated_count = UINT32_MAX;
+
+// The slow paths of the functions below, for counts at or next to
+// saturation.
+void increment_saturating(uint32_t& count, const void* object);
+void decrement_saturated(uint32_t& count, const void* object);
+size_t saturated_value(const void* object);
+void set_saturated(uint32_t& count, const void* object, size_t value);
+
+// Operations on the compact count `count` of the object at `object`.
+
+inline void increment_count(uint32_t& count, const void* object)
+{
+    if (count < saturated_count - 1)
+        ++count;
+    else
+        increment_saturating(count, object);
+}
+
+inline void decrement_count(uint32_t& count, const void* object)
+{
+    if (count != saturated_count)
+        --count;
+    else
+        decrement_saturated(count, object);
+}
+
+inline size_t count_value(uint32_t count, const void* object)
+{
+    return count != saturated_count ? count : saturated_value(object);
+}
+
+inline void set_count(uint32_t& count, const void* object, size_t value)
+{
+    if (value < saturated_count)
+        count = uint32_t(value);
+    else
+        set_saturated(count, object, value);
+}
+
+// What `root_count_` refers to for objects whose pages have no root counts:
+// immortal objects, and objects in spaces a partial collection skips.
+// Phase 2 passes over both, so nothing counts in it.
+inline size_t& ignored_root_count()
+{
+    static size_t ignored;
+    return ignored;
+}
+
+} // end namespace detail
+
+} // end namespace gc
+
+#endif // PRECISEPP_COMPACT_HEADERS
@@ -0,0 +1,105 @@
+#include "Count_log.h"
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace gc
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Entries per log; a full log takes 32 KiB.
+constexpr size_t count_log_capacity = 4096;
+
+// The logs of every thread that has one, guarded by `logs_mutex`.
+std::mutex              logs_mutex;
+std::vector<Count_log*> logs;
+
+// Set once the calling thread’s log has been given back, after which its
+// changes are applied directly.
+thread_local bool thread_exiting = false;
+
+// Applies entries in the order they were logged. (Sorting them first, to
+// coalesce the entries for each count, costs more than it saves: the
+// pairs worth coalescing mostly cancel as they’re logged.)
+void apply_entries(const uintptr_t* begin, const uintptr_t* end)
+{
+    for (; begin != end; ++begin) {
+        // Counts are unsigned, so a decrement is adding -1.
+        size_t* count = reinterpret_cast<size_t*>(*begin & ~uintptr_t(1));
+        *count += (*begin & 1) ? size_t(-1) : 1;
+    }
+}
+
+void apply_log(Count_log& count_log)
+{
+    apply_entries(count_log.begin, count_log.next);
+    count_log.next = count_log.begin;
+}
+
+// Applies what’s left in a thread’s log when the thread exits, and gives
+// back its buffer.
+class Count_log_owner
+{
+public:
+    explicit Count_log_owner(Count_log& count_log) : count_log_(count_log)
+    { }
+
+    ~Count_log_owner()
+    {
+        std::lock_guard<std::mutex> lock{logs_mutex};
+        apply_log(count_log_);
+        logs.erase(std::find(logs.begin(), logs.end(), &count_log_));
+        delete [] count_log_.begin;
+        count_log_     = Count_log{nullptr, nullptr, nullptr};
+        thread_exiting = true;
+    }
+
+private:
+    Count_log& count_log_;
+};
+
+} // end anonymous namespace
+
+void log_count_change_slow(uintptr_t entry)
+{
+    Count_log& count_log = this_thread_count_log();
+
+    if (thread_exiting) {
+        apply_entries(&entry, &entry + 1);
+        return;
+    }
+
+    if (count_log.begin != nullptr) {
+        apply_log(count_log);
+    } else {
+        std::lock_guard<std::mutex> lock{logs_mutex};
+        count_log.begin = new uintptr_t[count_log_capacity];
+        count_log.next  = count_log.begin;
+        count_log.end   = count_log.begin + count_log_capacity;
+        logs.push_back(&count_log);
+    }
+
+    static thread_local Count_log_owner owner{count_log};
+    *count_log.next++ = entry;
+}
+
+void apply_count_logs()
+{
+    std::lock_guard<std::mutex> lock{logs_mutex};
+    for (Count_log* count_log : logs)
+        apply_log(*count_log);
+}
+
+} // end namespace detail
+
+} // end namespace gc
+
+#endif // PRECISEPP_DEFERRED_COUNTS
@@ -0,0 +1,89 @@
+// In deferred-count mode (when `PRECISEPP_DEFERRED_COUNTS` is defined for
+// the whole program), copying or dropping a `traced_ptr` or `traced_array`
+// doesn’t write to the object’s count. It appends the count’s address to
+// a log kept by the calling thread instead, tagged in the low bit when
+// it’s a decrement, so that code shuffling pointers around a large heap
+// doesn’t dirty a cache line in every object it passes. An entry that
+// undoes the one just before it, as a temporary copy does, cancels it.
+//
+// Only the collector reads counts, so a log needs applying only before it
+// does: at the start of each collection and heap dump, or when the log
+// fills up.
+//
+// Destructors run by a collection log decrements too, including some for
+// other dead objects. Those must land before the dead slots can be
+// reused, so the logs are applied again before dead slots are released,
+// and before a destructor allocates from a free list the sweep may have
+// added to.
+//
+// As with ordinary counts, each pointer stays on one thread, but each
+// thread has its own log. A collection applies every thread’s log, and a
+// thread’s log is applied when it exits.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(PRECISEPP_DEFERRED_COUNTS) && defined(PRECISEPP_BIASED_COUNTS)
+#error "PRECISEPP_DEFERRED_COUNTS can't be combined with PRECISEPP_BIASED_COUNTS"
+#endif
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+
+namespace gc
+{
+
+namespace detail
+{
+
+// A thread’s log: the entries from `begin` to `next`, with room up to
+// `end`. It has no buffer until its first entry.
+struct Count_log
+{
+    uintptr_t* begin;
+    uintptr_t* next;
+    uintptr_t* end;
+};
+
+inline Count_log& this_thread_count_log()
+{
+    static thread_local Count_log count_log{nullptr, nullptr, nullptr};
+    return count_log;
+}
+
+// Records `entry` when the log is full or has no buffer yet, applying it
+// first or giving it one.
+void log_count_change_slow(uintptr_t entry);
+
+// Applies every thread’s log, leaving them empty. The collector calls this
+// before it reads counts.
+void apply_count_logs();
+
+// Records a change to a count: the count’s address, plus one for a
+// decrement.
+inline void log_count_change(uintptr_t entry)
+{
+    Count_log& count_log = this_thread_count_log();
+    if (count_log.next != count_log.begin && count_log.next[-1] == (entry ^ 1))
+        --count_log.next;
+    else if (count_log.next != count_log.end)
+        *count_log.next++ = entry;
+    else
+        log_count_change_slow(entry);
+}
+
+inline void log_increment(size_t& count)
+{
+    log_count_change(reinterpret_cast<uintptr_t>(&count));
+}
+
+inline void log_decrement(size_t& count)
+{
+    log_count_change(reinterpret_cast<uintptr_t>(&count) | 1);
+}
+
+} // end namespace detail
+
+} // end namespace gc
+
+#endif // PRECISEPP_DEFERRED_COUNTS
@@ -0,0 +1,144 @@
+#include "Cycle_collector.h"
+
+#include "Collector.h"
+#include "Count_log.h"
+#include "logger.h"
+#include "Region.h"
+#include "Shared_scope.h"
+#include "Space.h"
+
+#include <algorithm>
+
+namespace gc
+{
+
+namespace detail
+{
+
+Cycle_collector cycle_collector;
+
+void Cycle_collector::collect()
+{
+    Collector& collector = Collector::instance();
+
+    // As for a collection, destructors can’t run in the middle of another
+    // one, and counts can’t be read while other threads may change them.
+    if (!recording_ || collector.busy_ || candidates_.empty()) return;
+
+#ifdef PRECISEPP_BIASED_COUNTS
+    Shared_scope_exclusion exclusion;
+    if (!exclusion) {
+        log(debug2) << "collect_cycles: shared scopes open";
+        return;
+    }
+#endif
+
+    Cycle_pause pause;
+    collector.busy_ = true;
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    apply_count_logs();
+#endif
+
+    // A type’s objects can be freed only if we know their space.
+    spaces_.clear();
+    for (Space* space : collector.spaces_) {
+        auto inserted = spaces_.emplace(space->traced_type(), space);
+        if (!inserted.second) inserted.first->second = nullptr;
+    }
+
+    std::vector<Cycle_object> candidates;
+    candidates.swap(candidates_);
+    log(debug2) << "collect_cycles: " << candidates.size() << " candidates";
+
+    // Mark gray: visit the subgraph reachable from the candidates,
+    // subtracting its edges from the counts of their targets.
+    for (const Cycle_object& candidate : candidates)
+        visit_(candidate);
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        edges_.clear();
+        nodes_[i].object.type->trace(nodes_[i].object.ptr);
+        for (const Cycle_object& edge : edges_) {
+            size_t j = visit_(edge);
+            if (j < nodes_.size()) --nodes_[j].count;
+        }
+    }
+
+    // Scan: whatever is referred to from outside the subgraph is alive, and
+    // so is everything it reaches.
+    std::vector<size_t> stack;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (nodes_[i].count == 0 || nodes_[i].live) continue;
+        nodes_[i].live = true;
+        stack.push_back(i);
+        while (!stack.empty()) {
+            Cycle_object object = nodes_[stack.back()].object;
+            stack.pop_back();
+            edges_.clear();
+            object.type->trace(object.ptr);
+            for (const Cycle_object& edge : edges_) {
+                auto found = index_.find(edge.ptr);
+                if (found != index_.end() && !nodes_[found->second].live) {
+                    nodes_[found->second].live = true;
+                    stack.push_back(found->second);
+                }
+            }
+        }
+    }
+
+    // Collect white: the rest are garbage. Grouped by space, they have
+    // their weak pointers cleared, and then they are all destroyed before
+    // any is freed, since destructors drop references to each other.
+    std::vector<Node> dead;
+    for (const Node& node : nodes_)
+        if (!node.live) dead.push_back(node);
+    nodes_.clear();
+    index_.clear();
+    edges_.clear();
+
+    log(debug2) << "collect_cycles: " << dead.size() << " dead";
+    std::sort(dead.begin(), dead.end(), [](const Node& a, const Node& b) {
+        return a.space < b.space ||
+               (a.space == b.space && a.object.ptr < b.object.ptr);
+    });
+
+    std::vector<const void*> objects;
+    for (size_t i = 0; i < dead.size(); ) {
+        Space* space = dead[i].space;
+        objects.clear();
+        for (; i < dead.size() && dead[i].space == space; ++i)
+            objects.push_back(dead[i].object.ptr);
+        space->cycle_clear_weak(objects);
+    }
+
+    for (const Node& node : dead) node.space->cycle_destroy(node.object.ptr);
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    // Destructors logged decrements for other dead objects, which must land
+    // before their slots are reused.
+    apply_count_logs();
+#endif
+    for (const Node& node : dead) node.space->cycle_free(node.object.ptr);
+
+    collector.busy_ = false;
+}
+
+size_t Cycle_collector::visit_(const Cycle_object& object)
+{
+    auto found = index_.find(object.ptr);
+    if (found != index_.end()) return found->second;
+
+    auto space = spaces_.find(object.type->traced_type());
+    if (space == spaces_.end() || space->second == nullptr ||
+            regions.contains(object.ptr) || object.type->immortal(object.ptr))
+        return nodes_.size();
+
+    size_t index = nodes_.size();
+    index_.emplace(object.ptr, index);
+    nodes_.push_back(Node{object, space->second,
+                          object.type->count(object.ptr), false});
+    return index;
+}
+
+} // end namespace detail
+
+} // end namespace gc
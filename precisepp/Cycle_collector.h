@@ -0,0 +1,251 @@
+// Local cycle collection, after Bacon and Rajan’s synchronous cycle
+// collector. Collecting garbage by trial deletion over the whole heap
+// (Space.h) costs the same however little of the heap it frees; but
+// garbage can only appear where a reference is dropped. So when cycle
+// collection is on (`Collector::set_cycle_collection`), every object that
+// loses a reference is buffered as a *candidate*, and
+// `Collector::collect_cycles` runs the same trial deletion over just the
+// objects reachable from the candidates:
+//
+//   1. Each of those objects starts with its reference count, less one for
+//      every pointer to it from another of them (“mark gray”). What’s left
+//      counts references from outside the subgraph.
+//
+//   2. An object with references left is alive, and so is everything it
+//      reaches (“scan”).
+//
+//   3. The rest are referred to only by each other, and are freed: their
+//      weak pointers are cleared, then they are all destroyed, and then
+//      their slots are freed (“collect white”).
+//
+// Since objects aren’t freed when their counts reach zero, objects that
+// lose their last reference are candidates too, and the pass frees acyclic
+// garbage as well as cycles. The candidate buffer holds each object once in
+// a row of drops, and when it fills the next allocation runs the pass.
+//
+// Immortal objects, objects in an open region, and objects of a type with
+// more than one space are left out of the subgraph; like anything outside
+// it, they keep what they point to alive. A collection forgets the
+// candidates, since it may free them, and they’re not recorded while it or
+// the pass runs destructors. Dead objects are destroyed right away,
+// whatever the collector’s finalization.
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace gc
+{
+
+// When this many candidates are buffered, the next allocation runs
+// `Collector::collect_cycles`.
+static constexpr size_t cycle_buffer_size = 4096;
+
+namespace detail
+{
+
+class Space;
+
+// What the pass needs to know about the objects of a traced type: a table
+// of functions, one per type, so that candidates of every type can share a
+// buffer.
+struct Cycle_type
+{
+    // The object’s reference count.
+    size_t (*count)(void* ptr);
+
+    // Whether the object is immortal, and so left out.
+    bool (*immortal)(void* ptr);
+
+    // Appends the object’s non-null pointees to `Cycle_collector::edges_`.
+    void (*trace)(void* ptr);
+
+    // `Traced<T>` or `Traced_array<T>`, which identifies its space.
+    const std::type_info& (*traced_type)();
+};
+
+// An object, with the functions for its type.
+struct Cycle_object
+{
+    void*             ptr;
+    const Cycle_type* type;
+};
+
+// The `Cycle_type` of traced type `P`, which is `Traced<T>*` or
+// `Traced_array<T>*`.
+template <typename P>
+struct Cycle_type_of
+{
+    static const Cycle_type value;
+
+    static size_t count(void* ptr)
+    {
+        P object = static_cast<P>(ptr);
+        object->merge_counts_();
+        return object->ref_count_();
+    }
+
+    static bool immortal(void* ptr)
+    {
+        return static_cast<P>(ptr)->marked_();
+    }
+
+    static void trace(void* ptr);
+
+    static const std::type_info& traced_type()
+    {
+        return typeid(std::remove_pointer_t<P>);
+    }
+};
+
+template <typename P>
+const Cycle_type Cycle_type_of<P>::value = {
+    &Cycle_type_of<P>::count,
+    &Cycle_type_of<P>::immortal,
+    &Cycle_type_of<P>::trace,
+    &Cycle_type_of<P>::traced_type,
+};
+
+// Adds each pointee to `Cycle_collector::edges_`.
+struct Cycle_tracer
+{
+    template <typename P>
+    void operator()(P ptr) const;
+};
+
+class Cycle_collector
+{
+public:
+    // Whether drops are buffered: cycle collection is on, and no collection
+    // is running destructors.
+    bool recording() const
+    {
+        return recording_;
+    }
+
+    bool enabled() const
+    {
+        return enabled_;
+    }
+
+    void set_enabled(bool enabled)
+    {
+        enabled_   = enabled;
+        recording_ = enabled;
+        if (!enabled) candidates_.clear();
+    }
+
+    // Buffers an object that has lost a reference.
+    void add(void* ptr, const Cycle_type* type)
+    {
+        if (candidates_.empty() || candidates_.back().ptr != ptr)
+            candidates_.push_back(Cycle_object{ptr, type});
+    }
+
+    // Whether the next allocation should run the pass.
+    bool full() const
+    {
+        return candidates_.size() >= cycle_buffer_size;
+    }
+
+    // Forgets every candidate, before something else may free them.
+    void forget()
+    {
+        candidates_.clear();
+    }
+
+    // Forgets the candidates for which `f` holds.
+    template <typename F>
+    void forget_if(F f)
+    {
+        auto end = candidates_.begin();
+        for (const Cycle_object& candidate : candidates_)
+            if (!f(candidate.ptr)) *end++ = candidate;
+        candidates_.erase(end, candidates_.end());
+    }
+
+    // Frees the garbage reachable from the candidates, unless the
+    // collector is busy or drops aren’t being recorded.
+    void collect();
+
+private:
+    friend struct Cycle_tracer;
+    friend class Cycle_pause;
+
+    // An object in the subgraph, with its count of references from
+    // outside it.
+    struct Node
+    {
+        Cycle_object object;
+        Space*       space;
+        size_t       count;
+        bool         live;
+    };
+
+    bool enabled_   = false;
+    bool recording_ = false;
+    std::vector<Cycle_object> candidates_;
+    std::vector<Cycle_object> edges_;  // Filled by `Cycle_tracer`
+    std::vector<Node>         nodes_;  // The subgraph
+    std::unordered_map<const void*, size_t> index_; // Into `nodes_`
+    std::unordered_map<std::type_index, Space*> spaces_; // By traced type
+
+    // Adds an object to the subgraph if it belongs there and isn’t there
+    // yet, returning its index in `nodes_`, or `nodes_.size()` if it’s left
+    // out.
+    size_t visit_(const Cycle_object& object);
+};
+
+extern Cycle_collector cycle_collector;
+
+// Stops buffering drops for its lifetime, around destructors that a
+// collection runs, which drop references to objects about to be freed.
+class Cycle_pause
+{
+public:
+    Cycle_pause() : saved_{cycle_collector.recording_}
+    {
+        cycle_collector.recording_ = false;
+    }
+
+    ~Cycle_pause()
+    {
+        cycle_collector.recording_ = saved_;
+    }
+
+    Cycle_pause(const Cycle_pause&) = delete;
+    Cycle_pause& operator=(const Cycle_pause&) = delete;
+
+private:
+    bool saved_;
+};
+
+template <typename P>
+void Cycle_tracer::operator()(P ptr) const
+{
+    if (ptr != nullptr)
+        cycle_collector.edges_.push_back(
+                Cycle_object{ptr, &Cycle_type_of<P>::value});
+}
+
+template <typename P>
+void Cycle_type_of<P>::trace(void* ptr)
+{
+    static_cast<P>(ptr)->trace_object_(Cycle_tracer{});
+}
+
+// Called as an object loses a reference.
+template <typename P>
+inline void possible_cycle_root(P ptr)
+{
+    if (cycle_collector.recording())
+        cycle_collector.add(ptr, &Cycle_type_of<P>::value);
+}
+
+} // end namespace detail
+
+} // end namespace gc
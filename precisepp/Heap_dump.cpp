@@ -0,0 +1,64 @@
+#include "Heap_dump.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include <cxxabi.h>
+
+namespace gc
+{
+namespace detail
+{
+
+std::string type_name(const std::type_info& type)
+{
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> result{
+            abi::__cxa_demangle(type.name(), nullptr, nullptr, &status),
+            std::free};
+    return status == 0 ? result.get() : type.name();
+}
+
+namespace
+{
+
+// Writes a string as a JSON string literal.
+void write_string(std::ostream& out, const std::string& s)
+{
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+} // end anonymous namespace
+
+void Heap_dump::space(const std::type_info& type, const char* kind,
+                      size_t element_size)
+{
+    out_ << "{\"space\":" << spaces_++ << ",\"type\":";
+    write_string(out_, type_name(type));
+    out_ << ",\"kind\":\"" << kind << "\",\"element_size\":" << element_size
+         << "}\n";
+}
+
+void Heap_dump::object(const void* ptr, size_t size, size_t refs,
+                       size_t roots)
+{
+    out_ << "{\"object\":" << uintptr_t(ptr) << ",\"space\":" << spaces_ - 1
+         << ",\"size\":" << size << ",\"refs\":" << refs
+         << ",\"roots\":" << roots << ",\"edges\":[";
+    for (size_t i = 0; i < edges_.size(); ++i) {
+        if (i != 0) out_ << ',';
+        out_ << uintptr_t(edges_[i]);
+    }
+    out_ << "]}\n";
+}
+
+} // end namespace detail
+} // end namespace gc
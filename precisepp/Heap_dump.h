@@ -0,0 +1,70 @@
+// A `Heap_dump` writes a snapshot of the heap as it’s walked, one JSON
+// object per line, so dumping doesn’t need memory proportional to the heap.
+// The lines are:
+//
+//     {"space":0,"type":"node<int>","kind":"object","element_size":24}
+//     {"object":94213,"space":0,"size":40,"refs":2,"roots":1,"edges":[94253]}
+//
+// A "space" line describes the space that the "object" lines following it
+// belong to. Each object is identified by its address, and its edges are
+// the addresses of the objects it points to. "refs" is its reference count
+// and "roots" is how many of those references come from outside the heap,
+// so objects with non-zero "roots" are the roots. See
+// tools/heap_dominators.cpp for a tool that reads these.
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace gc
+{
+namespace detail
+{
+
+// The demangled name of a type, for dumps and reports.
+std::string type_name(const std::type_info&);
+
+class Heap_dump
+{
+public:
+    explicit Heap_dump(std::ostream& out) : out_(out)
+    { }
+
+    // Collects the edges out of an object, for `object`.
+    struct Edge_tracer
+    {
+        std::vector<const void*>* edges;
+
+        template <typename P>
+        void operator()(P ptr) const
+        {
+            if (ptr != nullptr) edges->push_back(ptr);
+        }
+    };
+
+    // Writes a "space" line; the objects written next belong to it.
+    void space(const std::type_info& type, const char* kind,
+               size_t element_size);
+
+    // Returns a tracer for collecting the edges of the next object.
+    Edge_tracer edge_tracer()
+    {
+        edges_.clear();
+        return Edge_tracer{&edges_};
+    }
+
+    // Writes an "object" line, with the edges collected since
+    // `edge_tracer` was last called.
+    void object(const void* ptr, size_t size, size_t refs, size_t roots);
+
+private:
+    std::ostream&            out_;
+    size_t                   spaces_ = 0;
+    std::vector<const void*> edges_;
+};
+
+} // end namespace detail
+} // end namespace gc
@@ -0,0 +1,375 @@
+#include "Heap_image.h"
+
+#ifndef PRECISEPP_ROOT_REGISTRY
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// An image is a sequence of 64-bit words in the machine’s byte order, with
+// the elements’ bytes in the middle:
+//
+//     magic
+//     type count, then for each type: name length, name bytes, element size
+//     object count, then for each object: type, element count
+//     byte count, then the elements of each object in turn
+//     fixup count, then for each fixup: object, offset, type pointed to,
+//         target object
+//
+// The name bytes and element bytes aren’t padded. The root is object 0.
+
+namespace gc
+{
+
+namespace detail
+{
+
+namespace
+{
+
+constexpr uint64_t image_magic = 0x3230676d69707070; // "pppimg02"
+
+// Constructed on first use, since types are registered by static
+// initializers.
+std::unordered_map<std::string, const Image_ops*>& image_types()
+{
+    static std::unordered_map<std::string, const Image_ops*> types;
+    return types;
+}
+
+void write_word(std::ostream& out, uint64_t word)
+{
+    out.write(reinterpret_cast<const char*>(&word), sizeof word);
+}
+
+// Reads an image that has been mapped into memory.
+class Image_reader
+{
+public:
+    Image_reader(const char* begin, size_t size)
+            : next_{begin}
+            , end_{begin + size}
+    { }
+
+    uint64_t word()
+    {
+        uint64_t result;
+        std::memcpy(&result, bytes(sizeof result), sizeof result);
+        return result;
+    }
+
+    // Reads the number of entries in a table whose entries take at least
+    // `entry_size` bytes each.
+    uint64_t count(size_t entry_size)
+    {
+        uint64_t result = word();
+        if (result > uint64_t(end_ - next_) / entry_size)
+            throw std::runtime_error{"precisepp: heap image is truncated"};
+        return result;
+    }
+
+    // Returns the next `count` bytes and skips them.
+    const char* bytes(uint64_t count)
+    {
+        if (count > uint64_t(end_ - next_))
+            throw std::runtime_error{"precisepp: heap image is truncated"};
+        const char* result = next_;
+        next_ += count;
+        return result;
+    }
+
+private:
+    const char* next_;
+    const char* end_;
+};
+
+// Unmaps an image file when loading is done.
+class Image_mapping
+{
+public:
+    explicit Image_mapping(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error{"precisepp: can’t open heap image " +
+                                     path};
+
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            size_   = size_t(status.st_size);
+            memory_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+
+        if (memory_ == MAP_FAILED)
+            throw std::runtime_error{"precisepp: can’t map heap image " +
+                                     path};
+    }
+
+    ~Image_mapping()
+    {
+        munmap(memory_, size_);
+    }
+
+    Image_mapping(const Image_mapping&) = delete;
+    Image_mapping& operator=(const Image_mapping&) = delete;
+
+    const char* begin() const
+    {
+        return static_cast<const char*>(memory_);
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    void*  memory_ = MAP_FAILED;
+    size_t size_   = 0;
+};
+
+void bad_image(const char* problem)
+{
+    throw std::runtime_error{std::string{"precisepp: bad heap image: "} +
+                             problem};
+}
+
+} // end anonymous namespace
+
+bool register_image_type(const Image_ops& ops)
+{
+    image_types().emplace(ops.type.name(), &ops);
+    return true;
+}
+
+size_t Image_writer::type_index_(const Image_ops& ops)
+{
+    size_t type = size_t(std::find(types_.begin(), types_.end(), &ops) -
+                         types_.begin());
+    if (type == types_.size()) types_.push_back(&ops);
+    return type;
+}
+
+size_t Image_writer::index_(const void* ptr, const Image_ops& ops)
+{
+    auto found = indices_.find(ptr);
+    if (found != indices_.end()) return found->second;
+
+    size_t index = objects_.size();
+    objects_.push_back({ptr, &ops, type_index_(ops), 0, 0});
+    indices_.emplace(ptr, index);
+    return index;
+}
+
+void Image_writer::elements(const void* bytes, size_t count)
+{
+    Object& object = objects_[current_];
+    object.count = count;
+    object.bytes = bytes_.size();
+
+    auto begin = static_cast<const char*>(bytes);
+    bytes_.insert(bytes_.end(), begin,
+                  begin + count * object.ops->element_size);
+}
+
+void Image_writer::pointer(size_t offset, const void* target,
+                           const Image_ops& ops)
+{
+    if (target == nullptr) return;
+
+    size_t index = index_(target, ops);
+    std::memset(&bytes_[objects_[current_].bytes + offset], 0,
+                sizeof(void*));
+    fixups_.push_back({current_, offset, type_index_(ops), index});
+}
+
+void Image_writer::write(const void* root, const Image_ops& ops)
+{
+    if (root != nullptr) index_(root, ops);
+
+    for (current_ = 0; current_ < objects_.size(); ++current_)
+        objects_[current_].ops->save(objects_[current_].ptr, *this);
+
+    write_word(out_, image_magic);
+
+    write_word(out_, types_.size());
+    for (const Image_ops* type : types_) {
+        std::string name = type->type.name();
+        write_word(out_, name.size());
+        out_.write(name.data(), std::streamsize(name.size()));
+        write_word(out_, type->element_size);
+    }
+
+    write_word(out_, objects_.size());
+    for (const Object& object : objects_) {
+        write_word(out_, object.type);
+        write_word(out_, object.count);
+    }
+
+    write_word(out_, bytes_.size());
+    out_.write(bytes_.data(), std::streamsize(bytes_.size()));
+
+    write_word(out_, fixups_.size());
+    for (const Fixup& fixup : fixups_) {
+        write_word(out_, fixup.object);
+        write_word(out_, fixup.offset);
+        write_word(out_, fixup.type);
+        write_word(out_, fixup.target);
+    }
+}
+
+void* load_image_file(const std::string& path,
+                      const std::type_info& root_type)
+{
+    Image_mapping mapping{path};
+    Image_reader  in{mapping.begin(), mapping.size()};
+
+    if (in.word() != image_magic) bad_image("not a heap image");
+
+    std::vector<const Image_ops*> types(in.count(2 * sizeof(uint64_t)));
+    for (const Image_ops*& type : types) {
+        uint64_t    length = in.word();
+        std::string name{in.bytes(length), length};
+        auto found = image_types().find(name);
+        if (found == image_types().end())
+            bad_image("type unknown to this program");
+        type = found->second;
+        if (in.word() != type->element_size)
+            bad_image("type has changed size");
+    }
+
+    struct Object
+    {
+        const Image_ops* ops;
+        uint64_t         count;
+        void*            ptr;
+        size_t           refs;
+    };
+
+    std::vector<Object> objects(in.count(2 * sizeof(uint64_t)));
+    uint64_t total = 0;
+    for (Object& object : objects) {
+        uint64_t type = in.word();
+        if (type >= types.size()) bad_image("type out of range");
+        object.ops   = types[type];
+        object.count = in.word();
+        if (!object.ops->array && object.count != 1)
+            bad_image("object has more than one element");
+        if (object.count > mapping.size() / object.ops->element_size)
+            bad_image("object is too big");
+        object.ptr   = nullptr;
+        object.refs  = 0;
+        total += object.count * object.ops->element_size;
+    }
+
+    if (objects.empty()) return nullptr;
+    if (objects[0].ops->type != root_type) bad_image("root has wrong type");
+
+    if (in.word() != total) bad_image("wrong number of bytes");
+    const char* bytes = in.bytes(total);
+
+    // Check the fixups before allocating anything: each must fill in a
+    // pointer field of its object, once, with an object of the type the
+    // field points to.
+    struct Fixup
+    {
+        uint64_t from;
+        uint64_t offset;
+        uint64_t to;
+
+        bool operator<(const Fixup& other) const
+        {
+            return from != other.from ? from < other.from
+                                      : offset < other.offset;
+        }
+    };
+
+    std::vector<Fixup> fixups(in.count(4 * sizeof(uint64_t)));
+    for (Fixup& fixup : fixups) {
+        fixup.from      = in.word();
+        fixup.offset    = in.word();
+        uint64_t type   = in.word();
+        fixup.to        = in.word();
+        if (fixup.from >= objects.size() || fixup.to >= objects.size() ||
+                type >= types.size())
+            bad_image("fixup out of range");
+        if (types[type] != objects[fixup.to].ops)
+            bad_image("fixup points to the wrong type");
+    }
+    std::sort(fixups.begin(), fixups.end());
+
+    // The fields are found by tracing an aligned copy of each object’s
+    // bytes, whose pointers are still null.
+    std::vector<size_t> starts(objects.size());
+    for (size_t i = 0, start = 0; i < objects.size(); ++i) {
+        starts[i] = start;
+        start += objects[i].count * objects[i].ops->element_size;
+    }
+    std::vector<std::max_align_t> copy;
+    std::vector<Image_field>      fields;
+    for (auto fixup = fixups.begin(); fixup != fixups.end(); ) {
+        const Object& from  = objects[fixup->from];
+        size_t        size  = from.count * from.ops->element_size;
+        copy.resize(size / sizeof(std::max_align_t) + 1);
+        std::memcpy(copy.data(), bytes + starts[fixup->from], size);
+        fields.clear();
+        from.ops->fields(reinterpret_cast<const char*>(copy.data()),
+                         from.count, fields);
+        std::sort(fields.begin(), fields.end(),
+                  [](const Image_field& a, const Image_field& b) {
+                      return a.offset < b.offset;
+                  });
+
+        auto end = std::find_if(fixup, fixups.end(), [fixup](const Fixup& f) {
+            return f.from != fixup->from;
+        });
+        for (auto f = fixup; f != end; ++f) {
+            if (f != fixup && (f - 1)->offset == f->offset)
+                bad_image("pointer fixed up twice");
+            auto field = std::lower_bound(
+                    fields.begin(), fields.end(), f->offset,
+                    [](const Image_field& a, uint64_t offset) {
+                        return a.offset < offset;
+                    });
+            if (field == fields.end() || field->offset != f->offset)
+                bad_image("fixup isn’t at a pointer");
+            if (field->ops != objects[f->to].ops)
+                bad_image("fixup points to the wrong type");
+        }
+        fixup = end;
+    }
+
+    // One pass to copy the objects, and then one to link them up. Arrays
+    // are held by their initial reference until then.
+    for (Object& object : objects) {
+        object.ptr = object.ops->load(bytes, object.count);
+        bytes += object.count * object.ops->element_size;
+    }
+
+    for (const Fixup& fixup : fixups) {
+        Object& from = objects[fixup.from];
+        Object& to   = objects[fixup.to];
+        std::memcpy(from.ops->elements(from.ptr) + fixup.offset, &to.ptr,
+                    sizeof(void*));
+        ++to.refs;
+    }
+
+    for (Object& object : objects)
+        object.ops->set_count(object.ptr, object.refs);
+
+    return objects[0].ptr;
+}
+
+} // end namespace detail
+
+} // end namespace gc
+
+#endif // PRECISEPP_ROOT_REGISTRY
@@ -0,0 +1,379 @@
+// A heap image is a file holding the graph of objects reachable from one
+// `traced_ptr`, so that a program can build a large structure that never
+// changes (a routing table, a parsed configuration) once, save it, and on
+// later runs load it instead of rebuilding it:
+//
+//     if (have_image)
+//         table = gc::load_image<Routing_table>("routes.img");
+//     else {
+//         table = build_routing_table();
+//         std::ofstream out{"routes.img", std::ios::binary};
+//         gc::save_image(out, table);
+//     }
+//
+// The image holds each object’s bytes, with its pointers nulled, and a
+// list of fixups saying which object each pointer field refers to. The
+// pointer fields are found by tracing, with the objects’ `Traceable`s.
+// Loading maps the file and makes one pass over it, copying each object
+// into a new slot without running any constructor, and then a second
+// pass to apply the fixups and set the reference counts. Each fixup also
+// names the type it points to, and before allocating anything, loading
+// checks it against the target’s type and against the pointer fields that
+// tracing a copy of the object’s bytes finds at its offset.
+//
+// Loaded objects are immortal, like those of `make_traced_immortal`
+// (arrays, which can’t be immortal, are ordinary arrays held by them), and
+// are allocated in the spaces of the default allocator. Only images
+// written by the same build of the same program are meaningful; loading
+// checks that the types, their sizes, and their pointers match, but not
+// the values of other fields.
+//
+// Every type in the graph must be `imageable`, meaning that a copy of its
+// bytes is a valid object in another run of the program once its traced
+// pointers are filled in. That holds for trivially copyable types, for
+// traced pointers, `gc::vector` and `gc::hash_map` (given imageable
+// elements), and for pairs of imageable types. Specialize `imageable` as
+// `std::true_type` for a class whose fields are all imageable. A class
+// holding any other pointer (including inside a `std::string`), a weak
+// pointer, or a virtual function table is not.
+//
+// Heap images aren’t available with a root registry, since a pointer in a
+// copied object would have to be registered.
+#pragma once
+
+#ifndef PRECISEPP_ROOT_REGISTRY
+
+#include "forward.h"
+#include "Array_space.h"
+#include "Traced.h"
+#include "traced_array.h"
+#include "traced_ptr.h"
+#include "Typed_space.h"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gc
+{
+
+template <typename T>
+struct imageable : std::is_trivially_copyable<T>
+{ };
+
+template <typename T, typename Allocator, typename Barrier>
+struct imageable<traced_ptr<T, Allocator, Barrier>> : std::true_type
+{ };
+
+template <typename T, typename Allocator>
+struct imageable<traced_array<T, Allocator>> : std::true_type
+{ };
+
+template <typename T1, typename T2>
+struct imageable<std::pair<T1, T2>>
+        : std::integral_constant<bool,
+                imageable<std::remove_cv_t<T1>>::value &&
+                imageable<std::remove_cv_t<T2>>::value>
+{ };
+
+namespace detail
+{
+
+class Image_writer;
+struct Image_ops;
+
+// A pointer field in an object’s elements: its offset from the first
+// element, and the traced type it points to.
+struct Image_field
+{
+    size_t           offset;
+    const Image_ops* ops;
+};
+
+// What saving and loading need to know about a traced type, `Traced<T>` or
+// `Traced_array<T>`. An object of either has elements: the one `T`, or the
+// array’s elements.
+struct Image_ops
+{
+    const std::type_info& type;
+    size_t element_size;
+    bool   array;        // Else it has just one element
+
+    // Adds the object’s elements to the writer, and then its pointers.
+    void (*save)(const void* ptr, Image_writer& writer);
+
+    // Allocates an object with `count` elements copied from `bytes`.
+    void* (*load)(const char* bytes, size_t count);
+
+    // The address of the object’s first element.
+    char* (*elements)(void* ptr);
+
+    // Sets the object’s reference count.
+    void (*set_count)(void* ptr, size_t count);
+
+    // Appends the pointer fields of `count` elements at `elements`, a
+    // suitably aligned copy of an object’s bytes, to `fields`.
+    void (*fields)(const char* elements, size_t count,
+                   std::vector<Image_field>& fields);
+};
+
+// Writes the objects reachable from one, breadth first.
+class Image_writer
+{
+public:
+    explicit Image_writer(std::ostream& out) : out_(out)
+    { }
+
+    // Writes the image of the graph starting at `root`, which may be null.
+    // Its traced type has the given `ops`.
+    void write(const void* root, const Image_ops& ops);
+
+    // Called by `Image_ops::save` for each object: first with its
+    // elements’ bytes, and then for each pointer field, given its offset
+    // from the first element and its value.
+    void elements(const void* bytes, size_t count);
+    void pointer(size_t offset, const void* target, const Image_ops& ops);
+
+private:
+    struct Object
+    {
+        const void*      ptr;
+        const Image_ops* ops;
+        size_t           type;    // Index in `types_`
+        size_t           count;   // Of elements
+        size_t           bytes;   // Offset in `bytes_`
+    };
+
+    struct Fixup
+    {
+        size_t object;
+        size_t offset;
+        size_t type;      // What the field points to, in `types_`
+        size_t target;
+    };
+
+    std::ostream&                  out_;
+    std::vector<const Image_ops*>  types_;
+    std::vector<Object>            objects_;
+    std::vector<char>              bytes_;
+    std::vector<Fixup>             fixups_;
+    std::unordered_map<const void*, size_t> indices_; // Into `objects_`
+    size_t                         current_;   // The object being saved
+
+    size_t type_index_(const Image_ops& ops);
+    size_t index_(const void* ptr, const Image_ops& ops);
+};
+
+// Loads the image at `path`, whose root must have traced type `root_type`,
+// returning the root (or null).
+void* load_image_file(const std::string& path,
+                      const std::type_info& root_type);
+
+// Records the operations for a traced type, for loading. Returns true, for
+// use in static initializers.
+bool register_image_type(const Image_ops& ops);
+
+// Calls the writer for each pointer in an object being saved.
+class Image_tracer
+{
+public:
+    Image_tracer(Image_writer& writer, const void* elements)
+            : writer_(&writer)
+            , elements_(static_cast<const char*>(elements))
+    { }
+
+    template <typename P>
+    void operator()(P* const& field) const;
+
+private:
+    Image_writer* writer_;
+    const char*   elements_;
+};
+
+// Collects the pointer fields of an object being loaded.
+class Image_field_tracer
+{
+public:
+    Image_field_tracer(std::vector<Image_field>& fields, const char* elements)
+            : fields_(&fields)
+            , elements_(elements)
+    { }
+
+    template <typename P>
+    void operator()(P* const& field) const;
+
+private:
+    std::vector<Image_field>* fields_;
+    const char*               elements_;
+};
+
+// The `Image_ops` of each traced type, which are registered for loading
+// by a static initializer. Saving a type instantiates the `Image_type`s of
+// the types it can point to, so every type an image can hold is
+// registered wherever the root type’s can be loaded.
+template <typename P>
+struct Image_type;
+
+template <typename T>
+struct Image_type<Traced<T>>
+{
+    static_assert(imageable<T>::value,
+                  "heap images need gc::imageable<T> (see Heap_image.h)");
+
+    static const Image_ops ops;
+    static const bool      registered;
+
+    static void save(const void* ptr, Image_writer& writer)
+    {
+        auto traced = static_cast<Traced<T>*>(const_cast<void*>(ptr));
+        writer.elements(&traced->object_(), 1);
+        traced->trace_object_(Image_tracer{writer, &traced->object_()});
+    }
+
+    static void* load(const char* bytes, size_t)
+    {
+        return Typed_space<T>::instance().allocate_image_(bytes);
+    }
+
+    static char* elements(void* ptr)
+    {
+        return reinterpret_cast<char*>(
+                &static_cast<Traced<T>*>(ptr)->object_());
+    }
+
+    static void set_count(void* ptr, size_t count)
+    {
+        static_cast<Traced<T>*>(ptr)->set_ref_count_(count);
+    }
+
+    static void fields(const char* elements, size_t,
+                       std::vector<Image_field>& fields)
+    {
+        ::gc::detail::trace(*reinterpret_cast<const T*>(elements),
+                            Image_field_tracer{fields, elements});
+    }
+
+    template <typename Allocator, typename Barrier>
+    static void save_root(std::ostream& out,
+                          const traced_ptr<T, Allocator, Barrier>& root)
+    {
+        Image_writer writer{out};
+        writer.write(root.ptr_, ops);
+    }
+
+    static traced_ptr<T> load_root(const std::string& path)
+    {
+        (void) &registered;
+
+        traced_ptr<T> result;
+        result.ptr_ = static_cast<Traced<T>*>(
+                load_image_file(path, typeid(Traced<T>)));
+        result.inc_();
+        return result;
+    }
+};
+
+template <typename T>
+const Image_ops Image_type<Traced<T>>::ops = {
+        typeid(Traced<T>), sizeof(T), false, &save, &load, &elements,
+        &set_count, &fields};
+
+template <typename T>
+const bool Image_type<Traced<T>>::registered = register_image_type(ops);
+
+template <typename T>
+struct Image_type<Traced_array<T>>
+{
+    static_assert(imageable<T>::value,
+                  "heap images need gc::imageable<T> (see Heap_image.h)");
+
+    static const Image_ops ops;
+    static const bool      registered;
+
+    static void save(const void* ptr, Image_writer& writer)
+    {
+        auto traced = static_cast<Traced_array<T>*>(const_cast<void*>(ptr));
+        writer.elements(traced->elements_(), traced->size_());
+        traced->trace_object_(Image_tracer{writer, traced->elements_()});
+    }
+
+    static void* load(const char* bytes, size_t count)
+    {
+        return Array_space<T>::instance().allocate_image_(bytes, count);
+    }
+
+    static char* elements(void* ptr)
+    {
+        return reinterpret_cast<char*>(
+                static_cast<Traced_array<T>*>(ptr)->elements_());
+    }
+
+    static void set_count(void* ptr, size_t count)
+    {
+        static_cast<Traced_array<T>*>(ptr)->set_ref_count_(count);
+    }
+
+    static void fields(const char* elements, size_t count,
+                       std::vector<Image_field>& fields)
+    {
+        if (!::gc::contains_pointers<T>) return;
+        auto array = reinterpret_cast<const T*>(elements);
+        for (size_t i = 0; i < count; ++i)
+            ::gc::detail::trace(array[i],
+                                Image_field_tracer{fields, elements});
+    }
+};
+
+template <typename T>
+const Image_ops Image_type<Traced_array<T>>::ops = {
+        typeid(Traced_array<T>), sizeof(T), true, &save, &load, &elements,
+        &set_count, &fields};
+
+template <typename T>
+const bool Image_type<Traced_array<T>>::registered = register_image_type(ops);
+
+template <typename P>
+void Image_tracer::operator()(P* const& field) const
+{
+    (void) &Image_type<P>::registered;
+    writer_->pointer(size_t(reinterpret_cast<const char*>(&field) - elements_),
+                     field, Image_type<P>::ops);
+}
+
+template <typename P>
+void Image_field_tracer::operator()(P* const& field) const
+{
+    (void) &Image_type<P>::registered;
+    fields_->push_back(
+            {size_t(reinterpret_cast<const char*>(&field) - elements_),
+             &Image_type<P>::ops});
+}
+
+} // end namespace detail
+
+// Writes the graph of objects reachable from `root` to `out`, as an image
+// for `load_image`. The stream should be binary.
+template <typename T, typename Allocator, typename Barrier>
+void save_image(std::ostream& out,
+                const traced_ptr<T, Allocator, Barrier>& root)
+{
+    detail::Image_type<Traced<T>>::save_root(out, root);
+}
+
+// Loads an image written by `save_image`, whose root must be a `T`,
+// returning the root. Throws `std::runtime_error` if the file can’t be read
+// or doesn’t match this program.
+template <typename T>
+traced_ptr<T> load_image(const std::string& path)
+{
+    return detail::Image_type<Traced<T>>::load_root(path);
+}
+
+} // end namespace gc
+
+#endif // PRECISEPP_ROOT_REGISTRY
@@ -0,0 +1,67 @@
+// A space that hash-conses keeps an `Intern_table` of the objects made by
+// `make_interned`, so that making an object equal to one still alive
+// returns the one alive. The table holds its objects weakly: the space
+// prunes the ones a collection finds dead when it clears weak pointers,
+// before any of them is destroyed, so an entry never outlives its object.
+//
+// Each entry keeps its object’s hash, since a dead object can’t be hashed
+// again, and so that lookups only compare objects whose hashes match.
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+
+namespace gc
+{
+
+namespace detail
+{
+
+template <typename Object>
+class Intern_table
+{
+public:
+    bool empty() const
+    {
+        return entries_.empty();
+    }
+
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    // Returns an object with the given hash for which `equal` holds, or null
+    // if there is none.
+    template <typename Equal>
+    Object* find(size_t hash, Equal equal) const
+    {
+        auto range = entries_.equal_range(hash);
+        for (auto i = range.first; i != range.second; ++i)
+            if (equal(i->second)) return i->second;
+        return nullptr;
+    }
+
+    void insert(size_t hash, Object* ptr)
+    {
+        entries_.emplace(hash, ptr);
+    }
+
+    // Removes every object for which `dead` holds.
+    template <typename Dead>
+    void prune(Dead dead)
+    {
+        for (auto i = entries_.begin(); i != entries_.end(); )
+            if (dead(i->second))
+                i = entries_.erase(i);
+            else
+                ++i;
+    }
+
+private:
+    std::unordered_multimap<size_t, Object*> entries_;
+};
+
+} // end namespace detail
+
+} // end namespace gc
@@ -0,0 +1,112 @@
+#include "Large_object_space.h"
+
+#include <algorithm>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "write_barrier.h"
+
+namespace gc
+{
+namespace detail
+{
+
+namespace
+{
+
+size_t page_size()
+{
+    static const size_t result = size_t(sysconf(_SC_PAGESIZE));
+    return result;
+}
+
+} // end anonymous namespace
+
+Large_object_space_base::Large_object_space_base()
+        : bytes_{0}
+        , limit_{initial_large_object_limit}
+{ }
+
+Large_object_space_base::~Large_object_space_base()
+{
+    release();
+    for (Block_header* header : blocks_)
+        if (header != nullptr) {
+            remove_heap_range(header, header->bytes);
+            munmap(header, header->bytes);
+        }
+}
+
+Large_object_space_base::Block_header*
+Large_object_space_base::map_block_(size_t offset, size_t bytes)
+{
+    size_t mapped = (offset + bytes + page_size() - 1) / page_size()
+                    * page_size();
+
+    log(debug2) << "map_block_(" << bytes << ") mapping " << mapped;
+
+    size_t index;
+    if (free_indices_.empty()) {
+        index = blocks_.size();
+        blocks_.push_back(nullptr);
+        if (index % word_bits == 0) {
+            used_.push_back(0);
+            marks_.push_back(0);
+        }
+    } else {
+        index = free_indices_.back();
+        free_indices_.pop_back();
+    }
+
+    void* memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        free_indices_.push_back(index);
+        throw std::bad_alloc{};
+    }
+
+    auto header    = static_cast<Block_header*>(memory);
+    header->owner  = this;
+    header->index  = index;
+    header->bytes  = mapped;
+
+    blocks_[index] = header;
+    set_bit(used_.data(), index);
+    bytes_ += mapped;
+    add_heap_range(header, mapped);
+
+    return header;
+}
+
+void Large_object_space_base::unmap_block_(Block_header* header)
+{
+    size_t index = header->index;
+
+    log(debug2) << "unmap_block_(" << header << ") unmapping "
+                << header->bytes;
+
+    clear_bit(used_.data(), index);
+    clear_bit(marks_.data(), index);
+    blocks_[index] = nullptr;
+    free_indices_.push_back(index);
+    bytes_ -= header->bytes;
+
+    remove_heap_range(header, header->bytes);
+    munmap(header, header->bytes);
+}
+
+void Large_object_space_base::release()
+{
+    for (Block_header* header : dead_)
+        unmap_block_(header);
+    dead_.clear();
+
+    limit_ = std::max(initial_large_object_limit,
+                      size_t(bytes_ / max_live_ratio));
+}
+
+} // end namespace detail
+} // end namespace gc
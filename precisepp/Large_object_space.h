@@ -0,0 +1,208 @@
+// Objects too big to share a page with others live in a
+// `Large_object_space`, which gives each one its own block mapped directly
+// from the operating system. Mark bits for large objects are kept
+// out-of-line in a bitmap, so sweeping never has to touch a dead object’s
+// memory before the block is unmapped (unless it has a destructor to run).
+// Dead blocks are unmapped in the release phase, after every space has
+// swept, since destructors run in other spaces’ sweeps may still decrement
+// their reference counts.
+#pragma once
+
+#include "bitmap.h"
+#include "Space.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gc
+{
+
+// Objects (or array blocks) bigger than this many bytes are large objects.
+static constexpr size_t large_object_size = 16 * 1024;
+
+// The number of bytes of large objects a space allocates before its first
+// collection.
+static constexpr size_t initial_large_object_limit = 1024 * 1024;
+
+namespace detail
+{
+
+// The untyped part of a `Large_object_space`: mapping and unmapping blocks,
+// the mark bitmap, and accounting.
+class Large_object_space_base
+{
+protected:
+    // Each block starts with a `Block_header`, which is followed (after
+    // padding for alignment) by the object.
+    struct Block_header
+    {
+        Large_object_space_base* owner;
+        size_t                   index;  // Index of this block’s bits
+        size_t                   bytes;  // Mapped size of the block
+#ifdef PRECISEPP_COMPACT_HEADERS
+        size_t                   root_count; // Of a `Traced<T>` (see Traced.h)
+#endif
+    };
+
+    std::vector<Block_header*> blocks_;       // By index; null if unused
+    std::vector<word_t>        used_;         // Bitmap of used indices
+    std::vector<word_t>        marks_;        // Out-of-line mark bits
+    std::vector<size_t>        free_indices_; // Indices to reuse
+    std::vector<Block_header*> dead_;         // Swept, awaiting unmapping
+    std::vector<word_t>        dead_bits_;    // Scratch for `sweep_`
+    size_t                     bytes_;        // Total bytes mapped
+    size_t                     limit_;        // Collect before passing this
+
+    Large_object_space_base();
+    ~Large_object_space_base();
+
+    Large_object_space_base(const Large_object_space_base&) = delete;
+    Large_object_space_base& operator=(const Large_object_space_base&) = delete;
+
+    // Maps a block with room for `bytes` bytes after `offset` bytes of
+    // header, and gives it an index.
+    Block_header* map_block_(size_t offset, size_t bytes);
+
+    // Unmaps a block and frees its index.
+    void unmap_block_(Block_header*);
+
+    // Sets the mark bit for a block, returning whether it was already set.
+    static bool test_and_set_mark_(Block_header* header)
+    {
+        return test_and_set_bit(header->owner->marks_.data(), header->index);
+    }
+
+    // Whether the mark bit for a block is set.
+    static bool is_marked_(Block_header* header)
+    {
+        return test_bit(header->owner->marks_.data(), header->index);
+    }
+
+    // Passes every used, unmarked block to `f` and queues it to be
+    // unmapped, and then clears all the marks. The bitmaps are swept in
+    // bulk by the sweep kernel first.
+    template <typename F>
+    void sweep_(F f)
+    {
+        dead_bits_.resize(used_.size());
+        sweep_bits(used_.data(), marks_.data(), dead_bits_.data(),
+                   used_.size());
+        for_each_bit(dead_bits_.data(), dead_bits_.size(),
+                     [this, &f](size_t index) {
+            f(blocks_[index]);
+            dead_.push_back(blocks_[index]);
+        });
+    }
+
+public:
+    // Unmaps the blocks found dead by the last sweep, and resets the
+    // collection threshold based on how much survived.
+    void release();
+
+    // Whether allocating `bytes` more should trigger a collection first.
+    bool should_collect(size_t bytes) const
+    {
+        return bytes_ + bytes > limit_;
+    }
+
+    // The total number of bytes mapped for large objects.
+    size_t bytes() const
+    {
+        return bytes_;
+    }
+};
+
+// The large objects of type `B`, which is `Traced<T>` or `Traced_array<T>`.
+// The caller constructs and destroys the objects; this only manages memory
+// and marks.
+template <typename B>
+class Large_object_space : private Large_object_space_base
+{
+public:
+    // Returns uninitialized memory for a `B` of `bytes` bytes (which may be
+    // more than `sizeof(B)`, for arrays).
+    B* allocate(size_t bytes)
+    {
+        return object_of_(map_block_(offset_, bytes));
+    }
+
+    // Returns the memory for a `B` that was never constructed, or has
+    // already been destroyed.
+    void deallocate(B* ptr)
+    {
+        unmap_block_(header_of_(ptr));
+    }
+
+    // Sets the mark bit of a large object, returning whether it was already
+    // set.
+    static bool test_and_set_mark(B* ptr)
+    {
+        return test_and_set_mark_(header_of_(ptr));
+    }
+
+    // The number of bytes available to a large object, which is what was
+    // asked for rounded up to the end of the last page.
+    static size_t size(B* ptr)
+    {
+        return header_of_(ptr)->bytes - offset_;
+    }
+
+#ifdef PRECISEPP_COMPACT_HEADERS
+    // Where a large object’s root count is kept when its own header is
+    // compact.
+    static size_t& root_count(B* ptr)
+    {
+        return header_of_(ptr)->root_count;
+    }
+#endif
+
+    // Whether a large object’s mark bit is set.
+    static bool is_marked(B* ptr)
+    {
+        return is_marked_(header_of_(ptr));
+    }
+
+    // Calls the given function on each large object.
+    template <typename F>
+    void for_each(F f)
+    {
+        for_each_bit(used_.data(), used_.size(), [this, &f](size_t index) {
+            f(object_of_(blocks_[index]));
+        });
+    }
+
+    // Passes each unmarked object to `f`, which should destroy it (now or
+    // later, but before `release`), and queues its block to be unmapped by
+    // `release`. Clears all marks.
+    template <typename F>
+    void sweep(F f)
+    {
+        sweep_([&f](Block_header* header) {
+            f(object_of_(header));
+        });
+    }
+
+    using Large_object_space_base::release;
+    using Large_object_space_base::should_collect;
+    using Large_object_space_base::bytes;
+
+private:
+    // The offset from the start of a block to its object.
+    static constexpr size_t offset_ =
+            (sizeof(Block_header) + alignof(B) - 1) / alignof(B) * alignof(B);
+
+    static B* object_of_(Block_header* header)
+    {
+        return reinterpret_cast<B*>(reinterpret_cast<char*>(header) + offset_);
+    }
+
+    static Block_header* header_of_(B* ptr)
+    {
+        return reinterpret_cast<Block_header*>(
+                reinterpret_cast<char*>(ptr) - offset_);
+    }
+};
+
+} // end namespace detail
+} // end namespace gc
@@ -0,0 +1,31 @@
+#include "Marker.h"
+
+namespace gc
+{
+namespace detail
+{
+
+void Marker::drain()
+{
+    for (;;) {
+        // Top up the FIFO from the stack, prefetching as we go.
+        while (count_ < mark_prefetch_distance && !stack_.empty()) {
+            Grey grey = stack_.back();
+            stack_.pop_back();
+            __builtin_prefetch(grey.ptr, 1);
+            fifo_[(head_ + count_) % mark_prefetch_distance] = grey;
+            ++count_;
+        }
+
+        if (count_ == 0) return;
+
+        // Scanning may push more onto the stack.
+        Grey grey = fifo_[head_];
+        head_ = (head_ + 1) % mark_prefetch_distance;
+        --count_;
+        grey.scan(grey.ptr);
+    }
+}
+
+} // end namespace detail
+} // end namespace gc
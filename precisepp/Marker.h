@@ -0,0 +1,52 @@
+// The `Marker` drives the marking phase from an explicit stack of grey
+// (reached but unscanned) objects, rather than by recursion, so deep
+// structures like long lists don’t overflow the control stack.
+//
+// Between the stack and the scanner is a short FIFO. Each object popped
+// from the stack is prefetched as it enters the FIFO, and then waits while
+// the objects ahead of it are scanned, so that when its turn comes it’s
+// (with luck) already in cache. Checking an object’s mark bit is deferred
+// until then too, since that’s the first touch.
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace gc
+{
+namespace detail
+{
+
+// How many objects are in flight between being prefetched and scanned.
+static constexpr size_t mark_prefetch_distance = 16;
+
+class Marker
+{
+public:
+    // Marks the object (if it isn’t already) and scans it for more grey
+    // objects.
+    using scan_t = void (*)(void* ptr);
+
+    void push(void* ptr, scan_t scan)
+    {
+        stack_.push_back({ptr, scan});
+    }
+
+    // Scans grey objects until there are none left.
+    void drain();
+
+private:
+    struct Grey
+    {
+        void*  ptr;
+        scan_t scan;
+    };
+
+    std::vector<Grey> stack_;
+    Grey              fifo_[mark_prefetch_distance];
+    size_t            head_  = 0;  // Index of the oldest object in the FIFO
+    size_t            count_ = 0;  // Number of objects in the FIFO
+};
+
+} // end namespace detail
+} // end namespace gc
@@ -0,0 +1,90 @@
+#include "Region.h"
+
+#include "Collector.h"
+#include "Count_log.h"
+#include "Cycle_collector.h"
+#include "logger.h"
+#include "Shared_scope.h"
+
+namespace gc
+{
+
+namespace detail
+{
+
+Region_state regions;
+
+void Region_state::add_page(const void* begin, size_t bytes)
+{
+    auto address = reinterpret_cast<uintptr_t>(begin);
+    auto after   = std::upper_bound(
+            pages_.begin(), pages_.end(), address,
+            [](uintptr_t a, const Page& page) { return a < page.begin; });
+    pages_.insert(after, Page{address, address + bytes});
+}
+
+void Region_state::remove_page(const void* begin)
+{
+    auto address = reinterpret_cast<uintptr_t>(begin);
+    auto found   = std::lower_bound(
+            pages_.begin(), pages_.end(), address,
+            [](const Page& page, uintptr_t a) { return page.begin < a; });
+    if (found != pages_.end() && found->begin == address)
+        pages_.erase(found);
+}
+
+void Region_state::close()
+{
+    if (--depth_ == 0 && !releasing_ && !spaces_.empty()) release_();
+}
+
+void Region_state::release_()
+{
+    // Destructors can’t run in the middle of a collection, and counts
+    // can’t be read while other threads may change them.
+    if (Collector::instance().busy_) {
+        log(debug2) << "region: collector busy";
+        return;
+    }
+
+#ifdef PRECISEPP_BIASED_COUNTS
+    Shared_scope_exclusion exclusion;
+    if (!exclusion) {
+        log(debug2) << "region: shared scopes open";
+        return;
+    }
+#endif
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    apply_count_logs();
+#endif
+
+    // Destructors may allocate, and even open regions, which allocate as
+    // usual until we’re done.
+    std::vector<Region_space*> spaces;
+    spaces.swap(spaces_);
+    releasing_ = true;
+    Cycle_pause cycle_pause;
+
+    for (Region_space* space : spaces) space->region_save_counts();
+    for (Region_space* space : spaces) space->region_find_roots();
+    for (Region_space* space : spaces) space->region_mark();
+    for (Region_space* space : spaces) space->region_clear_weak();
+    for (Region_space* space : spaces) space->region_sweep();
+    // Candidates for cycle collection in the region may have been freed.
+    cycle_collector.forget_if([this](const void* ptr) {
+        return contains(ptr);
+    });
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    // Destructors logged decrements for other dead objects, which must land
+    // before their slots are reused.
+    apply_count_logs();
+#endif
+    for (Region_space* space : spaces) space->region_release();
+
+    releasing_ = false;
+}
+
+} // end namespace detail
+
+} // end namespace gc
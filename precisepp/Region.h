@@ -0,0 +1,161 @@
+// A `region` is a scope whose allocations are cheap to throw away, for
+// work like handling a request, which builds a graph that is garbage as
+// soon as it’s done:
+//
+//     void handle(const Request& request)
+//     {
+//         gc::region scratch;
+//         auto parsed = parse(request);
+//         respond(evaluate(parsed));
+//     }
+//
+// While a region is open, `make_traced` bump-allocates in pages that each
+// space sets aside for regions, instead of taking slots from its free list,
+// and never collects. (Immortal objects, large objects and arrays are
+// allocated as usual.) When the region closes, its objects are sorted out
+// by the arithmetic of phases 1 to 3 of a collection, applied to the region
+// alone: an object is live if its reference count is more than the
+// references it has from other region objects, meaning something outside
+// the region refers to it, or if a live region object refers to it. The
+// dead are destroyed right away, whatever the collector’s finalization.
+//
+// If no object of a type survives, its space’s region pages are reset for
+// the next region, so per-request garbage costs a bump of a pointer and a
+// destructor call each, and never a collection. Otherwise the space’s
+// region pages join its ordinary pages, promoting the survivors where they
+// are (objects don’t move), and the slots of the dead go on its free list.
+//
+// While a region is open its objects are invisible to collections, which
+// keep alive whatever they refer to. Regions nest, but only the outermost
+// one closing releases the objects. If it closes during a collection, or
+// (with `PRECISEPP_BIASED_COUNTS`) while another thread holds a
+// `Shared_scope`, release waits for the next region to close.
+//
+// With a root registry, regions have no effect, since collections find
+// roots from the registry rather than from counts, and wouldn’t see that
+// region objects refer to anything.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace gc
+{
+
+namespace detail
+{
+
+// What a space does when a region closes, in phases that each run for
+// every space in the region before the next, since region objects can
+// refer to each other across spaces.
+class Region_space
+{
+public:
+    // Copies each region object’s `ref_count_` to its `root_count_`, and
+    // clears the marks of the region pages.
+    virtual void region_save_counts() =0;
+
+    // Decrements `root_count_` for every edge between region objects.
+    virtual void region_find_roots() =0;
+
+    // Marks the region objects reachable from those that still have a
+    // root count.
+    virtual void region_mark() =0;
+
+    // Clears weak pointers to unmarked region objects.
+    virtual void region_clear_weak() =0;
+
+    // Destroys the unmarked region objects.
+    virtual void region_sweep() =0;
+
+    // Resets the region pages for reuse if nothing survived in them, or
+    // else adds them to the space’s pages.
+    virtual void region_release() =0;
+
+protected:
+    virtual ~Region_space() = default;
+};
+
+// The regions open, the spaces that allocated in them, and the region
+// pages of every space, which objects in a closing region are told apart
+// by.
+class Region_state
+{
+public:
+    // Whether allocation goes to a region.
+    bool active() const
+    {
+#ifdef PRECISEPP_ROOT_REGISTRY
+        return false;
+#else
+        return depth_ > 0 && !releasing_;
+#endif
+    }
+
+    // Whether `ptr` is in a region page.
+    bool contains(const void* ptr) const
+    {
+        auto address = reinterpret_cast<uintptr_t>(ptr);
+        auto after   = std::upper_bound(
+                pages_.begin(), pages_.end(), address,
+                [](uintptr_t a, const Page& page) { return a < page.begin; });
+        return after != pages_.begin() && address < (after - 1)->end;
+    }
+
+    void add_page(const void* begin, size_t bytes);
+    void remove_page(const void* begin);
+
+    // Notes that `space` has objects in the current region.
+    void join(Region_space& space)
+    {
+        spaces_.push_back(&space);
+    }
+
+    void open()
+    {
+        ++depth_;
+    }
+
+    // Closes a region, and releases its objects if it was the outermost.
+    void close();
+
+private:
+    struct Page
+    {
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    size_t depth_ = 0;
+    bool   releasing_ = false;  // Regions opened meanwhile don’t allocate
+    std::vector<Region_space*> spaces_;
+    std::vector<Page> pages_;   // Sorted by address
+
+    void release_();
+};
+
+extern Region_state regions;
+
+} // end namespace detail
+
+class region
+{
+public:
+    region()
+    {
+        detail::regions.open();
+    }
+
+    ~region()
+    {
+        detail::regions.close();
+    }
+
+    region(const region&) = delete;
+    region& operator=(const region&) = delete;
+};
+
+} // end namespace gc
@@ -0,0 +1,22 @@
+#include "Root_registry.h"
+
+namespace gc
+{
+namespace detail
+{
+
+Root_registry& Root_registry::instance()
+{
+    static Root_registry registry;
+    return registry;
+}
+
+void Root_registry::mark_roots()
+{
+    for (Root_link* root = roots_; root != nullptr; root = root->next)
+        root->mark(root);
+    Space::marker_().drain();
+}
+
+} // end namespace detail
+} // end namespace gc
@@ -0,0 +1,183 @@
+// In root-registry mode (when `PRECISEPP_ROOT_REGISTRY` is defined for the
+// whole program), every `traced_ptr` and `traced_array` outside the GC heap
+// links itself into the `Root_registry` when it’s constructed and unlinks
+// itself when it’s destroyed. The collector then marks from the registered
+// roots directly, instead of finding roots by trial deletion over the
+// whole heap, so a collection touches only live objects until it sweeps.
+//
+// A pointer is outside the heap unless it’s constructed as part of an
+// object that a space is constructing in place (see `Heap_construction`).
+// This means that pointers held by ordinary containers, such as a
+// `std::vector<traced_ptr<T>>` member, are roots: objects that hold them
+// won’t be collected in cycles. Use `gc::vector` and `gc::hash_map`, whose
+// storage is in the heap, instead.
+#pragma once
+
+#include "Space.h"
+#include "Traceable.h"
+
+#include <cstddef>
+
+namespace gc
+{
+namespace detail
+{
+
+// A registered root, which knows how to mark what it points to.
+struct Root_link
+{
+    Root_link* prev;
+    Root_link* next;
+    void     (*mark)(const Root_link*);
+};
+
+class Heap_construction;
+
+class Root_registry
+{
+public:
+    static Root_registry& instance();
+
+    void link(Root_link* root)
+    {
+        root->prev = nullptr;
+        root->next = roots_;
+        if (roots_ != nullptr) roots_->prev = root;
+        roots_ = root;
+    }
+
+    void unlink(Root_link* root)
+    {
+        if (root->prev != nullptr)
+            root->prev->next = root->next;
+        else
+            roots_ = root->next;
+        if (root->next != nullptr)
+            root->next->prev = root->prev;
+    }
+
+    // Whether an object is being constructed in the heap, in which case
+    // collection must wait: its fields aren’t roots, and it isn’t visible
+    // to the collector until it’s finished.
+    bool constructing() const
+    {
+        return constructing_ != nullptr;
+    }
+
+    // Whether `ptr` is inside the innermost object being constructed in the
+    // heap.
+    bool constructing(const void* ptr) const;
+
+    // Pushes every registered root onto the marker and drains it.
+    void mark_roots();
+
+private:
+    friend class Heap_construction;
+
+    Root_link*         roots_        = nullptr;
+    Heap_construction* constructing_ = nullptr;
+
+    Root_registry() = default;
+};
+
+#ifdef PRECISEPP_ROOT_REGISTRY
+
+// Spaces hold one of these while constructing an object in place, so that
+// pointers constructed inside it know they aren’t roots.
+class Heap_construction
+{
+public:
+    Heap_construction(const void* begin, size_t bytes)
+            : begin_{static_cast<const char*>(begin)}
+            , end_{begin_ + bytes}
+            , outer_{Root_registry::instance().constructing_}
+    {
+        Root_registry::instance().constructing_ = this;
+    }
+
+    ~Heap_construction()
+    {
+        Root_registry::instance().constructing_ = outer_;
+    }
+
+    Heap_construction(const Heap_construction&) = delete;
+    Heap_construction& operator=(const Heap_construction&) = delete;
+
+private:
+    friend class Root_registry;
+
+    const char*        begin_;
+    const char*        end_;
+    Heap_construction* outer_;
+};
+
+inline bool Root_registry::constructing(const void* ptr) const
+{
+    if (constructing_ == nullptr) return false;
+    auto p = static_cast<const char*>(ptr);
+    return constructing_->begin_ <= p && p < constructing_->end_;
+}
+
+// The base class of each kind of root, `P`, which registers it unless it’s
+// being constructed in the heap. Copying a `P` doesn’t copy its links.
+template <typename P>
+class Root_hook : private Root_link
+{
+protected:
+    Root_hook()
+    {
+        Root_registry& registry = Root_registry::instance();
+        if (registry.constructing(this)) {
+            mark = nullptr;
+        } else {
+            mark = &mark_;
+            registry.link(this);
+        }
+    }
+
+    Root_hook(const Root_hook&) : Root_hook{}
+    { }
+
+    Root_hook& operator=(const Root_hook&)
+    {
+        return *this;
+    }
+
+    ~Root_hook()
+    {
+        if (mark != nullptr)
+            Root_registry::instance().unlink(this);
+    }
+
+private:
+    static void mark_(const Root_link* link)
+    {
+        auto& hook = static_cast<const Root_hook&>(*link);
+        ::gc::detail::trace(static_cast<const P&>(hook), Mark_tracer{});
+    }
+};
+
+#else // !PRECISEPP_ROOT_REGISTRY
+
+// Without the registry these are empty, and cost nothing.
+
+class Heap_construction
+{
+public:
+    Heap_construction(const void*, size_t)
+    { }
+};
+
+inline bool Root_registry::constructing(const void*) const
+{
+    return false;
+}
+
+template <typename P>
+class Root_hook
+{ };
+
+#endif // PRECISEPP_ROOT_REGISTRY
+
+} // end namespace detail
+} // end namespace gc
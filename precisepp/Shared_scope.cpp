@@ -0,0 +1,79 @@
+#include "Shared_scope.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+namespace gc
+{
+
+namespace detail
+{
+
+namespace
+{
+
+std::atomic<uint32_t> next_thread_id{1};
+
+} // end anonymous namespace
+
+uint32_t new_thread_id()
+{
+    return next_thread_id++;
+}
+
+} // end namespace detail
+
+#ifdef PRECISEPP_BIASED_COUNTS
+
+namespace
+{
+
+// Held while scopes open and close, and by the collector for as long as it
+// runs.
+std::mutex scope_mutex;
+size_t     open_scopes  = 0;
+bool       opened_since = false;  // Since `shared_scopes_opened` asked
+
+} // end anonymous namespace
+
+Shared_scope::Shared_scope()
+{
+    std::lock_guard<std::mutex> lock{scope_mutex};
+    ++open_scopes;
+    opened_since = true;
+}
+
+Shared_scope::~Shared_scope()
+{
+    std::lock_guard<std::mutex> lock{scope_mutex};
+    --open_scopes;
+}
+
+namespace detail
+{
+
+Shared_scope_exclusion::Shared_scope_exclusion()
+{
+    scope_mutex.lock();
+    excluded_ = open_scopes == 0;
+    if (!excluded_) scope_mutex.unlock();
+}
+
+Shared_scope_exclusion::~Shared_scope_exclusion()
+{
+    if (excluded_) scope_mutex.unlock();
+}
+
+bool shared_scopes_opened()
+{
+    bool result  = opened_since;
+    opened_since = false;
+    return result;
+}
+
+} // end namespace detail
+
+#endif // PRECISEPP_BIASED_COUNTS
+
+} // end namespace gc
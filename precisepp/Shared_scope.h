@@ -0,0 +1,97 @@
+// In biased-count mode (when `PRECISEPP_BIASED_COUNTS` is defined for the
+// whole program), `traced_ptr`s and `traced_array`s can be copied, moved,
+// and destroyed on more than one thread, so that a graph built on one
+// thread can be read from others.
+//
+// Counting is biased toward the thread that allocated each object, its
+// *owner*: the owner counts references in `ref_count`, without atomic
+// operations, and every other thread counts in a separate atomic
+// `shared_count`. Phase 1 of each collection folds the shared count into
+// the owner’s.
+//
+// Allocation and collection are still for one thread at a time. Any other
+// thread must do its counting inside a `gc::Shared_scope`: a collection
+// doesn’t start while a scope is open (the allocating space grows
+// instead), and a scope doesn’t open while a collection is running. Work
+// inside scopes may read the heap and copy and drop pointers, but mustn’t
+// store pointers into heap objects or allocate.
+//
+//     gc::traced_ptr<Graph> graph = build();
+//     std::thread worker{[&graph] {
+//         gc::Shared_scope scope;
+//         gc::traced_ptr<Graph> mine = graph;
+//         search(mine);
+//     }};
+#pragma once
+
+#include <cstdint>
+
+#if defined(PRECISEPP_BIASED_COUNTS) && defined(PRECISEPP_ROOT_REGISTRY)
+#error "PRECISEPP_BIASED_COUNTS can't be combined with PRECISEPP_ROOT_REGISTRY"
+#endif
+
+namespace gc
+{
+
+namespace detail
+{
+
+// Returns a number not yet given to any thread.
+uint32_t new_thread_id();
+
+// A small number identifying the calling thread, which is never reused.
+inline uint32_t this_thread_id()
+{
+    static thread_local uint32_t id = 0;
+    if (id == 0) id = new_thread_id();
+    return id;
+}
+
+} // end namespace detail
+
+#ifdef PRECISEPP_BIASED_COUNTS
+
+class Shared_scope
+{
+public:
+    Shared_scope();
+    ~Shared_scope();
+
+    Shared_scope(const Shared_scope&) = delete;
+    Shared_scope& operator=(const Shared_scope&) = delete;
+};
+
+namespace detail
+{
+
+// Held by the collector while it reads and merges counts: keeps scopes
+// from opening, if none is open already.
+class Shared_scope_exclusion
+{
+public:
+    Shared_scope_exclusion();
+    ~Shared_scope_exclusion();
+
+    Shared_scope_exclusion(const Shared_scope_exclusion&) = delete;
+    Shared_scope_exclusion& operator=(const Shared_scope_exclusion&) = delete;
+
+    // Whether no scope was open, so the collection can go ahead.
+    explicit operator bool() const
+    {
+        return excluded_;
+    }
+
+private:
+    bool excluded_;
+};
+
+// Whether any scope has opened since the last call, which must be made
+// under a `Shared_scope_exclusion`. Objects can lose references in a scope
+// without their spaces’ counts being noted as dropped.
+bool shared_scopes_opened();
+
+} // end namespace detail
+
+#endif // PRECISEPP_BIASED_COUNTS
+
+} // end namespace gc
@@ -6,23 +6,119 @@
 
 #pragma once
 
+#include "Heap_dump.h"
+#include "logger.h"
+#include "Marker.h"
+#include "Region.h"
+
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <typeinfo>
+#include <vector>
 
 namespace gc
 {
 
+// After a collection, a space grows if more than this fraction of it is
+// still in use.
+static constexpr double max_live_ratio = 0.75;
+
 class Collector;
 
 namespace detail
 {
 
+// The collector traces objects with these function objects, rather than
+// with lambdas, so that a `Traceable` can overload `trace` for them to take
+// a faster path (as `GC_TRACE_FIELDS` does).
+
+// Decrements the root count of each pointee (GC phase 2), except immortal
+// ones: they’re always marked, and have no root counts.
+struct Root_tracer
+{
+    template <typename P>
+    void operator()(P ptr) const;
+};
+
+// Pushes each pointee onto the marker’s stack (GC phase 3).
+struct Mark_tracer
+{
+    template <typename P>
+    void operator()(P ptr) const;
+
+    // The same, split in two for callers that know `P` only when they’re
+    // set up, such as the offset tables of trace_fields.h: `scan_for<P>()`
+    // is what to push a non-null `P` with.
+    template <typename P>
+    static Marker::scan_t scan_for();
+
+    static void push(void* ptr, Marker::scan_t scan);
+};
+
+// Decrements the root count of each unmarked pointee (heap verification).
+struct Unmarked_tracer
+{
+    template <typename P>
+    void operator()(P ptr) const;
+};
+
+// Decrements the root count of each pointee in a region page, as a region
+// closes.
+struct Region_root_tracer
+{
+    template <typename P>
+    void operator()(P ptr) const;
+};
+
+// Pushes each pointee in a region page onto the region marker’s stack.
+struct Region_mark_tracer
+{
+    template <typename P>
+    void operator()(P ptr) const;
+};
+
+// When the collector is verifying the heap, it runs these steps after
+// phase 3, each for every space in turn, like the phases.
+enum class Verify_step
+{
+    // Checks that no `root_count_` underflowed in phase 2, which would
+    // mean some `Traceable` reports a pointer it doesn’t hold a count on.
+    check_root_counts,
+
+    // Copies `ref_count_` to `root_count_` for every unmarked object.
+    save_counts,
+
+    // Decrements `root_count_` for every edge between unmarked objects.
+    count_dead_refs,
+
+    // Checks that every unmarked object’s `root_count_` is now zero: that
+    // is, that only other unmarked objects refer to it. Anything else
+    // means a live object or root refers to an object that marking
+    // missed, which would be freed while still in use.
+    check_unmarked,
+};
+
+// Pieces of phase 5 that spaces hand to the collector to run on its sweep
+// threads (see `Space::plan_sweep`).
+using Sweep_tasks = std::vector<std::function<void()>>;
+
 class Space
 {
     // The client of this interface is the `Collector`.
     friend class ::gc::Collector;
 
+    friend struct Root_tracer;
+    friend struct Mark_tracer;
+    friend struct Unmarked_tracer;
+    friend struct Region_root_tracer;
+    friend struct Region_mark_tracer;
+    friend class Root_registry;
+    friend class Cycle_collector;
+
 
-    // Our garbage collection proceeds in four phases, which must be
+    // Our garbage collection proceeds in seven phases, which must be
     // run for each space in turn; that is, every space must run phase 1,
     // then every space must run phase 2, etc. Here are the phases:
 
@@ -38,9 +134,87 @@ class Space
     // previous phase.
     virtual void mark()           =0;
 
-    // Phase 4: Sweeps away the dead heap, deallocating and resetting marks.
+    // After phase 3 (and any verification) or a dump: Frees whatever phase
+    // 1 allocated to hold root counts, which only compact headers need (see
+    // Compact_counts.h).
+    virtual void discard_root_counts() =0;
+
+    // Phase 4: Clears weak pointers to unmarked objects. This happens
+    // before any space sweeps, so no destructor can revive a dead object
+    // through a weak pointer.
+    virtual void clear_weak()     =0;
+
+    // Phase 5: Sweeps away the dead heap, resetting marks. Depending on the
+    // `Collector`’s `finalization_t`, dead objects are either destroyed and
+    // deallocated right away or queued for phase 6.
     virtual void sweep()          =0;
 
+    // Phase 5, in parallel: When the collector has more than one sweep
+    // thread, each space may first add tasks that sweep parts of it, which
+    // the collector runs concurrently, across all spaces, before any space
+    // runs `sweep`. Tasks must touch nothing outside their own part of the
+    // space; `sweep` then finishes the job serially.
+    virtual void plan_sweep(Sweep_tasks&) =0;
+
+    // Phase 6: Destroys the objects queued by sweeping and deallocates
+    // them. When finalization is deferred, this phase and the next run later,
+    // from `Collector::run_finalizers`.
+    virtual void finalize()       =0;
+
+    // Phase 7: Returns memory freed by the sweep to the operating system.
+    // This must wait until every dead object has been destroyed, because
+    // destructors can still touch the counts of other dead objects.
+    virtual void release()        =0;
+
+
+    // Writes every object in this space to a heap dump, with the root
+    // counts found by phases 1 and 2.
+    virtual void dump(Heap_dump&) =0;
+
+
+    // Heap verification, when the collector is verifying: runs one step of
+    // the cross-check between counts and marks (see `Verify_step`).
+    virtual void verify(Verify_step) =0;
+
+    // Poisons every free slot, when the collector starts verifying. From
+    // then on slots are poisoned as they’re freed, and checked as they’re
+    // allocated, to catch writes through dangling pointers.
+    virtual void poison_free() =0;
+
+
+    // Partial collections (see `Collector::set_partial`).
+
+    // The traced type of this space’s objects, `Traced<T>` or
+    // `Traced_array<T>`, which is its node in the type graph.
+    virtual const std::type_info& traced_type() const =0;
+
+    // Whether any object in this space has lost a reference since the
+    // space was last collected, and so could be garbage.
+    virtual bool count_dropped() const =0;
+
+    // Called as a collection that processes this space begins.
+    virtual void clear_count_dropped() =0;
+
+
+    // The number of bytes of pages and large-object blocks this `Space`
+    // holds, for the heap limits (see `Collector::set_heap_limit`).
+    virtual size_t heap_bytes() const =0;
+
+
+    // Cycle collection (see Cycle_collector.h), for garbage found among
+    // this space’s objects.
+
+    // Clears weak pointers to the given objects, which are sorted by
+    // address, before any of them is destroyed.
+    virtual void cycle_clear_weak(const std::vector<const void*>&) =0;
+
+    // Destroys an object, leaving its slot used.
+    virtual void cycle_destroy(void* ptr) =0;
+
+    // Frees the slot of an object that `cycle_destroy` destroyed, once every
+    // dead object has been.
+    virtual void cycle_free(void* ptr) =0;
+
 
     // Stats, currently unused.
 
@@ -56,7 +230,153 @@ class Space
 
 protected:
     virtual ~Space() = default;
+
+    // Marks everything reachable from a root. Marking is shared by all
+    // spaces since edges may cross from one kind of space to another. `P`
+    // is `Traced<S>*` or `Traced_array<S>*`, and its `trace_object_` member
+    // is used to find edges.
+    template <typename P>
+    static void mark_from_(P ptr)
+    {
+        log(debug4) << "mark_from_(" << ptr << ")";
+        if (ptr != nullptr) {
+            marker_().push(ptr, &scan_<P>);
+            marker_().drain();
+        }
+        log(debug4) << "end mark_from_(" << ptr << ")";
+    }
+
+    // The marker’s work list of grey objects.
+    static Marker& marker_()
+    {
+        static Marker instance;
+        return instance;
+    }
+
+    // Marks an object, and if it wasn’t already marked, pushes its
+    // children onto the marker’s stack.
+    template <typename P>
+    static void scan_(void* ptr)
+    {
+        P object = static_cast<P>(ptr);
+        if (!object->test_and_set_mark_())
+            object->trace_object_(Mark_tracer{});
+    }
+
+    // Marks everything in region pages reachable from a region object
+    // without leaving them, as a region closes. (The rest of the heap’s
+    // marks must stay clear between collections.)
+    template <typename P>
+    static void mark_region_from_(P ptr)
+    {
+        region_marker_().push(ptr, &scan_region_<P>);
+        region_marker_().drain();
+    }
+
+    static Marker& region_marker_()
+    {
+        static Marker instance;
+        return instance;
+    }
+
+    template <typename P>
+    static void scan_region_(void* ptr)
+    {
+        P object = static_cast<P>(ptr);
+        if (!object->test_and_set_mark_())
+            object->trace_object_(Region_mark_tracer{});
+    }
+
+    template <typename P>
+    static void decrement_root_count_(P ptr)
+    {
+        if (ptr != nullptr)
+            --ptr->root_count_();
+    }
+
+    template <typename P>
+    static void decrement_unmarked_root_count_(P ptr)
+    {
+        if (ptr != nullptr && !ptr->marked_())
+            --ptr->root_count_();
+    }
+
+    // Poisons the free-list link of a free slot, by storing its complement
+    // in the word after it. (The link itself must stay usable.)
+    template <typename P>
+    static void poison_link_(P* link)
+    {
+        reinterpret_cast<uintptr_t*>(link)[1] = ~uintptr_t(*link);
+    }
+
+    // Whether a free slot’s link still matches its complement.
+    template <typename P>
+    static bool is_link_poisoned_(P* link)
+    {
+        return reinterpret_cast<uintptr_t*>(link)[1] == ~uintptr_t(*link);
+    }
+
+    // Fills freed memory with `poison_byte_`.
+    static void poison_(void* ptr, size_t size)
+    {
+        std::memset(ptr, poison_byte_, size);
+    }
+
+    // Whether freed memory is still filled with `poison_byte_`.
+    static bool is_poisoned_(const void* ptr, size_t size)
+    {
+        auto bytes = static_cast<const unsigned char*>(ptr);
+        for (size_t i = 0; i < size; ++i)
+            if (bytes[i] != poison_byte_) return false;
+        return true;
+    }
+
+    static constexpr unsigned char poison_byte_ = 0xDB;
 };
 
+template <typename P>
+void Root_tracer::operator()(P ptr) const
+{
+    Space::decrement_unmarked_root_count_(ptr);
+}
+
+template <typename P>
+void Mark_tracer::operator()(P ptr) const
+{
+    if (ptr != nullptr)
+        Space::marker_().push(ptr, &Space::scan_<P>);
+}
+
+template <typename P>
+Marker::scan_t Mark_tracer::scan_for()
+{
+    return &Space::scan_<P>;
+}
+
+inline void Mark_tracer::push(void* ptr, Marker::scan_t scan)
+{
+    Space::marker_().push(ptr, scan);
+}
+
+template <typename P>
+void Unmarked_tracer::operator()(P ptr) const
+{
+    Space::decrement_unmarked_root_count_(ptr);
+}
+
+template <typename P>
+void Region_root_tracer::operator()(P ptr) const
+{
+    if (regions.contains(ptr))
+        Space::decrement_root_count_(ptr);
+}
+
+template <typename P>
+void Region_mark_tracer::operator()(P ptr) const
+{
+    if (regions.contains(ptr))
+        Space::region_marker_().push(ptr, &Space::scan_region_<P>);
+}
+
 } // end namespace internal
 } // end namespace gc
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "Sweep_pool.h"
+
+namespace gc
+{
+
+namespace detail
+{
+
+Sweep_pool::Sweep_pool(size_t threads)
+        : tasks_{nullptr}
+        , next_{0}
+        , pending_{0}
+        , batch_{0}
+        , stopping_{false}
+{
+    for (size_t i = 1; i < threads; ++i)
+        workers_.emplace_back([this] { work_(); });
+}
+
+Sweep_pool::~Sweep_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stopping_ = true;
+    }
+    start_.notify_all();
+
+    for (std::thread& worker : workers_)
+        worker.join();
+}
+
+void Sweep_pool::run(const Sweep_tasks& tasks)
+{
+    // Waking the workers isn’t worth it for one task.
+    if (workers_.empty() || tasks.size() < 2) {
+        for (const auto& task : tasks) task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        tasks_   = &tasks;
+        next_    = 0;
+        pending_ = workers_.size();
+        ++batch_;
+    }
+    start_.notify_all();
+
+    run_tasks_();
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    done_.wait(lock, [this] { return pending_ == 0; });
+    tasks_ = nullptr;
+}
+
+void Sweep_pool::work_()
+{
+    size_t batch = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock{mutex_};
+            start_.wait(lock, [this, batch] {
+                return stopping_ || batch_ != batch;
+            });
+            if (stopping_) return;
+            batch = batch_;
+        }
+
+        run_tasks_();
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (--pending_ == 0) done_.notify_one();
+    }
+}
+
+void Sweep_pool::run_tasks_()
+{
+    const Sweep_tasks& tasks = *tasks_;
+    for (size_t i = next_++; i < tasks.size(); i = next_++)
+        tasks[i]();
+}
+
+} // end namespace detail
+
+} // end namespace gc
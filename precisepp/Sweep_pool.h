@@ -0,0 +1,62 @@
+// The `Sweep_pool` is the collector’s team of sweep threads. A collection
+// hands it the tasks that spaces planned for phase 5 (see
+// `Space::plan_sweep`), and it runs them on its worker threads and on the
+// collecting thread, returning once all are done. Between collections the
+// workers sleep.
+#pragma once
+
+#include "Space.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gc
+{
+
+namespace detail
+{
+
+class Sweep_pool
+{
+public:
+    // Starts `threads - 1` workers, since the collecting thread works too.
+    explicit Sweep_pool(size_t threads);
+
+    ~Sweep_pool();
+
+    Sweep_pool(const Sweep_pool&) = delete;
+    Sweep_pool& operator=(const Sweep_pool&) = delete;
+
+    // The number of threads that run tasks, the caller’s included.
+    size_t threads() const
+    {
+        return workers_.size() + 1;
+    }
+
+    // Runs every task, in no particular order, and waits for them.
+    void run(const Sweep_tasks& tasks);
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex               mutex_;
+    std::condition_variable  start_;    // Signals a new batch, or stopping
+    std::condition_variable  done_;     // Signals the last worker finishing
+    const Sweep_tasks*       tasks_;    // The current batch
+    std::atomic<size_t>      next_;     // The next task to claim in it
+    size_t                   pending_;  // Workers still on the batch
+    size_t                   batch_;    // Counts batches, to wake workers
+    bool                     stopping_;
+
+    void work_();
+
+    // Claims and runs tasks until none are left.
+    void run_tasks_();
+};
+
+} // end namespace detail
+
+} // end namespace gc
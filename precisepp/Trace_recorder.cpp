@@ -0,0 +1,185 @@
+#include "Trace_recorder.h"
+
+#ifdef PRECISEPP_TRACE_RECORDER
+
+#include <cstring>
+#include <stdexcept>
+
+namespace gc
+{
+
+namespace detail
+{
+
+bool recording = false;
+
+} // end namespace detail
+
+using detail::Trace_event;
+
+namespace
+{
+
+// Events are buffered, and written out when the buffer reaches this size.
+constexpr size_t flush_size = 64 * 1024;
+
+} // end anonymous namespace
+
+Trace_recorder& Trace_recorder::instance()
+{
+    static Trace_recorder recorder;
+    return recorder;
+}
+
+Trace_recorder::Trace_recorder()
+        : file_{nullptr}
+        , last_address_{0}
+{ }
+
+Trace_recorder::~Trace_recorder()
+{
+    stop();
+}
+
+void Trace_recorder::start(const std::string& path)
+{
+    stop();
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr)
+        throw std::runtime_error{"precisepp: can’t open trace " + path};
+
+    buffer_.clear();
+    buffer_.reserve(flush_size + 64);
+    buffer_.insert(buffer_.end(), detail::trace_magic,
+                   detail::trace_magic + sizeof detail::trace_magic - 1);
+    last_address_ = 0;
+    types_.clear();
+    detail::recording = true;
+}
+
+void Trace_recorder::stop()
+{
+    if (file_ == nullptr) return;
+
+    detail::recording = false;
+    flush_();
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+bool Trace_recorder::running() const
+{
+    return file_ != nullptr;
+}
+
+void Trace_recorder::allocate_(const std::type_info& type, const void* ptr,
+                               const void* elements, size_t bytes,
+                               bool immortal)
+{
+    size_t index = type_index_(type);
+    event_(Trace_event::allocate);
+    number_(index);
+    address_(ptr);
+    number_(uint64_t(static_cast<const char*>(elements) -
+                     static_cast<const char*>(ptr)));
+    number_(bytes);
+    number_(immortal);
+}
+
+void Trace_recorder::deallocate_(const void* ptr)
+{
+    event_(Trace_event::deallocate);
+    address_(ptr);
+}
+
+void Trace_recorder::store_(const void* slot, const void* target)
+{
+    event_(Trace_event::store);
+    address_(slot);
+    address_(target);
+}
+
+void Trace_recorder::clear_(const void* slot)
+{
+    event_(Trace_event::clear);
+    address_(slot);
+}
+
+void Trace_recorder::move_(const void* from, const void* to)
+{
+    event_(Trace_event::move);
+    address_(from);
+    address_(to);
+}
+
+void Trace_recorder::swap_(const void* slot1, const void* slot2)
+{
+    event_(Trace_event::swap);
+    address_(slot1);
+    address_(slot2);
+}
+
+void Trace_recorder::collect_()
+{
+    event_(Trace_event::collect);
+}
+
+void Trace_recorder::collected_(uint64_t pause_ns)
+{
+    event_(Trace_event::collection);
+    number_(pause_ns);
+}
+
+// Types are numbered in the order they’re first allocated, and each is
+// described by a type event before its first allocation.
+size_t Trace_recorder::type_index_(const std::type_info& type)
+{
+    auto found = types_.find(&type);
+    if (found != types_.end()) return found->second;
+
+    size_t index = types_.size();
+    types_.emplace(&type, index);
+    const char* name = type.name();
+    size_t length = std::strlen(name);
+    event_(Trace_event::type);
+    number_(index);
+    number_(length);
+    buffer_.insert(buffer_.end(), name, name + length);
+    return index;
+}
+
+// Flushes first if the buffer is full, so that no event is split between
+// writes.
+void Trace_recorder::event_(Trace_event kind)
+{
+    if (buffer_.size() >= flush_size) flush_();
+    buffer_.push_back(uint8_t(kind));
+}
+
+void Trace_recorder::number_(uint64_t n)
+{
+    while (n >= 0x80) {
+        buffer_.push_back(uint8_t(n | 0x80));
+        n >>= 7;
+    }
+    buffer_.push_back(uint8_t(n));
+}
+
+void Trace_recorder::address_(const void* ptr)
+{
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    auto delta   = int64_t(address - last_address_);
+    last_address_ = address;
+    number_((uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+}
+
+void Trace_recorder::flush_()
+{
+    std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    buffer_.clear();
+}
+
+} // end namespace gc
+
+#endif // PRECISEPP_TRACE_RECORDER
@@ -0,0 +1,236 @@
+// In recording mode (when `PRECISEPP_TRACE_RECORDER` is defined for the
+// whole program), the `Trace_recorder` can write a trace of what the
+// program does to the heap: each allocation and deallocation, and each
+// store into, clear of, or move between traced pointers. The replay tool
+// (tools/replay.cpp) reads a trace and drives the collector through the
+// same allocations and pointer changes, so that policies can be compared on
+// a real workload without rerunning it:
+//
+//     gc::Trace_recorder::instance().start("app.trace");
+//     run();
+//     gc::Trace_recorder::instance().stop();
+//
+// A trace is a sequence of events, each a kind byte followed by unsigned
+// LEB128 numbers. Addresses are written as the zigzag-encoded difference
+// from the previous address written, which is usually near, so most take
+// a byte or two:
+//
+//     magic "ppptrc01"
+//     type:        index, name length, name bytes
+//     allocate:    type, address, header bytes, object bytes, immortal
+//     deallocate:  address
+//     store:       slot, target       (the slot now points to the target)
+//     clear:       slot               (the slot no longer points anywhere)
+//     move:        from, to           (`to` takes `from`’s target)
+//     swap:        slot, slot
+//     collect:                        (the program called `collect`)
+//     collection:  pause in nanoseconds
+//
+// Object addresses are those of the `Traced<T>` or `Traced_array<T>`, and
+// the object’s elements start `header bytes` past it. A slot is the address
+// of a traced pointer or array handle; it’s a root unless it lies in the
+// elements of a live object.
+//
+// Destructors run by the collector aren’t recorded, since the replay’s own
+// collector destroys its objects when it finds them dead. Only the thread
+// that owns the heap may be recording, so recording can’t be combined with
+// `PRECISEPP_BIASED_COUNTS`. Without the mode, the hooks below are empty.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#if defined(PRECISEPP_TRACE_RECORDER) && defined(PRECISEPP_BIASED_COUNTS)
+#error "PRECISEPP_TRACE_RECORDER can't be combined with PRECISEPP_BIASED_COUNTS"
+#endif
+
+namespace gc
+{
+
+namespace detail
+{
+
+// The event kinds of a trace.
+enum class Trace_event : unsigned char
+{
+    type = 1,
+    allocate,
+    deallocate,
+    store,
+    clear,
+    move,
+    swap,
+    collect,
+    collection,
+};
+
+static constexpr char trace_magic[] = "ppptrc01";
+
+} // end namespace detail
+
+#ifdef PRECISEPP_TRACE_RECORDER
+
+class Trace_recorder
+{
+public:
+    static Trace_recorder& instance();
+
+    // Starts writing a trace to the file at `path`, replacing it. Throws
+    // `std::runtime_error` if it can’t be opened.
+    void start(const std::string& path);
+
+    // Stops recording, and writes out and closes the trace.
+    void stop();
+
+    bool running() const;
+
+    // The hooks, which are called only while recording.
+    void allocate_(const std::type_info& type, const void* ptr,
+                   const void* elements, size_t bytes, bool immortal);
+    void deallocate_(const void* ptr);
+    void store_(const void* slot, const void* target);
+    void clear_(const void* slot);
+    void move_(const void* from, const void* to);
+    void swap_(const void* slot1, const void* slot2);
+    void collect_();
+    void collected_(uint64_t pause_ns);
+
+private:
+    std::FILE*           file_;
+    std::vector<uint8_t> buffer_;
+    uintptr_t            last_address_;
+    std::unordered_map<const std::type_info*, size_t> types_; // To index
+
+    Trace_recorder();
+    ~Trace_recorder();
+
+    size_t type_index_(const std::type_info& type);
+
+    void event_(detail::Trace_event kind);
+    void number_(uint64_t n);
+    void address_(const void* ptr);
+    void flush_();
+};
+
+#endif // PRECISEPP_TRACE_RECORDER
+
+namespace detail
+{
+
+#ifdef PRECISEPP_TRACE_RECORDER
+
+// Whether the hooks should call the recorder: it’s running, and the
+// collector isn’t destroying objects.
+extern bool recording;
+
+// Turns recording off for its lifetime, around destructors that the
+// collector runs.
+class Recording_pause
+{
+public:
+    Recording_pause() : saved_{recording}
+    {
+        recording = false;
+    }
+
+    ~Recording_pause()
+    {
+        recording = saved_;
+    }
+
+    Recording_pause(const Recording_pause&) = delete;
+    Recording_pause& operator=(const Recording_pause&) = delete;
+
+private:
+    bool saved_;
+};
+
+inline void record_allocate(const std::type_info& type, const void* ptr,
+                            const void* elements, size_t bytes,
+                            bool immortal)
+{
+    if (recording)
+        Trace_recorder::instance().allocate_(type, ptr, elements, bytes,
+                                             immortal);
+}
+
+inline void record_deallocate(const void* ptr)
+{
+    if (recording) Trace_recorder::instance().deallocate_(ptr);
+}
+
+inline void record_store(const void* slot, const void* target)
+{
+    if (recording) Trace_recorder::instance().store_(slot, target);
+}
+
+inline void record_clear(const void* slot)
+{
+    if (recording) Trace_recorder::instance().clear_(slot);
+}
+
+inline void record_move(const void* from, const void* to)
+{
+    if (recording) Trace_recorder::instance().move_(from, to);
+}
+
+inline void record_swap(const void* slot1, const void* slot2)
+{
+    if (recording) Trace_recorder::instance().swap_(slot1, slot2);
+}
+
+inline void record_collect()
+{
+    if (recording) Trace_recorder::instance().collect_();
+}
+
+inline void record_collection(uint64_t pause_ns)
+{
+    if (recording) Trace_recorder::instance().collected_(pause_ns);
+}
+
+#else // PRECISEPP_TRACE_RECORDER
+
+constexpr bool recording = false;
+
+struct Recording_pause
+{
+    Recording_pause()
+    { }
+};
+
+inline void record_allocate(const std::type_info&, const void*, const void*,
+                            size_t, bool)
+{ }
+
+inline void record_deallocate(const void*)
+{ }
+
+inline void record_store(const void*, const void*)
+{ }
+
+inline void record_clear(const void*)
+{ }
+
+inline void record_move(const void*, const void*)
+{ }
+
+inline void record_swap(const void*, const void*)
+{ }
+
+inline void record_collect()
+{ }
+
+inline void record_collection(uint64_t)
+{ }
+
+#endif // PRECISEPP_TRACE_RECORDER
+
+} // end namespace detail
+
+} // end namespace gc
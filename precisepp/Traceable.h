@@ -16,29 +16,39 @@ class Traceable;
 namespace detail
 {
 
+// The tracer type is deduced, rather than given explicitly, so that a
+// `Traceable` may overload `trace` for particular tracers.
 template<typename T, typename F>
 void trace(T&& object, F tracer)
 {
     ::gc::Traceable<std::remove_cv_t<std::remove_reference_t<T>>>
-        ::template trace<F>(std::forward<T>(object), tracer);
+        ::trace(std::forward<T>(object), tracer);
 };
 
 } // end namespace detail
 
-#define CONTAINS_POINTERS_IF(...) \
-    static constexpr bool contains_pointers_v = __VA_ARGS__
-
 namespace detail
 {
 
 template <typename... Es>
 struct contains_pointers;
 
+} // end namespace detail
+
+#define CONTAINS_POINTERS_IF(...) \
+    template <typename... Es__>\
+    friend struct ::gc::detail::contains_pointers;\
+    static constexpr bool contains_pointers_v = __VA_ARGS__
+
+namespace detail
+{
+
 template <typename E, typename... Es>
 struct contains_pointers<E, Es...>
 {
-    static constexpr bool value = ::gc::Traceable<E>::contains_pointers_v
-                                  || contains_pointers<Es...>::value;
+    static constexpr bool value =
+            ::gc::Traceable<std::remove_cv_t<E>>::contains_pointers_v
+            || contains_pointers<Es...>::value;
 };
 
 template <>
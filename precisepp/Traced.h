@@ -3,8 +3,19 @@
 // are managed by `Typed_space<T>`s.
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include "forward.h"
+#include "bitmap.h"
+#include "Compact_counts.h"
+#include "Count_log.h"
+#include "Cycle_collector.h"
+#include "Large_object_space.h"
+#include "Shared_scope.h"
+#include "Traceable.h"
+#include "Type_graph.h"
 
 namespace gc
 {
@@ -15,24 +26,31 @@ class Traced
     // Each `Traced<T>` is in one of three states:
     //
     //   - The first slot in every page is a *header*, which contains the
-    //     number of slots in the page (itself included) and a link to the
-    //     next page.
+    //     number of slots in the page (itself included), a link to the
+    //     next page, and the page’s bitmaps. (With compact headers, the
+    //     number of slots is in `count_`.)
     //
-    //   - The *free* state, indicated by the `free_` bit being set, means
-    //     that there is no object here, and the `Traced<T>` is a member of the
-    //     free list.
+    //   - The *free* state means that there is no object here, and the
+    //     `Traced<T>` is a member of the free list.
     //
     //   - Otherwise it’s in the *used* state, meaning it contains a
     //     (potentially) live object.
     //
+    // Which state a slot is in, and whether it’s marked, are kept
+    // columnwise in the page header’s bitmaps rather than in the slots, so
+    // that sweeping can work on many slots at a time.
+    //
     // The three members of the union represent the data held in each of the
     // three states. See below for a member function for initializing each
     // state.
     union
     {
         struct {
-            size_t     page_size;
-            Traced<T>* next_page;
+#ifndef PRECISEPP_COMPACT_HEADERS
+            size_t          page_size;
+#endif
+            Traced<T>*      next_page;
+            detail::word_t* bits;      // Used bits, then mark bits
         } header;
 
         struct
@@ -43,41 +61,134 @@ class Traced
         struct
         {
             T      object;
+#ifndef PRECISEPP_COMPACT_HEADERS
             size_t ref_count;
             size_t root_count;
+#endif
+#ifdef PRECISEPP_BIASED_COUNTS
+            std::atomic<size_t> shared_count; // From other threads
+#endif
         } used;
     }      union_;
 
-    // The free bit, set when this `Traced<T>` is on the free list.
-    bool   free_;
+#ifdef PRECISEPP_COMPACT_HEADERS
+    // The reference count of a used slot, or the page size of a header (see
+    // Compact_counts.h).
+    uint32_t count_;
+#endif
 
-    // The mark bit, used during the marking and sweeping phases of collection.
-    bool   mark_;
+    // This slot’s index in its page, which locates the page header and the
+    // slot’s bits. (Unused for large objects, whose bits are kept by the
+    // `Large_object_space`.) It fits in what would otherwise be padding.
+    uint32_t index_;
+
+#ifdef PRECISEPP_BIASED_COUNTS
+    // The thread that counts in `ref_count` (see Shared_scope.h). It fits
+    // in the rest of the padding.
+    uint32_t owner_;
+#endif
+
+    // Whether `Traced<T>`s are big enough that each gets its own block in a
+    // `Large_object_space` rather than a slot in a page.
+    static constexpr bool is_large_()
+    {
+        return sizeof(Traced) > large_object_size;
+    }
 
     //
     // Accessor functions to avoid having to write `ptr->union_.header.stuff`
     // all over the place.
     //
 
+#ifdef PRECISEPP_COMPACT_HEADERS
+    uint32_t& page_size_()      { return count_; }
+
+    // The page’s bits start with a word holding its root counts, while
+    // there are any (see `root_count_`).
+    static constexpr size_t bits_offset_ = 1;
+#else
     size_t& page_size_()        { return union_.header.page_size; }
+
+    static constexpr size_t bits_offset_ = 0;
+#endif
     Traced<T>*& next_page_()    { return union_.header.next_page; }
+    detail::word_t* used_bits_(){ return union_.header.bits + bits_offset_; }
+    detail::word_t* mark_bits_()
+    {
+        return used_bits_() + detail::words_for(page_size_());
+    }
+
+    // The number of words of bits for a page of `page_size` slots.
+    static size_t bits_words_(size_t page_size)
+    {
+        return bits_offset_ + 2 * detail::words_for(page_size);
+    }
+
+    Traced<T>* page_()          { return this - index_; }
 
     Traced<T>*& next_free_()    { return union_.free.next_free; }
 
+    // The bytes of a free slot after its free-list link and the word that
+    // checks it, which are poisoned while the collector is verifying.
+    void* free_bytes_()
+    {
+        return reinterpret_cast<char*>(&union_) + 2 * sizeof(Traced*);
+    }
+
+    static constexpr size_t free_bytes_size_()
+    {
+        return sizeof(decltype(union_)) - 2 * sizeof(Traced*);
+    }
+
     T& object_()                { return union_.used.object; }
+
+#ifdef PRECISEPP_COMPACT_HEADERS
+    size_t ref_count_()         { return detail::count_value(count_, this); }
+    void set_ref_count_(size_t count) { detail::set_count(count_, this, count); }
+
+    // The root count of a small object is in its page’s scratch array,
+    // which the space allocates in phase 1 and frees once marking is done.
+    size_t& root_count_()
+    {
+        if (is_large_())
+            return detail::Large_object_space<Traced>::root_count(this);
+
+        size_t* root_counts = page_()->page_root_counts_();
+        return root_counts ? root_counts[index_]
+                           : detail::ignored_root_count();
+    }
+
+    size_t* page_root_counts_()
+    {
+        size_t* result;
+        std::memcpy(&result, union_.header.bits, sizeof result);
+        return result;
+    }
+
+    void set_page_root_counts_(size_t* root_counts)
+    {
+        std::memcpy(union_.header.bits, &root_counts, sizeof root_counts);
+    }
+#else
     size_t& ref_count_()        { return union_.used.ref_count; }
+    void set_ref_count_(size_t count) { ref_count_() = count; }
     size_t& root_count_()       { return union_.used.root_count; }
+#endif
 
     //
     // Initialization functions
     //
 
     // Initializes a `Traced<T>` as a page header, give its size (header
-    // included) and a pointer to the next page in the page list.
-    void initialize_header_(size_t page_size, Traced<T>* next_page)
+    // included), a pointer to the next page in the page list, and its
+    // bitmaps, which must be zeroed.
+    void initialize_header_(size_t page_size, Traced<T>* next_page,
+                            detail::word_t* bits)
     {
-        page_size_() = page_size;
-        next_page_() = next_page;
+        page_size_()       = page_size;
+        next_page_()       = next_page;
+        union_.header.bits = bits;
+        index_             = 0;
     }
 
     // Initializes a `Traced<T>` to the free state, adding it to the given free
@@ -85,23 +196,342 @@ class Traced
     void initialize_free_(Traced<T>* next_free = nullptr)
     {
         next_free_() = next_free;
-        free_ = true;
+        if (!is_large_())
+            detail::clear_bit(page_()->used_bits_(), index_);
     }
 
     // Initializes a `Traced<T>` to the used state (except for initializing
     // the `T` object itself).
     void initialize_used_()
     {
-        ref_count_() = 0;
-        mark_ = false;
-        free_ = false;
+        set_ref_count_(0);
+#ifdef PRECISEPP_BIASED_COUNTS
+        union_.used.shared_count.store(0, std::memory_order_relaxed);
+        owner_ = detail::this_thread_id();
+#endif
     }
 
-    template <typename S, typename Allocator>
+    // Counts a reference. In biased-count mode, threads other than the
+    // owner count in the shared count instead, and in deferred-count mode
+    // the change goes in the thread’s log (see Count_log.h).
+    void add_ref_()
+    {
+#ifdef PRECISEPP_BIASED_COUNTS
+        if (owner_ != detail::this_thread_id()) {
+            union_.used.shared_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+#endif
+#if defined(PRECISEPP_DEFERRED_COUNTS)
+        detail::log_increment(ref_count_());
+#elif defined(PRECISEPP_COMPACT_HEADERS)
+        detail::increment_count(count_, this);
+#else
+        ++ref_count_();
+#endif
+    }
+
+    // Uncounts a reference, noting the drop for partial collections and
+    // cycle collection. (Drops on other threads are noted for partial
+    // collections by their `Shared_scope`s instead.)
+    void drop_ref_()
+    {
+#ifdef PRECISEPP_BIASED_COUNTS
+        if (owner_ != detail::this_thread_id()) {
+            union_.used.shared_count.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+#endif
+#if defined(PRECISEPP_DEFERRED_COUNTS)
+        detail::log_decrement(ref_count_());
+#elif defined(PRECISEPP_COMPACT_HEADERS)
+        detail::decrement_count(count_, this);
+#else
+        --ref_count_();
+#endif
+        detail::Count_dropped<Traced>::value = true;
+        detail::possible_cycle_root(this);
+    }
+
+    // Folds the shared count into `ref_count`, as phase 1 begins. (Counts
+    // are unsigned, so either may have wrapped around; their sum hasn’t.)
+    void merge_counts_()
+    {
+#ifdef PRECISEPP_BIASED_COUNTS
+        ref_count_() += union_.used.shared_count.exchange(
+                0, std::memory_order_relaxed);
+#endif
+    }
+
+    // Marks a small object’s slot as used, once its object is constructed.
+    // Until then the slot is invisible to the collector.
+    void set_used_()
+    {
+        detail::set_bit(page_()->used_bits_(), index_);
+    }
+
+    bool marked_()
+    {
+        if (is_large_())
+            return detail::Large_object_space<Traced>::is_marked(this);
+
+        return detail::test_bit(page_()->mark_bits_(), index_);
+    }
+
+    // Sets the mark bit, returning whether it was already set.
+    bool test_and_set_mark_()
+    {
+        if (is_large_())
+            return detail::Large_object_space<Traced>::test_and_set_mark(this);
+
+        return detail::test_and_set_bit(page_()->mark_bits_(), index_);
+    }
+
+    // Calls `f` on each `Traced` pointer held directly by the object.
+    template <typename F>
+    void trace_object_(F f)
+    {
+        ::gc::detail::trace(object_(), f);
+    }
+
+    template <typename S, typename Allocator, typename Barrier>
     friend class traced_ptr;
 
+    template <typename S, typename Allocator>
+    friend class weak_traced_ptr;
+
+    template <typename S, typename Allocator>
+    friend class Typed_space;
+
+    template <typename S, typename Allocator>
+    friend class Array_space;
+
+    template <typename P>
+    friend struct detail::Image_type;
+
+    template <typename P>
+    friend struct detail::Cycle_type_of;
+
+    friend class detail::Space;
+};
+
+// The metadata for a variable-length array of `T` is stored in a
+// `Traced_array<T>`, and the elements themselves follow it contiguously in
+// the same block. Blocks are allocated in units of
+// `sizeof(Traced_array<T>)` by `Array_space<T>`s. A block may have room for
+// more elements than it holds; only the first `size_()` are constructed.
+template<typename T>
+class alignas(size_t) alignas(T) Traced_array
+{
+    // Like `Traced<T>`, each `Traced_array<T>` is a page header, a free
+    // block, or a used block. (Large arrays are allocated in a
+    // `Large_object_space` and are never headers or free.)
+    union
+    {
+        struct {
+            size_t           page_size;
+            Traced_array<T>* next_page;
+        } header;
+
+        struct
+        {
+            Traced_array<T>* next_free;
+        } free;
+
+        struct
+        {
+            size_t size;
+#ifndef PRECISEPP_COMPACT_HEADERS
+            size_t ref_count;
+#endif
+            size_t root_count;
+#ifdef PRECISEPP_BIASED_COUNTS
+            std::atomic<size_t> shared_count; // From other threads
+#endif
+        } used;
+    }      union_;
+
+#ifdef PRECISEPP_COMPACT_HEADERS
+    // The reference count of a used block (see Compact_counts.h). It shares
+    // a word with the fields below.
+    uint32_t count_;
+#endif
+
+    // The free bit, set when this block is on a free list.
+    bool   free_;
+
+    // The mark bit, used during the marking and sweeping phases of collection.
+    // (Unused for large arrays, whose mark bits are out-of-line.)
+    bool   mark_;
+
+    // The size class of the block, which holds 2^size_class_ units, or
+    // `large_class` if it was allocated in a `Large_object_space`.
+    unsigned char size_class_;
+
+#ifdef PRECISEPP_BIASED_COUNTS
+    // The thread that counts in `ref_count` (see Shared_scope.h).
+    uint32_t owner_;
+#endif
+
+    static constexpr unsigned char large_class = 0xFF;
+
+    bool large_() const
+    {
+        return size_class_ == large_class;
+    }
+
+    // The number of elements the block has room for.
+    size_t capacity_()
+    {
+        size_t bytes = large_()
+                ? detail::Large_object_space<Traced_array>::size(this)
+                : sizeof(Traced_array) << size_class_;
+        return (bytes - sizeof(Traced_array)) / sizeof(T);
+    }
+
+    size_t& page_size_()             { return union_.header.page_size; }
+    Traced_array<T>*& next_page_()   { return union_.header.next_page; }
+
+    Traced_array<T>*& next_free_()   { return union_.free.next_free; }
+
+    size_t& size_()                  { return union_.used.size; }
+#ifdef PRECISEPP_COMPACT_HEADERS
+    size_t ref_count_()        { return detail::count_value(count_, this); }
+    void set_ref_count_(size_t count) { detail::set_count(count_, this, count); }
+#else
+    size_t& ref_count_()             { return union_.used.ref_count; }
+    void set_ref_count_(size_t count) { ref_count_() = count; }
+#endif
+    size_t& root_count_()            { return union_.used.root_count; }
+
+    // The elements start immediately after the metadata; the alignment of
+    // `Traced_array<T>` ensures that they are suitably aligned.
+    T* elements_()
+    {
+        return reinterpret_cast<T*>(this + 1);
+    }
+
+    void initialize_header_(size_t page_size, Traced_array<T>* next_page)
+    {
+        page_size_() = page_size;
+        next_page_() = next_page;
+    }
+
+    void initialize_free_(Traced_array<T>* next_free = nullptr)
+    {
+        next_free_() = next_free;
+        free_ = true;
+    }
+
+    // Initializes a block to the used state with no elements yet. The
+    // block starts with one reference, which belongs to the space until the
+    // elements are constructed and it is handed off to a `traced_array`.
+    void initialize_used_(unsigned char size_class)
+    {
+        size_()      = 0;
+        set_ref_count_(1);
+        mark_       = false;
+        free_       = false;
+        size_class_ = size_class;
+#ifdef PRECISEPP_BIASED_COUNTS
+        union_.used.shared_count.store(0, std::memory_order_relaxed);
+        owner_ = detail::this_thread_id();
+#endif
+    }
+
+    // As for `Traced<T>`.
+    void add_ref_()
+    {
+#ifdef PRECISEPP_BIASED_COUNTS
+        if (owner_ != detail::this_thread_id()) {
+            union_.used.shared_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+#endif
+#if defined(PRECISEPP_DEFERRED_COUNTS)
+        detail::log_increment(ref_count_());
+#elif defined(PRECISEPP_COMPACT_HEADERS)
+        detail::increment_count(count_, this);
+#else
+        ++ref_count_();
+#endif
+    }
+
+    void drop_ref_()
+    {
+#ifdef PRECISEPP_BIASED_COUNTS
+        if (owner_ != detail::this_thread_id()) {
+            union_.used.shared_count.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+#endif
+#if defined(PRECISEPP_DEFERRED_COUNTS)
+        detail::log_decrement(ref_count_());
+#elif defined(PRECISEPP_COMPACT_HEADERS)
+        detail::decrement_count(count_, this);
+#else
+        --ref_count_();
+#endif
+        detail::Count_dropped<Traced_array>::value = true;
+        detail::possible_cycle_root(this);
+    }
+
+    void merge_counts_()
+    {
+#ifdef PRECISEPP_BIASED_COUNTS
+        ref_count_() += union_.used.shared_count.exchange(
+                0, std::memory_order_relaxed);
+#endif
+    }
+
+    bool marked_()
+    {
+        if (large_())
+            return detail::Large_object_space<Traced_array>::is_marked(this);
+
+        return mark_;
+    }
+
+    // Sets the mark bit, returning whether it was already set.
+    bool test_and_set_mark_()
+    {
+        if (large_())
+            return detail::Large_object_space<Traced_array>
+                    ::test_and_set_mark(this);
+
+        bool result = mark_;
+        mark_ = true;
+        return result;
+    }
+
+    // Calls `f` on each `Traced` pointer held directly by the elements. If
+    // `T` cannot contain pointers then there is nothing to scan.
+    template <typename F>
+    void trace_object_(F f)
+    {
+        if (contains_pointers<T>) {
+            T* elements = elements_();
+            for (size_t i = 0; i < size_(); ++i)
+                ::gc::detail::trace(elements[i], f);
+        }
+    }
+
+    template <typename S, typename Allocator>
+    friend class traced_array;
+
     template <typename S, typename Allocator>
     friend class Typed_space;
+
+    template <typename S, typename Allocator>
+    friend class Array_space;
+
+    template <typename P>
+    friend struct detail::Image_type;
+
+    template <typename P>
+    friend struct detail::Cycle_type_of;
+
+    friend class detail::Space;
 };
 
 } // end namespace gc
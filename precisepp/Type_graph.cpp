@@ -0,0 +1,34 @@
+#include "Type_graph.h"
+
+namespace gc
+{
+
+namespace detail
+{
+
+namespace
+{
+
+// Constructed on first use, since edges are added by static initializers.
+std::vector<Type_graph::edge_t>& edge_list()
+{
+    static std::vector<Type_graph::edge_t> edges;
+    return edges;
+}
+
+} // end anonymous namespace
+
+bool Type_graph::add_edge(const std::type_info& from, const std::type_info& to)
+{
+    edge_list().emplace_back(&from, &to);
+    return true;
+}
+
+const std::vector<Type_graph::edge_t>& Type_graph::edges()
+{
+    return edge_list();
+}
+
+} // end namespace detail
+
+} // end namespace gc
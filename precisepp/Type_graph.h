@@ -0,0 +1,77 @@
+// The type graph lets a collection skip spaces that can’t hold garbage
+// (see `Collector::set_partial`). It has an edge from one traced type to
+// another when, according to its `Traceable`, an object of the first can
+// point to an object of the second. Traced types are `Traced<T>` and
+// `Traced_array<T>`, so every space of `T`s, whatever its allocator, is one
+// node.
+//
+// The edges are found at compile time: each space instantiates (but never
+// calls) a trace of its object type with an `Edge_type_tracer`, and each
+// pointer type that the trace could reach instantiates a `Type_edge`, whose
+// static initializer adds the edge.
+//
+// Alongside, `Count_dropped<P>` records whether any object of traced type
+// `P` has lost a reference since its spaces were last collected. Only
+// then can it have become garbage, or let objects it points to become
+// garbage.
+#pragma once
+
+#include <typeinfo>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gc
+{
+
+namespace detail
+{
+
+class Type_graph
+{
+public:
+    using edge_t = std::pair<const std::type_info*, const std::type_info*>;
+
+    // Records that objects of traced type `from` can point to objects of
+    // traced type `to`. Returns true, for use in static initializers.
+    static bool add_edge(const std::type_info& from, const std::type_info& to);
+
+    // Every edge recorded so far.
+    static const std::vector<edge_t>& edges();
+};
+
+template <typename From, typename To>
+struct Type_edge
+{
+    static const bool registered;
+};
+
+template <typename From, typename To>
+const bool Type_edge<From, To>::registered =
+        Type_graph::add_edge(typeid(From), typeid(To));
+
+// Instantiates a `Type_edge` for each pointer the trace can reach.
+template <typename From>
+struct Edge_type_tracer
+{
+    template <typename P>
+    void operator()(P) const
+    {
+        (void) &Type_edge<From, std::remove_pointer_t<P>>::registered;
+    }
+};
+
+template <typename P>
+struct Count_dropped
+{
+    // Set when a count drops; cleared when a collection processes the
+    // spaces of `P`. New types start out set.
+    static bool value;
+};
+
+template <typename P>
+bool Count_dropped<P>::value = true;
+
+} // end namespace detail
+
+} // end namespace gc
@@ -1,17 +1,42 @@
 // A `Typed_space<T>` manages the pointers of one type, `T`. It implements the
-// interface `Space`, which the `Collector` uses to manage it.
+// interface `Space`, which the `Collector` uses to manage it. If `Traced<T>`
+// is bigger than `large_object_size` then instead of allocating pages of
+// slots, the space gives each object its own block in a
+// `Large_object_space`. Each page keeps its slots’ used and mark bits in
+// bitmaps, so finding the used slots and sweeping work a word at a time.
+//
+// Objects that will live for the rest of the program can be allocated
+// *immortal*, in pages of their own that the collector never visits: their
+// mark bits are always set, and they are never swept. Pointers out of them
+// keep their pointees alive, since the references they count are never
+// subtracted by phase 2 (or in root-registry mode, because they are
+// registered as roots).
 #pragma once
 
 #include "forward.h"
+#include "Allocation_profiler.h"
+#include "bitmap.h"
+#include "Intern_table.h"
 #include "Space.h"
 #include "Collector.h"
+#include "Large_object_space.h"
 #include "logger.h"
+#include "Root_registry.h"
 #include "Traced.h"
+#include "Trace_recorder.h"
 #include "traced_ptr.h"
 #include "Traceable.h"
+#include "Type_graph.h"
+#include "write_barrier.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <type_traits>
+#include <typeinfo>
 #include <utility>
 #include <vector>
 #include <unordered_set>
@@ -19,10 +44,47 @@
 namespace gc {
 
 static constexpr size_t initial_page_size = 1024;
-static constexpr double max_live_ratio    = 0.75;
+
+// Whether a `Typed_space` allocates new objects immortal.
+enum class pretenure_t
+{
+    // Only `make_traced_immortal` does. (The default.)
+    never,
+
+    // Every new object is immortal.
+    always,
+
+    // New objects become immortal once the type’s objects are seen to
+    // survive: see below.
+    automatic,
+};
+
+// Under `pretenure_t::automatic`, a space starts allocating immortal
+// objects after `pretenure_after_collections` collections in a row that
+// each found at least `pretenure_min_allocations` objects allocated since
+// the previous collection, and fewer than `pretenure_max_death_ratio` of
+// that many dead. (Partial collections that skip the space don’t count.)
+static constexpr size_t pretenure_after_collections = 4;
+static constexpr size_t pretenure_min_allocations   = 1024;
+static constexpr double pretenure_max_death_ratio   = 0.02;
+
+// Whether `T`’s objects can be destroyed on the collector’s sweep threads,
+// concurrently with each other and with the destruction of other types’
+// objects (see `Collector::set_sweep_threads`). By default only trivial
+// destructors can, but a type with one and no pointers is swept lazily
+// rather than in parallel, so in practice only types that specialize this
+// are. Specialize it as `std::true_type` for a type whose destructor
+// touches nothing shared: in particular, no `traced_ptr`s, since their
+// counts aren’t atomic, and no allocation from the collector.
+template <typename T>
+struct parallel_destructible : std::is_trivially_destructible<T>
+{ };
+
+// A parallel sweep task covers at most this many words of a page’s bitmaps.
+static constexpr size_t parallel_sweep_words = 256;
 
 template <typename T, typename Allocator>
-class Typed_space : private detail::Space
+class Typed_space : private detail::Space, private detail::Region_space
 {
 public:
     // Returns the singleton instance for allocating objects of type `T`.
@@ -39,15 +101,86 @@ public:
     allocate(Args&&... args)
     {
         traced_ptr<T, Allocator> result;
-        result.ptr_ = allocate_(std::forward<Args>(args)...);
+        result.ptr_ = allocate_(pretenuring_, std::forward<Args>(args)...);
         result.inc_();
         return result;
     };
 
+    // Allocates an immortal object of type `T`, which is never collected
+    // or destroyed, given arguments to forward to its constructor.
+    template <typename... Args>
+    traced_ptr<T, Allocator>
+    allocate_immortal(Args&&... args)
+    {
+        traced_ptr<T, Allocator> result;
+        result.ptr_ = allocate_(true, std::forward<Args>(args)...);
+        result.inc_();
+        return result;
+    };
+
+    // Returns a live object equal to `T(args...)` if `intern` made one, or
+    // else allocates it and remembers it. Objects are compared with `==`
+    // and hashed with `std::hash<T>`, and must not change once interned.
+    template <typename... Args>
+    traced_ptr<T, Allocator>
+    intern(Args&&... args)
+    {
+        T value(std::forward<Args>(args)...);
+        size_t hash = std::hash<T>{}(value);
+
+        traced_ptr<T, Allocator> result;
+        result.ptr_ = interned_.find(hash, [&value](ptr_t ptr) {
+            return ptr->object_() == value;
+        });
+        if (result.ptr_ == nullptr) {
+            result.ptr_ = allocate_(pretenuring_, std::move(value));
+            interned_.insert(hash, result.ptr_);
+        }
+        result.inc_();
+        return result;
+    }
+
+    // The number of objects `intern` has made that are still alive (or
+    // not yet found dead).
+    size_t interned_size() const
+    {
+        return interned_.size();
+    }
+
+    pretenure_t pretenure() const
+    {
+        return pretenure_;
+    }
+
+    void set_pretenure(pretenure_t pretenure)
+    {
+        pretenure_              = pretenure;
+        pretenuring_            = pretenure == pretenure_t::always;
+        long_lived_collections_ = 0;
+    }
+
+    // Whether `allocate` is currently allocating immortal objects.
+    bool pretenuring() const
+    {
+        return pretenuring_;
+    }
+
 private:
+    friend class weak_traced_ptr<T, Allocator>;
+    friend struct detail::Image_type<Traced<T>>;
+
     // The type of pointer we are managing.
     using ptr_t = Traced<T>*;
 
+    // A piece of free list built by a parallel sweep task, to be spliced
+    // onto the real one.
+    struct Free_fragment
+    {
+        ptr_t  head;
+        ptr_t  tail;
+        size_t count;
+    };
+
     // Produces a friendly error if the given allocator doesn’t actually
     // allocate the right type.
     static_assert(std::is_same<Traced<T>, typename Allocator::value_type>::value,
@@ -56,10 +189,50 @@ private:
     Allocator allocator_;   // For allocating pages of `Traced<T>`s
     Collector& collector_;  // The collector managing this space
     size_t heap_size_;      // The capacity of this space, in objects
+    size_t page_bytes_;     // The memory in its pages, immortal ones too
     size_t live_size_;      // The number of used slots
     Traced<T>* pages_;      // Linked list of pages to allocate in
     Traced<T>* free_list_;  // Linked list of free object slots
+    Traced<T>* unthreaded_; // Pages swept lazily but not yet on the free list
+    size_t unthreaded_word_; // Where in the first of them to resume
     size_t next_page_size_; // How big the next page should be
+    std::vector<std::unique_ptr<detail::word_t[]>> page_bits_; // Bitmaps
+#ifdef PRECISEPP_COMPACT_HEADERS
+    std::vector<std::unique_ptr<size_t[]>> root_counts_; // Of each page
+#endif
+    std::vector<detail::word_t> dead_bits_; // Scratch for `sweep`
+    detail::Large_object_space<Traced<T>> large_objects_; // If `T` is large
+    std::vector<ptr_t> finalize_queue_; // Dead, awaiting destruction
+    std::vector<ptr_t> quarantine_;     // Destroyed, awaiting poisoning
+    std::vector<Free_fragment> sweep_fragments_; // From parallel sweeping
+    weak_traced_ptr<T, Allocator>* weak_list_; // Non-null weak pointers
+    detail::Intern_table<Traced<T>> interned_; // Made by `intern`
+
+    // Immortal objects are bump-allocated from a page list of their own.
+    Traced<T>* immortal_pages_; // Newest first
+    Traced<T>* immortal_next_;  // The next slot to allocate in the newest
+    Traced<T>* immortal_end_;   // The end of the newest
+    size_t immortal_page_size_; // How big the next immortal page should be
+    size_t immortal_size_;      // The number of immortal objects
+    detail::Large_object_space<Traced<T>> immortal_large_; // If `T` is large
+
+    // Objects allocated in a region are bump-allocated from region pages,
+    // which are kept for the next region unless something survives (see
+    // Region.h).
+    Traced<T>* region_pages_;   // Oldest first
+    Traced<T>* region_page_;    // The one being allocated in, if any
+    Traced<T>* region_next_;    // The next slot to allocate in it
+    Traced<T>* region_end_;     // The end of it
+    size_t region_page_size_;   // How big the next region page should be
+    bool region_joined_;        // Whether the open region knows of us
+#ifdef PRECISEPP_COMPACT_HEADERS
+    std::vector<std::unique_ptr<size_t[]>> region_root_counts_;
+#endif
+
+    pretenure_t pretenure_;     // When to allocate immortal objects
+    bool pretenuring_;          // Whether `allocate` does now
+    size_t allocated_since_;    // Since the last collection (not immortal)
+    size_t long_lived_collections_; // In a row, under `automatic`
 
     // Constructs a `Typed_space`, which includes registering it with a
     // collector. By default it uses the default (global) collector. (There is
@@ -67,14 +240,41 @@ private:
     explicit Typed_space(Collector& collector = Collector::instance())
             : collector_{collector}
             , heap_size_{0}
+            , page_bytes_{0}
             , live_size_{0}
             , pages_{nullptr}
             , free_list_{nullptr}
+            , unthreaded_{nullptr}
+            , unthreaded_word_{0}
             , next_page_size_{initial_page_size}
+            , weak_list_{nullptr}
+            , immortal_pages_{nullptr}
+            , immortal_next_{nullptr}
+            , immortal_end_{nullptr}
+            , immortal_page_size_{initial_page_size}
+            , immortal_size_{0}
+            , region_pages_{nullptr}
+            , region_page_{nullptr}
+            , region_next_{nullptr}
+            , region_end_{nullptr}
+            , region_page_size_{initial_page_size}
+            , region_joined_{false}
+            , pretenure_{pretenure_t::never}
+            , pretenuring_{false}
+            , allocated_since_{0}
+            , long_lived_collections_{0}
     {
+        (void) &record_edges_;
         collector_.register_space(*this);
     }
 
+    // Never called: instantiating it records the type graph’s edges out of
+    // `Traced<T>` (see Type_graph.h).
+    static void record_edges_(ptr_t ptr)
+    {
+        ptr->trace_object_(detail::Edge_type_tracer<Traced<T>>{});
+    }
+
     // Adds a new page: Requests memory for `next_page_size_`
     // objects from the allocator, adds its slots to the free list, and
     // adds the new page to the front of the page list. Doubles the size for
@@ -84,16 +284,13 @@ private:
         log(debug2) << "add_page_()";
         log(debug3) << "next_page_size_ = " << next_page_size_;
 
-        ptr_t page = allocator_.allocate(next_page_size_);
-        if (page == nullptr) throw std::bad_alloc{};
-
-        log(debug4) << "allocation success!";
-
-        page[0].initialize_header_(next_page_size_, pages_);
+        ptr_t page = new_page_(next_page_size_, pages_, false);
         pages_ = page;
 
-        for (size_t i = 1; i < next_page_size_; ++i)
+        for (size_t i = 1; i < next_page_size_; ++i) {
+            page[i].index_ = uint32_t(i);
             add_to_free_list_(&page[i]);
+        }
 
         heap_size_ += next_page_size_ - 1;
         next_page_size_ *= 2;
@@ -101,31 +298,228 @@ private:
         log(debug2) << "heap_size_ = " << heap_size_;
     }
 
-    // Adds the given pointer to the free list.
+    // Adds a page because allocation needs one, as far as the heap limits
+    // allow (see `Collector::may_grow_`). Making room may free slots
+    // instead.
+    void grow_()
+    {
+        size_t bytes = next_page_size_ * sizeof(Traced<T>);
+        for (int attempt = 0; !collector_.may_grow_(bytes, attempt);
+             ++attempt) {
+            thread_free_slots_(false);
+            if (free_list_ != nullptr) return;
+        }
+
+        add_page_();
+    }
+
+    // Adds a page after sweeping if the space is crowded and the heap
+    // limits leave room.
+    void grow_if_crowded_()
+    {
+        if (double(live_size_) / heap_size_ > max_live_ratio &&
+                collector_.may_grow_early_(next_page_size_ * sizeof(Traced<T>)))
+            add_page_();
+    }
+
+    // Allocates a page of `size` slots (including its header) that links
+    // to `next`. Its used bits are clear, and so are its mark bits, unless
+    // it’s for immortal objects, which are always marked.
+    ptr_t new_page_(size_t size, ptr_t next, bool immortal)
+    {
+        assert(size <= UINT32_MAX);
+
+        ptr_t page = allocator_.allocate(size);
+        if (page == nullptr) throw std::bad_alloc{};
+        page_bytes_ += size * sizeof(Traced<T>);
+        detail::add_heap_range(page, size * sizeof(Traced<T>));
+
+        log(debug4) << "allocation success!";
+
+        // Room for the used bits and then the mark bits.
+        size_t words = detail::words_for(size);
+        page_bits_.emplace_back(
+                new detail::word_t[Traced<T>::bits_words_(size)]());
+
+        page[0].initialize_header_(size, next, page_bits_.back().get());
+        if (immortal)
+            std::fill_n(page->mark_bits_(), words, ~detail::word_t(0));
+        return page;
+    }
+
+    // Gives each page somewhere to keep its objects’ root counts until
+    // `discard_root_counts`, if they don’t have them already. Only compact
+    // headers need this (see Traced.h).
+    void allocate_root_counts_()
+    {
+#ifdef PRECISEPP_COMPACT_HEADERS
+        if (!root_counts_.empty()) return;
+
+        for (ptr_t page = pages_; page != nullptr; page = page->next_page_()) {
+            root_counts_.emplace_back(new size_t[page->page_size_()]);
+            page->set_page_root_counts_(root_counts_.back().get());
+        }
+#endif
+    }
+
+    // Adds the given pointer to the free list, poisoning it if the
+    // collector is verifying.
     void add_to_free_list_(ptr_t ptr)
     {
         ptr->initialize_free_(free_list_);
         free_list_ = ptr;
+        if (collector_.verifying()) poison_slot_(ptr);
+    }
+
+    // Poisons a free slot, for heap verification.
+    static void poison_slot_(ptr_t ptr)
+    {
+        poison_link_(&ptr->next_free_());
+        poison_(ptr->free_bytes_(), Traced<T>::free_bytes_size_());
+    }
+
+    static bool is_slot_poisoned_(ptr_t ptr)
+    {
+        return is_link_poisoned_(&ptr->next_free_()) &&
+               is_poisoned_(ptr->free_bytes_(), Traced<T>::free_bytes_size_());
     }
 
-    // Allocates and initializes an object, given arguments to forward to its
-    // constructor. Looks for a slot on the free list first, and then
-    // collects if necessary.
+    // Allocates and initializes an object, immortal or not, given arguments
+    // to forward to its constructor. Looks for a slot on the free list
+    // first, and then collects if necessary.
     template<typename... Args>
-    ptr_t allocate_(Args&& ... args)
+    ptr_t allocate_(bool immortal, Args&& ... args)
+    {
+        log(debug4) << "allocate_(" << sizeof(T) << " bytes)";
+
+        if (detail::cycle_collector.full()) collector_.collect_cycles();
+
+        ptr_t result;
+        bool  in_region = false;
+        if (Traced<T>::is_large_())
+            result = immortal ? allocate_immortal_large_() : allocate_large_();
+        else if (immortal)
+            result = allocate_immortal_slot_();
+        else if (detail::regions.active()) {
+            result    = allocate_region_slot_();
+            in_region = true;
+        } else
+            result = allocate_slot_();
+
+        // Initialize the slot metadata.
+        result->initialize_used_();
+        detail::record_allocate(typeid(T), result, &result->object_(),
+                                sizeof(T), immortal);
+
+        // Now initialize the object, which is done differently depending on
+        // whether its constructor can throw.
+        construct_(std::is_nothrow_constructible<T, Args&&...>{},
+                   result, immortal, std::forward<Args>(args)...);
+
+        // Allocation success! Now the collector can see the object.
+        if (!Traced<T>::is_large_()) result->set_used_();
+        if (immortal) {
+            ++immortal_size_;
+        } else if (!in_region) {
+            ++live_size_;
+            ++allocated_since_;
+        }
+        detail::sample_allocation(typeid(T), sizeof(Traced<T>), result);
+
+        log(debug4) << "allocate() == " << &result->object_()
+                    << " (live_size_ == " << live_size_ << ")";
+
+        return result;
+    }
+
+    // Constructs the object in an allocated slot, for a constructor that
+    // can’t throw. An immortal object’s pointers are roots, so it is
+    // constructed as if outside the heap.
+    template <typename... Args>
+    static void construct_(std::true_type, ptr_t ptr, bool immortal,
+                           Args&& ... args)
+    {
+        detail::Heap_construction construction{&ptr->object_(),
+                                               immortal ? 0 : sizeof(T)};
+        ::new(&ptr->object_()) T(std::forward<Args>(args)...);
+    }
+
+    // Constructs the object, for a constructor that may throw. If it does,
+    // we put the slot back on the free list and re-throw. (An immortal slot
+    // is simply lost, and a region slot stays unused until its page is
+    // reset or promoted.)
+    template <typename... Args>
+    void construct_(std::false_type, ptr_t ptr, bool immortal,
+                    Args&& ... args)
+    {
+        try {
+            construct_(std::true_type{}, ptr, immortal,
+                       std::forward<Args>(args)...);
+        } catch (...) {
+            detail::record_deallocate(ptr);
+            if (immortal || detail::regions.contains(ptr)) {
+                // Lost.
+            } else if (Traced<T>::is_large_()) {
+                large_objects_.deallocate(ptr);
+                --heap_size_;
+            } else {
+                add_to_free_list_(ptr);
+            }
+            throw;
+        }
+    }
+
+    // Allocates an immortal object as a copy of one saved in a heap image,
+    // given its bytes, with its pointers still null (see Heap_image.h).
+    ptr_t allocate_image_(const char* bytes)
     {
-        log(debug4) << "allocate_(" << sizeof(decltype(T(args...))) << " bytes)";
-        // If the free list is empty, we either need to create the first page
-        // or run the collector. Either way, the free list should no longer
-        // be null.
+        ptr_t result = Traced<T>::is_large_() ? allocate_immortal_large_()
+                                              : allocate_immortal_slot_();
+        result->initialize_used_();
+        std::memcpy(static_cast<void*>(&result->object_()), bytes, sizeof(T));
+        if (!Traced<T>::is_large_()) result->set_used_();
+        ++immortal_size_;
+        return result;
+    }
+
+    // Takes a slot from the free list. This is the fast path, which is
+    // inlined into every allocation; anything out of the ordinary goes to
+    // `allocate_slot_slow_`.
+    ptr_t allocate_slot_()
+    {
+        ptr_t result = free_list_;
+        if (result == nullptr || collector_.verifying()
+#ifdef PRECISEPP_DEFERRED_COUNTS
+                || collector_.busy_
+#endif
+                )
+            return allocate_slot_slow_();
+
+        free_list_ = result->next_free_();
+        return result;
+    }
+
+    // Takes a slot from the free list when the fast path can’t. If the free
+    // list is empty, we first thread any pages swept lazily, and then we
+    // either need to create the first page or run the collector. Either
+    // way, the free list should no longer be null. (The collector declines
+    // to run if we’re allocating from a destructor during collection, in
+    // which case we grow instead.)
+    __attribute__((noinline))
+    ptr_t allocate_slot_slow_()
+    {
+        if (free_list_ == nullptr) thread_free_slots_(false);
+
         if (free_list_ == nullptr) {
             log(debug2) << "allocate_: free_list == nullptr";
             if (pages_ == nullptr) {
                 log(debug2) << "allocate_: pages_ == nullptr";
-                add_page_();
+                grow_();
             } else {
                 log(debug2) << "allocate_: going to collect";
-                collector_.collect();
+                collector_.collect_(this);
+                thread_free_slots_(false);
+                if (free_list_ == nullptr) grow_();
             }
 
             log(debug2) << "pages_ == " << pages_ << ", free_list_ == " << free_list_;
@@ -133,54 +527,154 @@ private:
             assert(free_list_ != nullptr);
         }
 
-        // Grab a slot from the free list.
+#ifdef PRECISEPP_DEFERRED_COUNTS
+        // A destructor is allocating, and a logged decrement may be meant
+        // for the dead object that had this slot.
+        if (collector_.busy_) detail::apply_count_logs();
+#endif
+
+        // Grab a slot from the free list, checking first that nothing
+        // wrote to it (or its link) while it was free.
         ptr_t result = free_list_;
+        if (collector_.verifying() && !is_slot_poisoned_(result))
+            Collector::verify_failed_("free slot was written to",
+                                      typeid(T), result);
         free_list_   = free_list_->next_free_();
+        return result;
+    }
 
-        // Initialize the slot metadata.
-        result->initialize_used_();
+    // Maps a block for a large object, collecting first if we have allocated
+    // enough large objects since the last collection.
+    ptr_t allocate_large_()
+    {
+        if (large_objects_.should_collect(sizeof(Traced<T>))) {
+            log(debug2) << "allocate_large_: going to collect";
+            collector_.collect_(this);
+        }
 
-        // Now try initializing the object. If the constructor throws we put
-        // the slot back on the free list and re-throw. (Do we really want to do
-        // a try-catch on every allocation? It might be better to a) leak, or
-        // b) use a commit protocol that leaves things in a recoverable state?)
-        try {
-            ::new(&result->object_()) T(std::forward<Args>(args)...);
-        } catch (...) {
-            add_to_free_list_(result);
-            throw;
+        collector_.make_room_(sizeof(Traced<T>));
+
+        ptr_t result = large_objects_.allocate(sizeof(Traced<T>));
+        ++heap_size_;
+        return result;
+    }
+
+    // Takes the next slot in the newest immortal page, adding a page if
+    // it’s full. Immortal pages are never collected, so there’s no reason
+    // to collect first.
+    ptr_t allocate_immortal_slot_()
+    {
+        if (immortal_next_ == immortal_end_) {
+            log(debug2) << "allocate_immortal_slot_: new page";
+            collector_.make_room_(immortal_page_size_ * sizeof(Traced<T>));
+            immortal_pages_ = new_page_(immortal_page_size_, immortal_pages_,
+                                        true);
+            immortal_next_  = immortal_pages_ + 1;
+            immortal_end_   = immortal_pages_ + immortal_page_size_;
+            immortal_page_size_ *= 2;
         }
 
-        // Allocation success!
-        ++live_size_;
+        ptr_t result   = immortal_next_++;
+        result->index_ = uint32_t(result - immortal_pages_);
+        return result;
+    }
+
+    // Takes the next slot in the current region page, going on to the next
+    // region page when it’s full, or adding one. Like immortal pages,
+    // region pages aren’t collected, so there’s no reason to collect first.
+    ptr_t allocate_region_slot_()
+    {
+        if (!region_joined_) {
+            detail::regions.join(*this);
+            region_joined_ = true;
+        }
 
-        log(debug4) << "allocate() == " << &result->object_()
-                    << " (live_size_ == " << live_size_ << ")";
+        if (region_next_ == region_end_) {
+            ptr_t page = region_page_ == nullptr ? region_pages_
+                                                 : region_page_->next_page_();
+            if (page == nullptr) {
+                log(debug2) << "allocate_region_slot_: new page";
+                size_t bytes = region_page_size_ * sizeof(Traced<T>);
+                collector_.make_room_(bytes);
+                page = new_page_(region_page_size_, nullptr, false);
+                detail::regions.add_page(page, bytes);
+                if (region_page_ == nullptr)
+                    region_pages_ = page;
+                else
+                    region_page_->next_page_() = page;
+                region_page_size_ *= 2;
+            }
 
+            region_page_ = page;
+            region_next_ = page + 1;
+            region_end_  = page + page->page_size_();
+        }
+
+        ptr_t result   = region_next_++;
+        result->index_ = uint32_t(result - region_page_);
+        return result;
+    }
+
+    // Maps a block for a large immortal object, and marks it for good.
+    ptr_t allocate_immortal_large_()
+    {
+        collector_.make_room_(sizeof(Traced<T>));
+        ptr_t result = immortal_large_.allocate(sizeof(Traced<T>));
+        detail::Large_object_space<Traced<T>>::test_and_set_mark(result);
         return result;
     }
 
     // Deallocates the pointed-to object, running its destructor and adding
-    // its slot to the free list.
+    // its slot to the free list. (A large object’s block was already queued
+    // for unmapping when it was swept.) When the collector is verifying,
+    // the slot waits in quarantine until `release` instead, since the
+    // destructors of other dead objects may yet decrement its count.
     void deallocate_(ptr_t ptr)
     {
-        ptr->object_().~T();
-        add_to_free_list_(ptr);
+        {
+            detail::Recording_pause pause;
+            ptr->object_().~T();
+        }
+        detail::record_deallocate(ptr);
+        if (Traced<T>::is_large_())
+            --heap_size_;
+        else if (collector_.verifying())
+            quarantine_.push_back(ptr);
+        else
+            add_to_free_list_(ptr);
         --live_size_;
     }
 
-    // The marking DFS, using `trace` to find edges.
-    template <typename S>
-    static void mark_recursively_(Traced<S>* ptr)
+    // Deallocates a dead object found by sweeping, or queues it for
+    // `finalize` if the collector batches finalization. Queued objects count
+    // as live until they’re deallocated.
+    void sweep_dead_(ptr_t ptr)
     {
-        log(debug4) << "mark_recursively_(" << ptr << ")";
-        if (ptr != nullptr && !ptr->mark_) {
-            ptr->mark_ = true;
-            ::gc::detail::trace(ptr->object_(), [](auto sub_ptr) {
-                mark_recursively_(sub_ptr);
-            });
-        }
-        log(debug4) << "end mark_recursively_(" << ptr << ")";
+        detail::sample_death(ptr);
+        if (collector_.finalization() == finalization_t::during_sweep)
+            deallocate_(ptr);
+        else
+            finalize_queue_.push_back(ptr);
+    }
+
+    // Adds a (non-null) weak pointer to the weak list.
+    void link_weak_(weak_traced_ptr<T, Allocator>* weak)
+    {
+        weak->prev_ = nullptr;
+        weak->next_ = weak_list_;
+        if (weak_list_ != nullptr) weak_list_->prev_ = weak;
+        weak_list_ = weak;
+    }
+
+    // Removes a weak pointer from the weak list.
+    void unlink_weak_(weak_traced_ptr<T, Allocator>* weak)
+    {
+        if (weak->prev_ != nullptr)
+            weak->prev_->next_ = weak->next_;
+        else
+            weak_list_ = weak->next_;
+        if (weak->next_ != nullptr)
+            weak->next_->prev_ = weak->prev_;
     }
 
     // Calls the given function on each used `Traced<T>*` in the heap.
@@ -188,29 +682,73 @@ private:
     void for_heap_(F f)
     {
         log(debug1) << "for_heap_()";
+        if (Traced<T>::is_large_()) {
+            large_objects_.for_each(f);
+            return;
+        }
+
         for (ptr_t page = pages_; page != nullptr; page = page->next_page_()) {
             log(debug2) << "page " << page
                         << " (size " << page->page_size_() << ")";
-            for (size_t i = 1; i < page->page_size_(); ++i) {
-                log(debug4) << &page[i]
-                            << (page[i].free_ ? " (free)" : " (used)");
-                if (!page[i].free_)
-                    f(&page[i]);
+            detail::for_each_bit(page->used_bits_(),
+                                 detail::words_for(page->page_size_()),
+                                 [page, &f](size_t i) {
+                log(debug4) << &page[i] << " (used)";
+                f(&page[i]);
+            });
+        }
+    }
+
+    // Calls the given function on each immortal `Traced<T>*`.
+    template <typename F>
+    void for_immortal_(F f)
+    {
+        if (Traced<T>::is_large_()) {
+            immortal_large_.for_each(f);
+            return;
+        }
+
+        for (ptr_t page = immortal_pages_; page != nullptr;
+             page = page->next_page_()) {
+            detail::for_each_bit(page->used_bits_(),
+                                 detail::words_for(page->page_size_()),
+                                 [page, &f](size_t i) { f(&page[i]); });
+        }
+    }
+
+    // Under `pretenure_t::automatic`, starts pretenuring once enough
+    // collections in a row find that few of the objects allocated since the
+    // last one died.
+    void note_survival_(size_t dead)
+    {
+        if (pretenure_ == pretenure_t::automatic && !pretenuring_) {
+            bool long_lived =
+                    allocated_since_ >= pretenure_min_allocations &&
+                    dead < pretenure_max_death_ratio * allocated_since_;
+            long_lived_collections_ = long_lived ? long_lived_collections_ + 1
+                                                 : 0;
+            if (long_lived_collections_ >= pretenure_after_collections) {
+                log(debug1) << "pretenuring " << typeid(T).name();
+                pretenuring_ = true;
             }
         }
+
+        allocated_since_ = 0;
     }
 
     // The remaining member functions are implementations of Space’s pure
     // virtual members.
 
     //
-    // Collection interface — the four phases of collection (see Space.h)
+    // Collection interface — the seven phases of collection (see Space.h)
     //
 
     // GC phase 1: Copies every ref_count_ to root_count_
     void save_counts() override
     {
+        allocate_root_counts_();
         for_heap_([](ptr_t ptr) {
+            ptr->merge_counts_();
             ptr->root_count_() = ptr->ref_count_();
         });
     }
@@ -220,34 +758,550 @@ private:
     void find_roots() override
     {
         for_heap_([](ptr_t ptr) {
-            ::gc::detail::trace(ptr->object_(), [](auto sub_ptr) {
-                if (sub_ptr != nullptr)
-                    --sub_ptr->root_count_();
-            });
+            ptr->trace_object_(detail::Root_tracer{});
         });
     }
 
-    // GC phase 3: Marks the live heap via tracing DFS.
+    // GC phase 3: Marks the live heap, starting from each root.
     void mark() override
     {
         for_heap_([](ptr_t ptr) {
             if (ptr->root_count_() > 0)
-                mark_recursively_(ptr);
+                mark_from_(ptr);
+        });
+    }
+
+    void discard_root_counts() override
+    {
+#ifdef PRECISEPP_COMPACT_HEADERS
+        for (ptr_t page = pages_; page != nullptr; page = page->next_page_())
+            page->set_page_root_counts_(nullptr);
+        root_counts_.clear();
+#endif
+    }
+
+    // GC phase 4: Clears weak pointers to unmarked objects. (Objects in an
+    // open region aren’t collected, marked or not.)
+    void clear_weak() override
+    {
+        weak_traced_ptr<T, Allocator>* weak = weak_list_;
+        while (weak != nullptr) {
+            weak_traced_ptr<T, Allocator>* next = weak->next_;
+            if (!weak->ptr_->marked_() &&
+                    !detail::regions.contains(weak->ptr_)) {
+                unlink_weak_(weak);
+                weak->ptr_ = nullptr;
+            }
+            weak = next;
+        }
+
+        if (!interned_.empty())
+            interned_.prune([](ptr_t ptr) {
+                return !ptr->marked_() && !detail::regions.contains(ptr);
+            });
+    }
+
+    // Whether sweeping can leave the dead objects alone: they have no
+    // destructor to run and no pointers to drop, so freeing them is only a
+    // matter of clearing their used bits (see `sweep_lazily_`). As for
+    // parallel sweeping, nothing else may need to see them die, including
+    // the trace recorder, which logs each death.
+    bool can_sweep_lazily_() const
+    {
+        return !Traced<T>::is_large_() &&
+               std::is_trivially_destructible<T>::value &&
+               !contains_pointers<T> &&
+               collector_.finalization() == finalization_t::during_sweep &&
+               !collector_.verifying() &&
+               detail::sampling.live_samples == 0 &&
+               !detail::recording;
+    }
+
+    // GC phase 5 for objects that `can_sweep_lazily_`: resets each page’s
+    // bitmaps and counts the dead, without touching any slot. The free list
+    // is then rebuilt from the used bits a page at a time, as allocation
+    // needs it.
+    void sweep_lazily_()
+    {
+        size_t dead = 0;
+        for (ptr_t page = pages_; page != nullptr; page = page->next_page_()) {
+            size_t words = detail::words_for(page->page_size_());
+            dead_bits_.resize(words);
+            detail::sweep_bits(page->used_bits_(), page->mark_bits_(),
+                               dead_bits_.data(), words);
+            dead += detail::count_bits(dead_bits_.data(), words);
+        }
+
+        free_list_       = nullptr;
+        unthreaded_      = pages_;
+        unthreaded_word_ = 0;
+        live_size_ -= dead;
+
+        note_survival_(dead);
+        grow_if_crowded_();
+    }
+
+    // Links the free slots of lazily swept pages into the free list, in
+    // address order: a bitmap word’s worth at a time until the free list
+    // has some, so they are still in the cache when allocated, or all of
+    // them if `all`. Everything else that frees slots expects every free
+    // slot to be on the free list already, and calls this first.
+    void thread_free_slots_(bool all)
+    {
+        while (unthreaded_ != nullptr && (all || free_list_ == nullptr)) {
+            ptr_t  page  = unthreaded_;
+            size_t size  = page->page_size_();
+            size_t w     = unthreaded_word_++;
+            if (unthreaded_word_ == detail::words_for(size)) {
+                unthreaded_      = page->next_page_();
+                unthreaded_word_ = 0;
+            }
+
+            detail::word_t free = ~page->used_bits_()[w];
+            if (w == 0) free &= ~detail::word_t(1);     // The header
+            if (size - w * detail::word_bits < detail::word_bits)
+                free &= (detail::word_t(1) << size % detail::word_bits) - 1;
+
+            ptr_t  head = free_list_;
+            ptr_t* link = &head;
+            detail::for_each_bit(free, w * detail::word_bits,
+                                 [page, &link](size_t i) {
+                *link = &page[i];
+                link  = &page[i].next_free_();
+            });
+            *link      = free_list_;
+            free_list_ = head;
+        }
+    }
+
+    // Whether `plan_sweep` can hand our pages to the sweep threads. Besides
+    // the type allowing it, dead objects must be freed right away, and
+    // without help from anything that isn’t thread safe: heap verification,
+    // the profiler following samples, or the trace recorder.
+    bool can_sweep_in_parallel_() const
+    {
+        return !Traced<T>::is_large_() &&
+               !can_sweep_lazily_() &&
+               parallel_destructible<T>::value &&
+               collector_.finalization() == finalization_t::during_sweep &&
+               !collector_.verifying() &&
+               detail::sampling.live_samples == 0 &&
+               !detail::recording;
+    }
+
+    // Sweeps `words` words of a page’s bitmaps starting at word `first`,
+    // destroying the dead objects and linking their slots into `fragment`.
+    // Parallel sweep tasks run this on disjoint pieces of the heap.
+    static void sweep_piece_(ptr_t page, size_t first, size_t words,
+                             Free_fragment& fragment)
+    {
+        detail::word_t dead_bits[parallel_sweep_words];
+        detail::sweep_bits(page->used_bits_() + first,
+                           page->mark_bits_() + first, dead_bits, words);
+
+        fragment = Free_fragment{nullptr, nullptr, 0};
+        detail::for_each_bit(dead_bits, words,
+                             [page, first, &fragment](size_t i) {
+            ptr_t ptr = &page[first * detail::word_bits + i];
+            ptr->object_().~T();
+            ptr->next_free_() = fragment.head;
+            if (fragment.head == nullptr) fragment.tail = ptr;
+            fragment.head = ptr;
+            ++fragment.count;
         });
     }
 
-    // GC phase 4: Sweeps away the dead heap, deallocating and resetting marks.
+    // GC phase 5, in parallel: Splits our pages into pieces of at most
+    // `parallel_sweep_words` bitmap words, and adds a task to sweep each.
+    // `sweep` splices the free list fragments they build.
+    void plan_sweep(detail::Sweep_tasks& tasks) override
+    {
+        if (!can_sweep_in_parallel_()) return;
+
+        thread_free_slots_(true);
+
+        size_t pieces = 0;
+        for (ptr_t page = pages_; page != nullptr; page = page->next_page_())
+            pieces += (detail::words_for(page->page_size_())
+                       + parallel_sweep_words - 1) / parallel_sweep_words;
+        sweep_fragments_.resize(pieces);
+
+        Free_fragment* fragment = sweep_fragments_.data();
+        for (ptr_t page = pages_; page != nullptr; page = page->next_page_()) {
+            size_t words = detail::words_for(page->page_size_());
+            for (size_t first = 0; first < words;
+                 first += parallel_sweep_words) {
+                size_t n = std::min(parallel_sweep_words, words - first);
+                tasks.emplace_back([page, first, n, fragment] {
+                    sweep_piece_(page, first, n, *fragment);
+                });
+                ++fragment;
+            }
+        }
+    }
+
+    // GC phase 5: Sweeps away the dead heap, deallocating (or queueing) dead
+    // objects and resetting marks. Dead large objects’ blocks are unmapped
+    // by `release`. For each page, the sweep kernel finds the dead slots and
+    // resets the bitmaps in bulk, and then we visit only the dead slots. If
+    // the sweep threads already did that, we just splice their free lists.
     void sweep() override
     {
-        for_heap_([this](ptr_t ptr) {
-            if (ptr->mark_)
-                ptr->mark_ = false;
-            else
-                deallocate_(ptr);
+        size_t dead = 0;
+
+        if (!sweep_fragments_.empty()) {
+            for (const Free_fragment& fragment : sweep_fragments_) {
+                if (fragment.count == 0) continue;
+                fragment.tail->next_free_() = free_list_;
+                free_list_ = fragment.head;
+                dead += fragment.count;
+            }
+            sweep_fragments_.clear();
+            live_size_ -= dead;
+
+            note_survival_(dead);
+            grow_if_crowded_();
+            return;
+        }
+
+        if (can_sweep_lazily_()) {
+            sweep_lazily_();
+            return;
+        }
+
+        thread_free_slots_(true);
+
+        if (Traced<T>::is_large_()) {
+            large_objects_.sweep([this, &dead](ptr_t ptr) {
+                sweep_dead_(ptr);
+                ++dead;
+            });
+            note_survival_(dead);
+            return;
+        }
+
+        for (ptr_t page = pages_; page != nullptr; page = page->next_page_()) {
+            size_t words = detail::words_for(page->page_size_());
+            dead_bits_.resize(words);
+            detail::sweep_bits(page->used_bits_(), page->mark_bits_(),
+                               dead_bits_.data(), words);
+            detail::for_each_bit(dead_bits_.data(), words,
+                                 [this, page, &dead](size_t i) {
+                sweep_dead_(&page[i]);
+                ++dead;
+            });
+        }
+
+        note_survival_(dead);
+
+        grow_if_crowded_();
+    }
+
+    // GC phase 6: Destroys and deallocates the objects queued by `sweep`.
+    void finalize() override
+    {
+        for (ptr_t ptr : finalize_queue_)
+            deallocate_(ptr);
+        finalize_queue_.clear();
+    }
+
+    // GC phase 7: Unmaps dead large objects, and frees (and poisons) the
+    // slots quarantined while verifying.
+    void release() override
+    {
+        large_objects_.release();
+        for (ptr_t ptr : quarantine_)
+            add_to_free_list_(ptr);
+        quarantine_.clear();
+    }
+
+    void dump(detail::Heap_dump& dump) override
+    {
+        dump.space(typeid(T), "object", sizeof(T));
+        for_heap_([&dump](ptr_t ptr) {
+            ptr->trace_object_(dump.edge_tracer());
+            dump.object(ptr, sizeof(Traced<T>),
+                        ptr->ref_count_(), ptr->root_count_());
         });
 
-        if (double(live_size_) / heap_size_ > max_live_ratio)
-            add_page_();
+        // Immortal objects are roots, in effect.
+        for_immortal_([&dump](ptr_t ptr) {
+            ptr->merge_counts_();
+            ptr->trace_object_(dump.edge_tracer());
+            dump.object(ptr, sizeof(Traced<T>), ptr->ref_count_(), 1);
+        });
+    }
+
+    // Heap verification: one step of checking the counts against the
+    // marks (see `Verify_step`).
+    void verify(detail::Verify_step step) override
+    {
+        using detail::Verify_step;
+
+        if (step == Verify_step::save_counts) allocate_root_counts_();
+
+        for_heap_([step](ptr_t ptr) {
+            if (step == Verify_step::check_root_counts) {
+                if (ptr->root_count_() > ptr->ref_count_())
+                    Collector::verify_failed_(
+                            "root count underflowed; something traces a "
+                            "pointer to this object that it doesn’t count",
+                            typeid(T), &ptr->object_());
+                return;
+            }
+
+            if (ptr->marked_()) return;
+
+            switch (step) {
+            case Verify_step::save_counts:
+                ptr->root_count_() = ptr->ref_count_();
+                break;
+
+            case Verify_step::count_dead_refs:
+                ptr->trace_object_(detail::Unmarked_tracer{});
+                break;
+
+            case Verify_step::check_unmarked:
+                if (ptr->root_count_() > ptr->ref_count_())
+                    Collector::verify_failed_(
+                            "dead objects trace more pointers to this "
+                            "object than it counts",
+                            typeid(T), &ptr->object_());
+                if (ptr->root_count_() > 0)
+                    Collector::verify_failed_(
+                            "unmarked object is still referred to by a "
+                            "live object or root; is a TRACE missing?",
+                            typeid(T), &ptr->object_());
+                break;
+
+            default:
+                break;
+            }
+        });
+    }
+
+    void poison_free() override
+    {
+        thread_free_slots_(true);
+        for (ptr_t ptr = free_list_; ptr != nullptr; ptr = ptr->next_free_())
+            poison_slot_(ptr);
+    }
+
+    const std::type_info& traced_type() const override
+    {
+        return typeid(Traced<T>);
+    }
+
+    bool count_dropped() const override
+    {
+        return detail::Count_dropped<Traced<T>>::value;
+    }
+
+    void clear_count_dropped() override
+    {
+        detail::Count_dropped<Traced<T>>::value = false;
+    }
+
+    size_t heap_bytes() const override
+    {
+        return page_bytes_ + large_objects_.bytes() + immortal_large_.bytes();
+    }
+
+    //
+    // Cycle collection interface (see Cycle_collector.h)
+    //
+
+    void cycle_clear_weak(const std::vector<const void*>& dead) override
+    {
+        auto is_dead = [&dead](ptr_t ptr) {
+            return std::binary_search(dead.begin(), dead.end(),
+                                      static_cast<const void*>(ptr));
+        };
+
+        weak_traced_ptr<T, Allocator>* weak = weak_list_;
+        while (weak != nullptr) {
+            weak_traced_ptr<T, Allocator>* next = weak->next_;
+            if (is_dead(weak->ptr_)) {
+                unlink_weak_(weak);
+                weak->ptr_ = nullptr;
+            }
+            weak = next;
+        }
+
+        if (!interned_.empty()) interned_.prune(is_dead);
+    }
+
+    void cycle_destroy(void* ptr) override
+    {
+        auto object = static_cast<ptr_t>(ptr);
+        detail::sample_death(object);
+        {
+            detail::Recording_pause pause;
+            object->object_().~T();
+        }
+        detail::record_deallocate(object);
+    }
+
+    void cycle_free(void* ptr) override
+    {
+        auto object = static_cast<ptr_t>(ptr);
+        if (Traced<T>::is_large_()) {
+            large_objects_.deallocate(object);
+            --heap_size_;
+        } else {
+            thread_free_slots_(true);
+            add_to_free_list_(object);
+        }
+        --live_size_;
+    }
+
+    //
+    // Region interface — the phases of closing a region (see Region.h)
+    //
+
+    // Calls the given function on each used `Traced<T>*` in a region page.
+    template <typename F>
+    void for_region_(F f)
+    {
+        for (ptr_t page = region_pages_; page != nullptr;
+             page = page->next_page_()) {
+            detail::for_each_bit(page->used_bits_(),
+                                 detail::words_for(page->page_size_()),
+                                 [page, &f](size_t i) { f(&page[i]); });
+        }
+    }
+
+    // Collections may have marked region objects.
+    void region_save_counts() override
+    {
+        for (ptr_t page = region_pages_; page != nullptr;
+             page = page->next_page_()) {
+            std::fill_n(page->mark_bits_(),
+                        detail::words_for(page->page_size_()),
+                        detail::word_t(0));
+#ifdef PRECISEPP_COMPACT_HEADERS
+            region_root_counts_.emplace_back(new size_t[page->page_size_()]);
+            page->set_page_root_counts_(region_root_counts_.back().get());
+#endif
+        }
+
+        for_region_([](ptr_t ptr) {
+            ptr->merge_counts_();
+            ptr->root_count_() = ptr->ref_count_();
+        });
+    }
+
+    void region_find_roots() override
+    {
+        for_region_([](ptr_t ptr) {
+            ptr->trace_object_(detail::Region_root_tracer{});
+        });
+    }
+
+    void region_mark() override
+    {
+        for_region_([](ptr_t ptr) {
+            if (ptr->root_count_() > 0)
+                mark_region_from_(ptr);
+        });
+    }
+
+    void region_clear_weak() override
+    {
+        weak_traced_ptr<T, Allocator>* weak = weak_list_;
+        while (weak != nullptr) {
+            weak_traced_ptr<T, Allocator>* next = weak->next_;
+            if (detail::regions.contains(weak->ptr_) &&
+                    !weak->ptr_->marked_()) {
+                unlink_weak_(weak);
+                weak->ptr_ = nullptr;
+            }
+            weak = next;
+        }
+
+        if (!interned_.empty())
+            interned_.prune([](ptr_t ptr) {
+                return detail::regions.contains(ptr) && !ptr->marked_();
+            });
+    }
+
+    // Goes a word of bits at a time, without scratch space, since a
+    // destructor may start a collection.
+    void region_sweep() override
+    {
+        for (ptr_t page = region_pages_; page != nullptr;
+             page = page->next_page_()) {
+            detail::word_t* used  = page->used_bits_();
+            detail::word_t* marks = page->mark_bits_();
+            for (size_t w = 0; w < detail::words_for(page->page_size_());
+                 ++w) {
+                detail::word_t dead = used[w] & ~marks[w];
+                used[w] &= marks[w];
+                marks[w] = 0;
+                detail::for_each_bit(dead, w * detail::word_bits,
+                                     [page](size_t i) {
+                    ptr_t ptr = &page[i];
+                    detail::sample_death(ptr);
+                    {
+                        detail::Recording_pause pause;
+                        ptr->object_().~T();
+                    }
+                    detail::record_deallocate(ptr);
+                });
+            }
+        }
+    }
+
+    // Promoted pages go to the front of the page list, and their free
+    // slots (the dead, and any never allocated) onto the free list.
+    void region_release() override
+    {
+        region_joined_ = false;
+
+        size_t survivors = 0;
+        for (ptr_t page = region_pages_; page != nullptr;
+             page = page->next_page_()) {
+            size_t words = detail::words_for(page->page_size_());
+            survivors += detail::count_bits(page->used_bits_(), words);
+            std::fill_n(page->mark_bits_(), words, detail::word_t(0));
+#ifdef PRECISEPP_COMPACT_HEADERS
+            page->set_page_root_counts_(nullptr);
+#endif
+        }
+#ifdef PRECISEPP_COMPACT_HEADERS
+        region_root_counts_.clear();
+#endif
+
+        region_page_ = region_next_ = region_end_ = nullptr;
+        if (survivors == 0) return;
+
+        log(debug2) << "region: promoting " << survivors << " "
+                    << typeid(T).name();
+
+        thread_free_slots_(true);
+        ptr_t page = region_pages_;
+        while (page != nullptr) {
+            ptr_t  next = page->next_page_();
+            size_t size = page->page_size_();
+            detail::regions.remove_page(page);
+
+            for (size_t i = 1; i < size; ++i) {
+                page[i].index_ = uint32_t(i);
+                if (!detail::test_bit(page->used_bits_(), i))
+                    add_to_free_list_(&page[i]);
+            }
+
+            page->next_page_() = pages_;
+            pages_      = page;
+            heap_size_ += size - 1;
+            page        = next;
+        }
+
+        // The next region starts over with small pages, rather than doubling
+        // from pages it no longer has.
+        region_pages_     = nullptr;
+        region_page_size_ = initial_page_size;
+        live_size_       += survivors;
     }
 
     //
@@ -267,7 +1321,7 @@ public:
 
     size_t used_slots() const override
     {
-        return live_size_;
+        return live_size_ + immortal_size_;
     }
 };
 
@@ -282,6 +1336,20 @@ make_traced_in(Typed_space<T, Allocator>& space, Args&&... args)
     return space.allocate(std::forward<Args>(args)...);
 }
 
+// Allocates an immortal object of type `T` in the default space, given
+// parameters to forward to its constructor. It is never collected, and the
+// collector doesn’t visit it, so this suits structures that are built once
+// and kept for the rest of the program.
+template <typename T,
+          typename Allocator  = std::allocator<Traced<T>>,
+          typename... Args>
+traced_ptr<T, Allocator>
+make_traced_immortal(Args&&... args)
+{
+    auto& space = Typed_space<T, Allocator>::instance();
+    return space.allocate_immortal(std::forward<Args>(args)...);
+}
+
 // Allocates an object of type `T` in the default space, given parameters to
 // forward to its constructor.
 template <typename T,
@@ -294,4 +1362,19 @@ make_traced(Args&&... args)
     return space.allocate(std::forward<Args>(args)...);
 }
 
+// Like `make_traced`, but returns the object already made this way if one
+// equal to `T(args...)` is still alive, so that equal immutable objects are
+// shared, and can be compared by their pointers. The object is constructed
+// (on the stack) either way, and moved into the heap if it’s new. See
+// `Typed_space::intern`.
+template <typename T,
+          typename Allocator  = std::allocator<Traced<T>>,
+          typename... Args>
+traced_ptr<T, Allocator>
+make_interned(Args&&... args)
+{
+    auto& space = Typed_space<T, Allocator>::instance();
+    return space.intern(std::forward<Args>(args)...);
+}
+
 } // end namespace gc
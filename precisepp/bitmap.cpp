@@ -0,0 +1,85 @@
+#include "bitmap.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PRECISEPP_X86 1
+#endif
+
+namespace gc
+{
+namespace detail
+{
+
+namespace
+{
+
+void sweep_bits_scalar(word_t* used, word_t* marks, word_t* dead, size_t n)
+{
+    for (size_t w = 0; w < n; ++w) {
+        dead[w]  = used[w] & ~marks[w];
+        used[w] &= marks[w];
+        marks[w] = 0;
+    }
+}
+
+#ifdef PRECISEPP_X86
+
+__attribute__((target("sse2")))
+void sweep_bits_sse2(word_t* used, word_t* marks, word_t* dead, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t w = 0;
+    for (; w + 2 <= n; w += 2) {
+        __m128i u = _mm_loadu_si128(reinterpret_cast<__m128i*>(used + w));
+        __m128i m = _mm_loadu_si128(reinterpret_cast<__m128i*>(marks + w));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dead + w),
+                         _mm_andnot_si128(m, u));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(used + w),
+                         _mm_and_si128(m, u));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(marks + w), zero);
+    }
+    sweep_bits_scalar(used + w, marks + w, dead + w, n - w);
+}
+
+__attribute__((target("avx2")))
+void sweep_bits_avx2(word_t* used, word_t* marks, word_t* dead, size_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t w = 0;
+    for (; w + 4 <= n; w += 4) {
+        __m256i u = _mm256_loadu_si256(reinterpret_cast<__m256i*>(used + w));
+        __m256i m = _mm256_loadu_si256(reinterpret_cast<__m256i*>(marks + w));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dead + w),
+                            _mm256_andnot_si256(m, u));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(used + w),
+                            _mm256_and_si256(m, u));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(marks + w), zero);
+    }
+    sweep_bits_scalar(used + w, marks + w, dead + w, n - w);
+}
+
+#endif // PRECISEPP_X86
+
+using sweep_bits_t = void (*)(word_t*, word_t*, word_t*, size_t);
+
+// Picks the widest kernel the processor supports.
+sweep_bits_t select_sweep_bits()
+{
+#ifdef PRECISEPP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return sweep_bits_avx2;
+    if (__builtin_cpu_supports("sse2")) return sweep_bits_sse2;
+#endif
+    return sweep_bits_scalar;
+}
+
+} // end anonymous namespace
+
+void sweep_bits(word_t* used, word_t* marks, word_t* dead, size_t n)
+{
+    static const sweep_bits_t kernel = select_sweep_bits();
+    kernel(used, marks, dead, n);
+}
+
+} // end namespace detail
+} // end namespace gc
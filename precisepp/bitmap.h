@@ -0,0 +1,83 @@
+// Bitmaps of per-slot flags (used and mark bits), stored apart from the
+// slots themselves so that the collector can scan and reset them a word, or
+// a vector of words, at a time.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gc
+{
+namespace detail
+{
+
+using word_t = uint64_t;
+static constexpr size_t word_bits = 64;
+
+// The number of words needed for `bits` bits.
+inline size_t words_for(size_t bits)
+{
+    return (bits + word_bits - 1) / word_bits;
+}
+
+inline bool test_bit(const word_t* words, size_t i)
+{
+    return (words[i / word_bits] >> (i % word_bits)) & 1;
+}
+
+inline void set_bit(word_t* words, size_t i)
+{
+    words[i / word_bits] |= word_t(1) << (i % word_bits);
+}
+
+inline void clear_bit(word_t* words, size_t i)
+{
+    words[i / word_bits] &= ~(word_t(1) << (i % word_bits));
+}
+
+// Sets bit `i`, returning whether it was already set.
+inline bool test_and_set_bit(word_t* words, size_t i)
+{
+    word_t& word  = words[i / word_bits];
+    word_t  bit   = word_t(1) << (i % word_bits);
+    bool   result = (word & bit) != 0;
+    word |= bit;
+    return result;
+}
+
+// Calls `f(base + i)` for each set bit `i` of `word`, in order.
+template <typename F>
+void for_each_bit(word_t word, size_t base, F f)
+{
+    while (word != 0) {
+        size_t i = size_t(__builtin_ctzll(word));
+        word &= word - 1;
+        f(base + i);
+    }
+}
+
+// Calls `f(i)` for each set bit `i` of an `n`-word bitmap.
+template <typename F>
+void for_each_bit(const word_t* words, size_t n, F f)
+{
+    for (size_t w = 0; w < n; ++w)
+        for_each_bit(words[w], w * word_bits, f);
+}
+
+// The number of set bits in an `n`-word bitmap.
+inline size_t count_bits(const word_t* words, size_t n)
+{
+    size_t result = 0;
+    for (size_t w = 0; w < n; ++w)
+        result += size_t(__builtin_popcountll(words[w]));
+    return result;
+}
+
+// The sweep kernel: for each of `n` words, stores the used-but-unmarked
+// bits in `dead`, clears them from `used`, and clears `marks`. Uses AVX2
+// or SSE2 when the processor has them.
+void sweep_bits(word_t* used, word_t* marks, word_t* dead, size_t n);
+
+} // end namespace detail
+} // end namespace gc
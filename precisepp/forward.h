@@ -7,16 +7,46 @@
 namespace gc
 {
 
+namespace detail
+{
+
+class Space;
+
+template <typename P>
+struct Image_type;
+
+} // end namespace detail
+
 template <typename T>
 class Traced;
 
+template <typename T>
+class Traced_array;
+
+struct no_barrier;
+
 template <typename T,
-          typename Allocator = std::allocator<Traced<T>>>
+          typename Allocator = std::allocator<Traced<T>>,
+          typename Barrier   = no_barrier>
 class traced_ptr;
 
+template <typename T,
+          typename Allocator = std::allocator<Traced<T>>>
+class weak_traced_ptr;
+
 template <typename T,
           typename Allocator = std::allocator<Traced<T>>>
 class Typed_space;
 
+template <typename T,
+          typename Allocator = std::allocator<Traced_array<T>>>
+class traced_array;
+
+template <typename T,
+          typename Allocator = std::allocator<Traced_array<T>>>
+class Array_space;
+
+template <typename T>
+struct imageable;
 
 } // end namespace gc
\ No newline at end of file
@@ -5,6 +5,14 @@
 
 
 #include "Traceable.h"
+#include "trace_fields.h"
 #include "traced_ptr.h"
 #include "Typed_space.h"
+#include "weak_traced_ptr.h"
+#include "traced_array.h"
+#include "Array_space.h"
+#include "vector.h"
+#include "hash_map.h"
+#include "Heap_image.h"
+#include "Region.h"
 
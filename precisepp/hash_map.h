@@ -0,0 +1,639 @@
+// A gc::hash_map<K, V> is an open-addressing hash table whose slots live in
+// a `traced_array` of groups in an `Array_space`, so the table is counted in
+// heap statistics and traced without chasing per-node pointers.
+//
+// The layout follows SwissTable: slots come in groups of 16, each with 16
+// control bytes that say whether a slot is empty, deleted, or full (and if
+// full, hold 7 bits of its hash). Lookups compare a whole group of control
+// bytes at once, with SSE2 where available, and tracing scans the control
+// bytes to visit only the full slots.
+
+#pragma once
+
+#include "forward.h"
+#include "Traceable.h"
+#include "traced_array.h"
+#include "Array_space.h"
+#include "Root_registry.h"
+#include "stl/utility.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace gc
+{
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+class hash_map;
+
+namespace detail
+{
+
+// A group of `width` slots for elements of type `E`, with their control
+// bytes.
+template <typename E>
+class Hash_group
+{
+public:
+    static constexpr size_t width = 16;
+
+    // Control byte values. A full slot’s control byte is the low 7 bits of
+    // its hash, so it’s never negative.
+    static constexpr int8_t empty   = -128;
+    static constexpr int8_t deleted = -2;
+
+    Hash_group()
+    {
+        std::memset(ctrl_, empty, width);
+    }
+
+    Hash_group(const Hash_group&) = delete;
+    Hash_group& operator=(const Hash_group&) = delete;
+
+    ~Hash_group()
+    {
+        clear();
+    }
+
+    E* slot(size_t i)
+    {
+        return reinterpret_cast<E*>(slots_) + i;
+    }
+
+    const E* slot(size_t i) const
+    {
+        return reinterpret_cast<const E*>(slots_) + i;
+    }
+
+    int8_t& ctrl(size_t i)
+    {
+        return ctrl_[i];
+    }
+
+    // The following return bitmasks with bit `i` set for each slot `i` that
+    // matches.
+
+    // Full slots whose hash has the given low 7 bits.
+    uint32_t match(int8_t h2) const
+    {
+#ifdef __SSE2__
+        return uint32_t(_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_set1_epi8(h2), load_())));
+#else
+        uint32_t result = 0;
+        for (size_t i = 0; i < width; ++i)
+            if (ctrl_[i] == h2) result |= uint32_t(1) << i;
+        return result;
+#endif
+    }
+
+    uint32_t match_empty() const
+    {
+        return match(empty);
+    }
+
+    // Empty or deleted slots, which are those with the sign bit set.
+    uint32_t match_free() const
+    {
+#ifdef __SSE2__
+        return uint32_t(_mm_movemask_epi8(load_()));
+#else
+        uint32_t result = 0;
+        for (size_t i = 0; i < width; ++i)
+            if (ctrl_[i] < 0) result |= uint32_t(1) << i;
+        return result;
+#endif
+    }
+
+    uint32_t match_full() const
+    {
+        return ~match_free() & ((uint32_t(1) << width) - 1);
+    }
+
+    // Destroys the elements and marks every slot empty.
+    void clear()
+    {
+        for (uint32_t full = match_full(); full != 0; full &= full - 1)
+            slot(size_t(__builtin_ctz(full)))->~E();
+        std::memset(ctrl_, empty, width);
+    }
+
+private:
+    alignas(16) int8_t ctrl_[width];
+    alignas(E) unsigned char slots_[width * sizeof(E)];
+
+#ifdef __SSE2__
+    __m128i load_() const
+    {
+        return _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl_));
+    }
+#endif
+};
+
+// Iterates over the full slots of an array of groups. `G` is
+// `Hash_group<E>` or `const Hash_group<E>`.
+template <typename G, typename E>
+class Hash_map_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = std::remove_const_t<E>;
+    using difference_type   = ptrdiff_t;
+    using pointer           = E*;
+    using reference         = E&;
+
+    Hash_map_iterator() : groups_{nullptr}, index_{0}, end_{0}
+    { }
+
+    Hash_map_iterator(G* groups, size_t index, size_t end)
+            : groups_{groups}, index_{index}, end_{end}
+    {
+        skip_free_();
+    }
+
+    // Converts an iterator to a const_iterator.
+    template <typename G2, typename E2>
+    Hash_map_iterator(const Hash_map_iterator<G2, E2>& other)
+            : groups_{other.groups_}, index_{other.index_}, end_{other.end_}
+    { }
+
+    reference operator*() const
+    {
+        return *operator->();
+    }
+
+    pointer operator->() const
+    {
+        G& group = groups_[index_ / G::width];
+        return group.slot(index_ % G::width);
+    }
+
+    Hash_map_iterator& operator++()
+    {
+        ++index_;
+        skip_free_();
+        return *this;
+    }
+
+    Hash_map_iterator operator++(int)
+    {
+        Hash_map_iterator result = *this;
+        ++*this;
+        return result;
+    }
+
+    bool operator==(const Hash_map_iterator& other) const
+    {
+        return index_ == other.index_;
+    }
+
+    bool operator!=(const Hash_map_iterator& other) const
+    {
+        return index_ != other.index_;
+    }
+
+private:
+    template <typename G2, typename E2>
+    friend class Hash_map_iterator;
+
+    template <typename K, typename V, typename Hash, typename Equal,
+              typename Allocator>
+    friend class ::gc::hash_map;
+
+    G*     groups_;
+    size_t index_;
+    size_t end_;
+
+    // Advances to the next full slot (or the end), a group at a time.
+    void skip_free_()
+    {
+        while (index_ < end_) {
+            size_t   offset = index_ % G::width;
+            uint32_t full   = groups_[index_ / G::width].match_full() >> offset;
+            if (full != 0) {
+                index_ += size_t(__builtin_ctz(full));
+                return;
+            }
+            index_ += G::width - offset;
+        }
+    }
+};
+
+} // end namespace detail
+
+// Only the full slots of a group are traced.
+template <typename E>
+DEFINE_TRACEABLE(detail::Hash_group<E>)
+{
+    CONTAINS_POINTERS_IF(::gc::contains_pointers<E>);
+    TO_TRACE(const detail::Hash_group<E>& group)
+    {
+        if (Traceable::contains_pointers_v)
+            for (uint32_t full = group.match_full(); full != 0;
+                 full &= full - 1)
+                TRACE(*group.slot(size_t(__builtin_ctz(full))));
+    }
+};
+
+// A group’s bytes can go in a heap image if its elements’ can (see
+// Heap_image.h).
+template <typename E>
+struct imageable<detail::Hash_group<E>> : imageable<E>
+{ };
+
+template <typename K, typename V,
+          typename Hash      = std::hash<K>,
+          typename Equal     = std::equal_to<K>,
+          typename Allocator = std::allocator<Traced_array<
+                  detail::Hash_group<std::pair<const K, V>>>>>
+class hash_map
+{
+    using group_t = detail::Hash_group<std::pair<const K, V>>;
+    static constexpr size_t width = group_t::width;
+
+public:
+    using key_type        = K;
+    using mapped_type     = V;
+    using value_type      = std::pair<const K, V>;
+    using size_type       = size_t;
+    using hasher          = Hash;
+    using key_equal       = Equal;
+    using iterator        = detail::Hash_map_iterator<group_t, value_type>;
+    using const_iterator  =
+            detail::Hash_map_iterator<const group_t, const value_type>;
+
+    explicit hash_map(const Hash& hash = Hash(), const Equal& equal = Equal())
+            : size_{0}, tombstones_{0}, hash_{hash}, equal_{equal}
+    { }
+
+    hash_map(std::initializer_list<value_type> values) : hash_map{}
+    {
+        reserve(values.size());
+        for (const value_type& value : values) insert(value);
+    }
+
+    hash_map(const hash_map& other)
+            : hash_map{other.hash_, other.equal_}
+    {
+        reserve(other.size());
+        for (const value_type& value : other) insert(value);
+    }
+
+    hash_map(hash_map&& other) noexcept : hash_map{}
+    {
+        swap(other);
+    }
+
+    hash_map& operator=(const hash_map& other)
+    {
+        hash_map copy{other};
+        swap(copy);
+        return *this;
+    }
+
+    hash_map& operator=(hash_map&& other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    size_type size() const { return size_; }
+    bool empty() const     { return size_ == 0; }
+
+    iterator begin()
+    {
+        return iterator{groups_.data(), 0, slot_count_()};
+    }
+
+    iterator end()
+    {
+        return iterator{groups_.data(), slot_count_(), slot_count_()};
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator{groups_.data(), 0, slot_count_()};
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator{groups_.data(), slot_count_(), slot_count_()};
+    }
+
+    iterator find(const K& key)
+    {
+        size_t index = find_(key);
+        return index == npos_ ? end()
+                              : iterator{groups_.data(), index, slot_count_()};
+    }
+
+    const_iterator find(const K& key) const
+    {
+        size_t index = find_(key);
+        return index == npos_
+               ? end()
+               : const_iterator{groups_.data(), index, slot_count_()};
+    }
+
+    size_type count(const K& key) const
+    {
+        return find_(key) == npos_ ? 0 : 1;
+    }
+
+    V& at(const K& key)
+    {
+        size_t index = find_(key);
+        if (index == npos_) throw std::out_of_range{"gc::hash_map::at"};
+        return slot_(index)->second;
+    }
+
+    const V& at(const K& key) const
+    {
+        return const_cast<hash_map*>(this)->at(key);
+    }
+
+    V& operator[](const K& key)
+    {
+        return try_emplace(key).first->second;
+    }
+
+    // Inserts a value constructed from `args` under `key` unless the key is
+    // already present.
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+    {
+        size_t index = find_(key);
+        if (index != npos_)
+            return {iterator{groups_.data(), index, slot_count_()}, false};
+
+        index = insert_(key, std::piecewise_construct,
+                        std::forward_as_tuple(key),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+        return {iterator{groups_.data(), index, slot_count_()}, true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        return try_emplace(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        return try_emplace(value.first, std::move(value.second));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        value_type value(std::forward<Args>(args)...);
+        return try_emplace(value.first, std::move(value.second));
+    }
+
+    size_type erase(const K& key)
+    {
+        size_t index = find_(key);
+        if (index == npos_) return 0;
+        erase_(index);
+        return 1;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        size_t index = pos.index_;
+        erase_(index);
+        return iterator{groups_.data(), index, slot_count_()};
+    }
+
+    void clear()
+    {
+        for (group_t& group : groups_) group.clear();
+        size_       = 0;
+        tombstones_ = 0;
+    }
+
+    // Makes room for at least `count` elements without rehashing.
+    void reserve(size_type count)
+    {
+        size_t groups = 1;
+        while (groups * width * 7 / 8 < count) groups *= 2;
+        if (groups > groups_.size()) rehash_(groups);
+    }
+
+    void swap(hash_map& other) noexcept
+    {
+        using std::swap;
+        groups_.swap(other.groups_);
+        swap(size_, other.size_);
+        swap(tombstones_, other.tombstones_);
+        swap(hash_, other.hash_);
+        swap(equal_, other.equal_);
+    }
+
+private:
+    friend class Traceable<hash_map>;
+
+    static constexpr size_t npos_ = size_t(-1);
+
+    traced_array<group_t, Allocator> groups_; // A power of two of them
+    size_t size_;       // The number of full slots
+    size_t tombstones_; // The number of deleted slots
+    Hash   hash_;
+    Equal  equal_;
+
+    size_t slot_count_() const
+    {
+        return groups_.size() * width;
+    }
+
+    value_type* slot_(size_t index) const
+    {
+        return groups_[index / width].slot(index % width);
+    }
+
+    // Spreads the user’s hash, whose low bits may be all that vary, over
+    // all the bits. The low 7 bits go in the control byte and the rest
+    // choose the group.
+    size_t hash_of_(const K& key) const
+    {
+        uint64_t h = uint64_t(hash_(key)) * 0x9E3779B97F4A7C15ull;
+        return size_t(h ^ (h >> 32));
+    }
+
+    static int8_t h2_(size_t hash)
+    {
+        return int8_t(hash & 0x7F);
+    }
+
+    // Calls `f` on each group index in the probe sequence for `hash` until
+    // it returns true. Triangular probing visits every group, since there
+    // is a power of two of them.
+    template <typename F>
+    void probe_(size_t hash, F f) const
+    {
+        size_t mask  = groups_.size() - 1;
+        size_t group = (hash >> 7) & mask;
+        for (size_t step = 1; !f(group); ++step)
+            group = (group + step) & mask;
+    }
+
+    size_t find_(const K& key) const
+    {
+        if (size_ == 0) return npos_;
+
+        size_t hash   = hash_of_(key);
+        size_t result = npos_;
+        probe_(hash, [&](size_t g) {
+            const group_t& group = groups_[g];
+            for (uint32_t m = group.match(h2_(hash)); m != 0; m &= m - 1) {
+                size_t i = size_t(__builtin_ctz(m));
+                if (equal_(group.slot(i)->first, key)) {
+                    result = g * width + i;
+                    return true;
+                }
+            }
+            return group.match_empty() != 0;
+        });
+        return result;
+    }
+
+    // Finds a free slot for `hash`, which must exist.
+    size_t find_free_(size_t hash) const
+    {
+        size_t result = npos_;
+        probe_(hash, [&](size_t g) {
+            uint32_t free = groups_[g].match_free();
+            if (free == 0) return false;
+            result = g * width + size_t(__builtin_ctz(free));
+            return true;
+        });
+        return result;
+    }
+
+    // Constructs a new element (whose key must not be present) from `args`,
+    // growing first if necessary, and returns its index. The control byte
+    // is set only after the element is constructed, so a collection during
+    // construction won’t trace it.
+    template <typename... Args>
+    size_t insert_(const K& key, Args&&... args)
+    {
+        if ((size_ + tombstones_ + 1) * 8 > slot_count_() * 7)
+            grow_();
+
+        size_t  hash  = hash_of_(key);
+        size_t  index = find_free_(hash);
+        group_t& group = groups_[index / width];
+        size_t  i     = index % width;
+
+        {
+            detail::Heap_construction construction{group.slot(i),
+                                                   sizeof(value_type)};
+            ::new(group.slot(i)) value_type(std::forward<Args>(args)...);
+        }
+        if (group.ctrl(i) == group_t::deleted) --tombstones_;
+        group.ctrl(i) = h2_(hash);
+        ++size_;
+
+        return index;
+    }
+
+    // Destroys the element at `index`. If its group still has an empty
+    // slot then no probe sequence ever passed through the group, so the
+    // slot can be empty again; otherwise it becomes a tombstone.
+    void erase_(size_t index)
+    {
+        group_t& group = groups_[index / width];
+        size_t   i     = index % width;
+
+        group.slot(i)->~value_type();
+        if (group.match_empty() != 0) {
+            group.ctrl(i) = group_t::empty;
+        } else {
+            group.ctrl(i) = group_t::deleted;
+            ++tombstones_;
+        }
+        --size_;
+    }
+
+    // Rehashes into a bigger table, or the same size if it’s mostly
+    // tombstones.
+    void grow_()
+    {
+        size_t groups = std::max(size_t(1), groups_.size());
+        if ((size_ + 1) * 8 > groups * width * 7 / 2) groups *= 2;
+        rehash_(groups);
+    }
+
+    // Moves every element to a new table of `groups` groups. A collection
+    // while allocating or moving sees both tables, and the old elements are
+    // destroyed only after they’ve all been moved.
+    void rehash_(size_t groups)
+    {
+        traced_array<group_t, Allocator> old =
+                make_traced_array<group_t, Allocator>(groups);
+        groups_.swap(old);
+        tombstones_ = 0;
+
+        for (group_t& old_group : old) {
+            for (uint32_t m = old_group.match_full(); m != 0; m &= m - 1) {
+                value_type* src   = old_group.slot(size_t(__builtin_ctz(m)));
+                size_t      hash  = hash_of_(src->first);
+                size_t      index = find_free_(hash);
+                group_t&    group = groups_[index / width];
+                size_t      i     = index % width;
+
+                {
+                    detail::Heap_construction construction{
+                            group.slot(i), sizeof(value_type)};
+                    ::new(group.slot(i)) value_type(std::move(*src));
+                }
+                group.ctrl(i) = h2_(hash);
+            }
+        }
+
+        for (group_t& old_group : old) old_group.clear();
+    }
+};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+DEFINE_TRACEABLE(hash_map<K, V, Hash, Equal, Allocator>)
+{
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const hash_map<K, V, Hash, Equal, Allocator>& m)
+    {
+        TRACE(m.groups_);
+    }
+};
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+struct imageable<hash_map<K, V, Hash, Equal, Allocator>>
+        : std::integral_constant<bool,
+                std::is_trivially_copyable<Hash>::value &&
+                std::is_trivially_copyable<Equal>::value>
+{ };
+
+template <typename K, typename V, typename Hash, typename Equal,
+          typename Allocator>
+void swap(hash_map<K, V, Hash, Equal, Allocator>& a,
+          hash_map<K, V, Hash, Equal, Allocator>& b) noexcept
+{
+    a.swap(b);
+};
+
+} // end namespace gc
@@ -29,7 +29,7 @@ class TupleCountDown_<0, T>
     friend class TupleCountDown_<1, T>;
 
     TO_TRACE(const T&) {}
-}
+};
 
 } // end namespace internal
 } // end namespace gc
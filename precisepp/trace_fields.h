@@ -0,0 +1,286 @@
+// `GC_TRACE_FIELDS(Type, field1, field2, ...)` defines `Traceable<Type>`
+// from a list of its fields, instead of a handwritten `TO_TRACE` body:
+//
+//     struct Pair_node { int key; traced_ptr<Pair_node> left, right; };
+//     GC_TRACE_FIELDS(Pair_node, key, left, right);
+//
+// Besides the usual generic `trace`, the generated `Traceable` builds (once)
+// a table of the offsets of every `traced_ptr` and `traced_array` in the
+// type, looking through `std::pair`, `std::tuple`, `std::array`, and other
+// `GC_TRACE_FIELDS` types, and the collector marks by walking that table:
+// it loads the pointer at each offset and pushes it onto the marker’s stack
+// with no call in between. Fields the table can’t see into, such as a
+// `std::vector`, get one entry each that traces them as usual, through a
+// function pointer. Finding roots, which needs each pointee’s type to find
+// its count, goes through the generic `trace`, which the compiler inlines.
+//
+// `Type` must be a non-template class without virtual bases, and must be
+// named as it would be outside any namespace. At most 16 fields may be
+// listed.
+
+#pragma once
+
+#include "Traceable.h"
+#include "Space.h"
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace gc
+{
+namespace detail
+{
+
+// An entry in an offset table for a traced pointer or array: its pointer
+// is at `offset` from the start of the object, and is pushed with `scan`.
+struct Pointer_edge
+{
+    size_t         offset;
+    Marker::scan_t scan;
+};
+
+// An entry for a field that the table can’t see into, at `offset`, which
+// `mark` traces with its `Traceable`.
+struct Field_edge
+{
+    size_t offset;
+    void (*mark)(const void* field);
+};
+
+struct Field_table
+{
+    std::vector<Pointer_edge> pointers;
+    std::vector<Field_edge>   fields;
+};
+
+// The offset of a member within its class. (`offsetof` is only guaranteed
+// for standard-layout types.)
+template <typename C, typename M>
+size_t offset_of(M C::* member)
+{
+    alignas(C) static const char storage[sizeof(C)] = {};
+    auto object = reinterpret_cast<const C*>(storage);
+    return size_t(reinterpret_cast<const char*>(&(object->*member)) - storage);
+}
+
+// The offset of the `I`th element of a tuple.
+template <size_t I, typename Tuple>
+size_t tuple_offset_of()
+{
+    alignas(Tuple) static const char storage[sizeof(Tuple)] = {};
+    auto tuple = reinterpret_cast<const Tuple*>(storage);
+    return size_t(reinterpret_cast<const char*>(&std::get<I>(*tuple))
+                  - storage);
+}
+
+// The offset of the pointer within a traced pointer or array.
+template <typename L>
+size_t pointer_offset_of()
+{
+    alignas(L) static const char storage[sizeof(L)] = {};
+    auto field = reinterpret_cast<const L*>(storage);
+    return size_t(reinterpret_cast<const char*>(
+                          ::gc::Traceable<L>::pointer_(*field)) - storage);
+}
+
+template <typename L>
+void mark_field_(const void* field)
+{
+    ::gc::detail::trace(*static_cast<const L*>(field), Mark_tracer{});
+}
+
+// Whether `T` is a traced pointer or array, whose `Traceable` says where
+// its pointer is.
+template <typename T, typename = void>
+struct is_pointer_field : std::false_type { };
+
+template <typename T>
+struct is_pointer_field<T, decltype(void(&::gc::Traceable<T>::pointer_))>
+        : std::true_type { };
+
+// Whether `Traceable<T>` was defined by `GC_TRACE_FIELDS`.
+template <typename T, typename = void>
+struct has_field_table : std::false_type { };
+
+template <typename T>
+struct has_field_table<T, decltype(void(&::gc::Traceable<T>::add_fields_))>
+        : std::true_type { };
+
+// Appends the entries for a `T` at `base` to a table. A `T` that can’t
+// contain pointers has none, a traced pointer or array is a pointer entry,
+// a `GC_TRACE_FIELDS` type contributes its fields, and anything else that
+// can contain pointers is a field entry.
+template <typename T, typename = void>
+struct Field_offsets
+{
+    static void add(Field_table& table, size_t base)
+    {
+        if (::gc::contains_pointers<T>)
+            table.fields.push_back({base, &mark_field_<T>});
+    }
+};
+
+template <typename T>
+struct Field_offsets<T, std::enable_if_t<is_pointer_field<T>::value>>
+{
+    static void add(Field_table& table, size_t base)
+    {
+        using pointer_t = typename ::gc::Traceable<T>::pointer_t;
+        table.pointers.push_back({base + pointer_offset_of<T>(),
+                                  Mark_tracer::scan_for<pointer_t>()});
+    }
+};
+
+template <typename T>
+struct Field_offsets<T, std::enable_if_t<has_field_table<T>::value>>
+{
+    static void add(Field_table& table, size_t base)
+    {
+        ::gc::Traceable<T>::add_fields_(table, base);
+    }
+};
+
+template <typename T1, typename T2>
+struct Field_offsets<std::pair<T1, T2>>
+{
+    static void add(Field_table& table, size_t base)
+    {
+        using pair_t = std::pair<T1, T2>;
+        Field_offsets<std::remove_cv_t<T1>>::add(
+                table, base + offset_of(&pair_t::first));
+        Field_offsets<std::remove_cv_t<T2>>::add(
+                table, base + offset_of(&pair_t::second));
+    }
+};
+
+template <typename E, size_t N>
+struct Field_offsets<std::array<E, N>>
+{
+    static void add(Field_table& table, size_t base)
+    {
+        if (!::gc::contains_pointers<E>) return;
+        for (size_t i = 0; i < N; ++i)
+            Field_offsets<E>::add(table, base + i * sizeof(E));
+    }
+};
+
+template <typename... Es>
+struct Field_offsets<std::tuple<Es...>>
+{
+    static void add(Field_table& table, size_t base)
+    {
+        add_(table, base, std::index_sequence_for<Es...>{});
+    }
+
+private:
+    template <size_t... Is>
+    static void add_(Field_table& table, size_t base,
+                     std::index_sequence<Is...>)
+    {
+        using tuple_t = std::tuple<Es...>;
+        int dummy[] = {0, (Field_offsets<std::remove_cv_t<Es>>::add(
+                table, base + tuple_offset_of<Is, tuple_t>()), 0)...};
+        (void) dummy;
+    }
+};
+
+// The offset table for a `GC_TRACE_FIELDS` type `T`, built on first use.
+template <typename T>
+const Field_table& field_table()
+{
+    static const Field_table table = [] {
+        Field_table result;
+        ::gc::Traceable<T>::add_fields_(result, 0);
+        return result;
+    }();
+    return table;
+}
+
+// Pushes an object’s pointees onto the marker’s stack by its offset table.
+inline void mark_by_table(const Field_table& table, const void* object)
+{
+    auto base = static_cast<const char*>(object);
+    for (const Pointer_edge& edge : table.pointers) {
+        void* ptr = *reinterpret_cast<void* const*>(base + edge.offset);
+        if (ptr != nullptr) Mark_tracer::push(ptr, edge.scan);
+    }
+    for (const Field_edge& edge : table.fields)
+        edge.mark(base + edge.offset);
+}
+
+} // end namespace detail
+} // end namespace gc
+
+// Calls `M(Type, field)` for each field; up to 16.
+#define GC_FOR_EACH_FIELD_1(M, C, f) M(C, f)
+#define GC_FOR_EACH_FIELD_2(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_1(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_3(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_2(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_4(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_3(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_5(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_4(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_6(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_5(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_7(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_6(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_8(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_7(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_9(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_8(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_10(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_9(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_11(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_10(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_12(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_11(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_13(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_12(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_14(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_13(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_15(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_14(M, C, __VA_ARGS__)
+#define GC_FOR_EACH_FIELD_16(M, C, f, ...) M(C, f) GC_FOR_EACH_FIELD_15(M, C, __VA_ARGS__)
+
+#define GC_FOR_EACH_FIELD_PICK_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, \
+                                _11, _12, _13, _14, _15, _16, NAME, ...) NAME
+
+#define GC_FOR_EACH_FIELD(M, C, ...) \
+    GC_FOR_EACH_FIELD_PICK_(__VA_ARGS__, \
+        GC_FOR_EACH_FIELD_16, GC_FOR_EACH_FIELD_15, GC_FOR_EACH_FIELD_14, \
+        GC_FOR_EACH_FIELD_13, GC_FOR_EACH_FIELD_12, GC_FOR_EACH_FIELD_11, \
+        GC_FOR_EACH_FIELD_10, GC_FOR_EACH_FIELD_9, GC_FOR_EACH_FIELD_8, \
+        GC_FOR_EACH_FIELD_7, GC_FOR_EACH_FIELD_6, GC_FOR_EACH_FIELD_5, \
+        GC_FOR_EACH_FIELD_4, GC_FOR_EACH_FIELD_3, GC_FOR_EACH_FIELD_2, \
+        GC_FOR_EACH_FIELD_1)(M, C, __VA_ARGS__)
+
+#define GC_FIELD_CONTAINS_POINTERS_(C, f) \
+    || ::gc::contains_pointers<std::remove_cv_t<decltype(C::f)>>
+
+#define GC_TRACE_FIELD_(C, f) \
+    TRACE(object.f);
+
+#define GC_ADD_FIELD_(C, f) \
+    ::gc::detail::Field_offsets<std::remove_cv_t<decltype(C::f)>>::add( \
+            table, base + ::gc::detail::offset_of(&C::f));
+
+#define GC_TRACE_FIELDS(Type, ...) \
+    template <> \
+    DEFINE_TRACEABLE(Type) \
+    { \
+        CONTAINS_POINTERS_IF(false \
+                GC_FOR_EACH_FIELD(GC_FIELD_CONTAINS_POINTERS_, Type, \
+                                  __VA_ARGS__)); \
+        TO_TRACE(const Type& object) \
+        { \
+            GC_FOR_EACH_FIELD(GC_TRACE_FIELD_, Type, __VA_ARGS__) \
+        } \
+        static void trace(const Type& object, ::gc::detail::Mark_tracer) \
+        { \
+            ::gc::detail::mark_by_table( \
+                    ::gc::detail::field_table<Type>(), &object); \
+        } \
+        template <typename T__> \
+        friend const ::gc::detail::Field_table& \
+        ::gc::detail::field_table(); \
+        template <typename T__, typename> \
+        friend struct ::gc::detail::Field_offsets; \
+        template <typename T__, typename> \
+        friend struct ::gc::detail::has_field_table; \
+        static void add_fields_(::gc::detail::Field_table& table, \
+                                size_t base) \
+        { \
+            GC_FOR_EACH_FIELD(GC_ADD_FIELD_, Type, __VA_ARGS__) \
+        } \
+    }
@@ -0,0 +1,230 @@
+// A traced_array<T> is a garbage-collected pointer to a variable-length
+// array of T. The array’s elements are stored inline, right after its
+// metadata, so there is no separate buffer to allocate or chase. An array
+// may have room for more elements than it holds (see `reserve_traced_array`),
+// in which case it can grow in place up to its capacity.
+
+#pragma once
+
+#include "forward.h"
+#include "Root_registry.h"
+#include "Traceable.h"
+#include "Traced.h"
+#include "Trace_recorder.h"
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace gc
+{
+
+template <typename T, typename Allocator>
+class traced_array : public detail::Root_hook<traced_array<T, Allocator>>
+{
+public:
+    using element_type = T;
+    using pointer      = T*;
+    using iterator     = T*;
+    using size_type    = size_t;
+
+    traced_array() : ptr_{nullptr}
+    { }
+
+    traced_array(std::nullptr_t) : traced_array{}
+    { }
+
+    traced_array(const traced_array& other)
+    {
+        ptr_ = other.ptr_;
+        inc_();
+    }
+
+    traced_array(traced_array&& other) noexcept : ptr_{other.ptr_}
+    {
+        other.ptr_ = nullptr;
+        if (ptr_ != nullptr) detail::record_move(&other, this);
+    }
+
+    traced_array& operator=(const traced_array& other)
+    {
+        dec_();
+        ptr_ = other.ptr_;
+        inc_();
+        return *this;
+    }
+
+    traced_array& operator=(traced_array&& other) noexcept
+    {
+        std::swap(ptr_, other.ptr_);
+        detail::record_swap(this, &other);
+        return *this;
+    }
+
+    ~traced_array()
+    {
+        dec_();
+    }
+
+    operator bool()
+    {
+        return ptr_ != nullptr;
+    }
+
+    size_type size() const
+    {
+        return ptr_ == nullptr ? 0 : ptr_->size_();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // The number of elements the array has room for.
+    size_type capacity() const
+    {
+        return ptr_ == nullptr ? 0 : ptr_->capacity_();
+    }
+
+    // Constructs a new last element from the given arguments. The array
+    // must have spare capacity.
+    template <typename... Args>
+    element_type& emplace_back(Args&&... args) const
+    {
+        assert(size() < capacity());
+        T* element = ptr_->elements_() + ptr_->size_();
+        detail::Heap_construction construction{element, sizeof(T)};
+        ::new(element) T(std::forward<Args>(args)...);
+        ++ptr_->size_();
+        return *element;
+    }
+
+    // Destroys the last element.
+    void pop_back() const
+    {
+        assert(!empty());
+        --ptr_->size_();
+        ptr_->elements_()[ptr_->size_()].~T();
+    }
+
+    // Destroys all the elements, keeping the capacity.
+    void clear() const
+    {
+        while (!empty()) pop_back();
+    }
+
+    pointer data() const
+    {
+        return ptr_ == nullptr ? nullptr : ptr_->elements_();
+    }
+
+    element_type& operator[](size_type i) const
+    {
+        return ptr_->elements_()[i];
+    }
+
+    iterator begin() const
+    {
+        return data();
+    }
+
+    iterator end() const
+    {
+        return data() + size();
+    }
+
+    void swap(traced_array& other)
+    {
+        std::swap(ptr_, other.ptr_);
+        detail::record_swap(this, &other);
+    }
+
+private:
+    friend class Traceable<traced_array>;
+    friend class Array_space<T, Allocator>;
+
+    Traced_array<T>* ptr_;
+
+    void inc_() const
+    {
+        if (ptr_ != nullptr) {
+            ptr_->add_ref_();
+            detail::record_store(this, ptr_);
+        }
+    }
+
+    void dec_() const
+    {
+        if (ptr_ != nullptr) {
+            ptr_->drop_ref_();
+            detail::record_clear(this);
+        }
+    }
+};
+
+template <typename T, typename Allocator>
+DEFINE_TRACEABLE(traced_array<T, Allocator>)
+{
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const traced_array<T, Allocator>& p)
+    {
+        tracer(p.ptr_);
+    }
+
+public:
+    // The pointer and where it is, for the offset tables of trace_fields.h.
+    using pointer_t = Traced_array<T>*;
+
+    static const pointer_t* pointer_(const traced_array<T, Allocator>& p)
+    {
+        return &p.ptr_;
+    }
+};
+
+template <typename T, typename Allocator>
+void swap(traced_array<T, Allocator>& a, traced_array<T, Allocator>& b)
+{
+    a.swap(b);
+};
+
+template <typename T, typename Allocator>
+bool operator==(const traced_array<T, Allocator>& a,
+                const traced_array<T, Allocator>& b)
+{
+    return a.data() == b.data();
+};
+
+template <typename T, typename Allocator>
+bool operator!=(const traced_array<T, Allocator>& a,
+                const traced_array<T, Allocator>& b)
+{
+    return a.data() != b.data();
+};
+
+template <typename T, typename Allocator>
+bool operator==(std::nullptr_t, const traced_array<T, Allocator>& b)
+{
+    return nullptr == b.data();
+};
+
+template <typename T, typename Allocator>
+bool operator==(const traced_array<T, Allocator>& a, std::nullptr_t)
+{
+    return a.data() == nullptr;
+};
+
+template <typename T, typename Allocator>
+bool operator!=(std::nullptr_t, const traced_array<T, Allocator>& b)
+{
+    return nullptr != b.data();
+};
+
+template <typename T, typename Allocator>
+bool operator!=(const traced_array<T, Allocator>& a, std::nullptr_t)
+{
+    return a.data() != nullptr;
+};
+
+} // end namespace gc
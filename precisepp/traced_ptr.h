@@ -1,10 +1,15 @@
-// A traced_ptr<T> is a garbage-collected pointer to a T.
+// A traced_ptr<T> is a garbage-collected pointer to a T. Its optional third
+// parameter is a write barrier policy (see write_barrier.h); pointers that
+// differ only in their barriers convert to each other.
 
 #pragma once
 
 #include "forward.h"
+#include "Root_registry.h"
 #include "Traceable.h"
 #include "Traced.h"
+#include "Trace_recorder.h"
+#include "write_barrier.h"
 
 #include <utility>
 #include <unordered_set>
@@ -15,8 +20,8 @@
 namespace gc
 {
 
-template <typename T, typename Allocator>
-class traced_ptr
+template <typename T, typename Allocator, typename Barrier>
+class traced_ptr : public detail::Root_hook<traced_ptr<T, Allocator, Barrier>>
 {
 public:
     using element_type = T;
@@ -29,28 +34,54 @@ public:
     { }
 
     traced_ptr(const traced_ptr& other)
+            : detail::Root_hook<traced_ptr>{}, ptr_{other.ptr_}
     {
-        ptr_ = other.ptr_;
         inc_();
     }
 
-    traced_ptr(traced_ptr&& other) noexcept
+    traced_ptr(traced_ptr&& other) noexcept : ptr_{other.ptr_}
     {
-        std::swap(ptr_, other.ptr_);
+        other.ptr_ = nullptr;
+        if (ptr_ != nullptr) detail::record_move(&other, this);
     }
 
-    traced_ptr& operator=(const traced_ptr& other)
+    template <typename Other_barrier>
+    traced_ptr(const traced_ptr<T, Allocator, Other_barrier>& other)
+            : ptr_{other.ptr_}
     {
-        dec_();
-        ptr_ = other.ptr_;
         inc_();
-        return *this;
+    }
+
+    template <typename Other_barrier>
+    traced_ptr(traced_ptr<T, Allocator, Other_barrier>&& other) noexcept
+            : ptr_{other.ptr_}
+    {
+        other.ptr_ = nullptr;
+        if (ptr_ != nullptr) detail::record_move(&other, this);
+    }
+
+    traced_ptr& operator=(const traced_ptr& other)
+    {
+        return assign_(other);
     }
 
     traced_ptr& operator=(traced_ptr&& other) noexcept
     {
-        std::swap(ptr_, other.ptr_);
-        return *this;
+        return move_assign_(other);
+    }
+
+    template <typename Other_barrier>
+    traced_ptr&
+    operator=(const traced_ptr<T, Allocator, Other_barrier>& other)
+    {
+        return assign_(other);
+    }
+
+    template <typename Other_barrier>
+    traced_ptr&
+    operator=(traced_ptr<T, Allocator, Other_barrier>&& other) noexcept
+    {
+        return move_assign_(other);
     }
 
     ~traced_ptr()
@@ -81,160 +112,204 @@ public:
     void swap(traced_ptr& other)
     {
         std::swap(ptr_, other.ptr_);
+        detail::record_swap(this, &other);
+        Barrier::write(this);
+        Barrier::write(&other);
     }
 
 private:
     friend class Traceable<traced_ptr>;
     friend class Typed_space<T, Allocator>;
+    friend class weak_traced_ptr<T, Allocator>;
+    friend struct detail::Image_type<Traced<T>>;
+
+    template <typename S, typename A, typename B>
+    friend class traced_ptr;
 
     Traced<T>* ptr_;
 
+    template <typename Other_barrier>
+    traced_ptr& assign_(const traced_ptr<T, Allocator, Other_barrier>& other)
+    {
+        dec_();
+        ptr_ = other.ptr_;
+        inc_();
+        Barrier::write(this);
+        return *this;
+    }
+
+    // Swaps, so the old pointee is released with `other`. Both pointers are
+    // overwritten, so both get their barriers.
+    template <typename Other_barrier>
+    traced_ptr& move_assign_(traced_ptr<T, Allocator, Other_barrier>& other)
+    {
+        std::swap(ptr_, other.ptr_);
+        detail::record_swap(this, &other);
+        Barrier::write(this);
+        Other_barrier::write(&other);
+        return *this;
+    }
+
     void inc_()
     {
-        if (ptr_ != nullptr)
-            ++ptr_->ref_count_();
+        if (ptr_ != nullptr) {
+            ptr_->add_ref_();
+            detail::record_store(this, ptr_);
+        }
     }
 
     void dec_()
     {
-        if (ptr_ != nullptr)
-            --ptr_->ref_count_();
+        if (ptr_ != nullptr) {
+            ptr_->drop_ref_();
+            detail::record_clear(this);
+        }
     }
 };
 
-template <typename T, typename Allocator>
-DEFINE_TRACEABLE(traced_ptr<T, Allocator>)
+template <typename T, typename Allocator, typename Barrier>
+DEFINE_TRACEABLE(traced_ptr<T, Allocator, Barrier>)
 {
-    TO_TRACE(const traced_ptr<T, Allocator>& p)
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const traced_ptr<T, Allocator, Barrier>& p)
     {
         tracer(p.ptr_);
     }
+
+public:
+    // The pointer and where it is, for the offset tables of trace_fields.h.
+    using pointer_t = Traced<T>*;
+
+    static const pointer_t* pointer_(const traced_ptr<T, Allocator, Barrier>& p)
+    {
+        return &p.ptr_;
+    }
 };
 
-template <typename T, typename Allocator>
-void swap(traced_ptr<T, Allocator>& a, traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+void swap(traced_ptr<T, Allocator, Barrier>& a, traced_ptr<T, Allocator, Barrier>& b)
 {
     a.swap(b);
 };
 
-template <typename T1, typename Allocator1,
-          typename T2, typename Allocator2>
-bool operator==(const traced_ptr<T1, Allocator1>& a,
-                const traced_ptr<T2, Allocator2>& b)
+template <typename T1, typename Allocator1, typename Barrier1,
+          typename T2, typename Allocator2, typename Barrier2>
+bool operator==(const traced_ptr<T1, Allocator1, Barrier1>& a,
+                const traced_ptr<T2, Allocator2, Barrier2>& b)
 {
     return a.get() == b.get();
 };
 
-template <typename T1, typename Allocator1,
-          typename T2, typename Allocator2>
-bool operator!=(const traced_ptr<T1, Allocator1>& a,
-                const traced_ptr<T2, Allocator2>& b)
+template <typename T1, typename Allocator1, typename Barrier1,
+          typename T2, typename Allocator2, typename Barrier2>
+bool operator!=(const traced_ptr<T1, Allocator1, Barrier1>& a,
+                const traced_ptr<T2, Allocator2, Barrier2>& b)
 {
     return a.get() != b.get();
 };
 
-template <typename T1, typename Allocator1,
-          typename T2, typename Allocator2>
-bool operator<(const traced_ptr<T1, Allocator1>& a,
-               const traced_ptr<T2, Allocator2>& b)
+template <typename T1, typename Allocator1, typename Barrier1,
+          typename T2, typename Allocator2, typename Barrier2>
+bool operator<(const traced_ptr<T1, Allocator1, Barrier1>& a,
+               const traced_ptr<T2, Allocator2, Barrier2>& b)
 {
     return a.get() < b.get();
 };
 
-template <typename T1, typename Allocator1,
-        typename T2, typename Allocator2>
-bool operator<=(const traced_ptr<T1, Allocator1>& a,
-                const traced_ptr<T2, Allocator2>& b)
+template <typename T1, typename Allocator1, typename Barrier1,
+        typename T2, typename Allocator2, typename Barrier2>
+bool operator<=(const traced_ptr<T1, Allocator1, Barrier1>& a,
+                const traced_ptr<T2, Allocator2, Barrier2>& b)
 {
     return !(b < a);
 };
 
-template <typename T1, typename Allocator1,
-        typename T2, typename Allocator2>
-bool operator>(const traced_ptr<T1, Allocator1>& a,
-               const traced_ptr<T2, Allocator2>& b)
+template <typename T1, typename Allocator1, typename Barrier1,
+        typename T2, typename Allocator2, typename Barrier2>
+bool operator>(const traced_ptr<T1, Allocator1, Barrier1>& a,
+               const traced_ptr<T2, Allocator2, Barrier2>& b)
 {
     return b < a;
 };
 
-template <typename T1, typename Allocator1,
-        typename T2, typename Allocator2>
-bool operator>=(const traced_ptr<T1, Allocator1>& a,
-                const traced_ptr<T2, Allocator2>& b)
+template <typename T1, typename Allocator1, typename Barrier1,
+        typename T2, typename Allocator2, typename Barrier2>
+bool operator>=(const traced_ptr<T1, Allocator1, Barrier1>& a,
+                const traced_ptr<T2, Allocator2, Barrier2>& b)
 {
     return !(a < b);
 };
 
-template <typename T, typename Allocator>
-bool operator==(std::nullptr_t, const traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+bool operator==(std::nullptr_t, const traced_ptr<T, Allocator, Barrier>& b)
 {
     return nullptr == b.get();
 };
 
-template <typename T, typename Allocator>
-bool operator==(const traced_ptr<T, Allocator>& a, std::nullptr_t)
+template <typename T, typename Allocator, typename Barrier>
+bool operator==(const traced_ptr<T, Allocator, Barrier>& a, std::nullptr_t)
 {
     return a.get() == nullptr;
 };
 
-template <typename T, typename Allocator>
-bool operator!=(std::nullptr_t, const traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+bool operator!=(std::nullptr_t, const traced_ptr<T, Allocator, Barrier>& b)
 {
     return nullptr != b.get();
 };
 
-template <typename T, typename Allocator>
-bool operator!=(const traced_ptr<T, Allocator>& a, std::nullptr_t)
+template <typename T, typename Allocator, typename Barrier>
+bool operator!=(const traced_ptr<T, Allocator, Barrier>& a, std::nullptr_t)
 {
     return a.get() != nullptr;
 };
 
-template <typename T, typename Allocator>
-bool operator<(std::nullptr_t, const traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+bool operator<(std::nullptr_t, const traced_ptr<T, Allocator, Barrier>& b)
 {
-    using param = typename traced_ptr<T, Allocator>::pointer;
+    using param = typename traced_ptr<T, Allocator, Barrier>::pointer;
     return std::less<param>()(nullptr, b.get());
 };
 
-template <typename T, typename Allocator>
-bool operator<(const traced_ptr<T, Allocator>& a, std::nullptr_t)
+template <typename T, typename Allocator, typename Barrier>
+bool operator<(const traced_ptr<T, Allocator, Barrier>& a, std::nullptr_t)
 {
-    using param = typename traced_ptr<T, Allocator>::pointer;
+    using param = typename traced_ptr<T, Allocator, Barrier>::pointer;
     return std::less<param>()(a.get(), nullptr);
 };
 
-template <typename T, typename Allocator>
-bool operator<=(std::nullptr_t, const traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+bool operator<=(std::nullptr_t, const traced_ptr<T, Allocator, Barrier>& b)
 {
     return !(b < nullptr);
 };
 
-template <typename T, typename Allocator>
-bool operator<=(const traced_ptr<T, Allocator>& a, std::nullptr_t)
+template <typename T, typename Allocator, typename Barrier>
+bool operator<=(const traced_ptr<T, Allocator, Barrier>& a, std::nullptr_t)
 {
     return !(nullptr < a);
 };
 
-template <typename T, typename Allocator>
-bool operator>(std::nullptr_t, const traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+bool operator>(std::nullptr_t, const traced_ptr<T, Allocator, Barrier>& b)
 {
     return b < nullptr;
 };
 
-template <typename T, typename Allocator>
-bool operator>(const traced_ptr<T, Allocator>& a, std::nullptr_t)
+template <typename T, typename Allocator, typename Barrier>
+bool operator>(const traced_ptr<T, Allocator, Barrier>& a, std::nullptr_t)
 {
     return nullptr < a;
 };
 
-template <typename T, typename Allocator>
-bool operator>=(std::nullptr_t, const traced_ptr<T, Allocator>& b)
+template <typename T, typename Allocator, typename Barrier>
+bool operator>=(std::nullptr_t, const traced_ptr<T, Allocator, Barrier>& b)
 {
     return !(nullptr < b);
 };
 
-template <typename T, typename Allocator>
-bool operator>=(const traced_ptr<T, Allocator>& a, std::nullptr_t)
+template <typename T, typename Allocator, typename Barrier>
+bool operator>=(const traced_ptr<T, Allocator, Barrier>& a, std::nullptr_t)
 {
     return !(a < nullptr);
 };
@@ -0,0 +1,208 @@
+// A gc::vector<T> is a growable array whose storage is a `traced_array<T>`
+// in an `Array_space`, so its buffer is counted in heap statistics and
+// traced as one contiguous run of elements. Copying a vector copies its
+// elements. Elements are destroyed when the buffer is collected, or eagerly
+// by `pop_back`, `clear`, and growing.
+
+#pragma once
+
+#include "forward.h"
+#include "Traceable.h"
+#include "traced_array.h"
+#include "Array_space.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace gc
+{
+
+template <typename T,
+          typename Allocator = std::allocator<Traced_array<T>>>
+class vector
+{
+public:
+    using value_type      = T;
+    using size_type       = size_t;
+    using reference       = T&;
+    using const_reference = const T&;
+    using iterator        = T*;
+    using const_iterator  = const T*;
+
+    vector() = default;
+
+    explicit vector(size_type size, const T& value = T())
+    {
+        reserve(size);
+        while (buffer_.size() < size) buffer_.emplace_back(value);
+    }
+
+    vector(std::initializer_list<T> values)
+    {
+        reserve(values.size());
+        for (const T& value : values) buffer_.emplace_back(value);
+    }
+
+    vector(const vector& other)
+    {
+        reserve(other.size());
+        for (const T& value : other) buffer_.emplace_back(value);
+    }
+
+    vector(vector&& other) noexcept : buffer_{std::move(other.buffer_)}
+    { }
+
+    vector& operator=(const vector& other)
+    {
+        vector copy{other};
+        swap(copy);
+        return *this;
+    }
+
+    vector& operator=(vector&& other) noexcept
+    {
+        buffer_.swap(other.buffer_);
+        return *this;
+    }
+
+    size_type size() const     { return buffer_.size(); }
+    size_type capacity() const { return buffer_.capacity(); }
+    bool empty() const         { return buffer_.empty(); }
+
+    T* data()             { return buffer_.data(); }
+    const T* data() const { return buffer_.data(); }
+
+    T& operator[](size_type i)             { return buffer_[i]; }
+    const T& operator[](size_type i) const { return buffer_[i]; }
+
+    T& at(size_type i)
+    {
+        if (i >= size()) throw std::out_of_range{"gc::vector::at"};
+        return buffer_[i];
+    }
+
+    const T& at(size_type i) const
+    {
+        if (i >= size()) throw std::out_of_range{"gc::vector::at"};
+        return buffer_[i];
+    }
+
+    T& front()             { return buffer_[0]; }
+    const T& front() const { return buffer_[0]; }
+    T& back()              { return buffer_[size() - 1]; }
+    const T& back() const  { return buffer_[size() - 1]; }
+
+    iterator begin()             { return data(); }
+    iterator end()               { return data() + size(); }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const   { return data() + size(); }
+
+    // Makes room for at least `capacity` elements, moving the elements to a
+    // new buffer if necessary.
+    void reserve(size_type capacity)
+    {
+        if (capacity <= this->capacity()) return;
+
+        traced_array<T, Allocator> buffer =
+                reserve_traced_array<T, Allocator>(capacity);
+        for (T& element : buffer_)
+            buffer.emplace_back(std::move_if_noexcept(element));
+
+        // The old buffer stays allocated until it’s collected, but its
+        // elements can go now.
+        buffer_.clear();
+        buffer_ = std::move(buffer);
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (size() < capacity())
+            return buffer_.emplace_back(std::forward<Args>(args)...);
+
+        // The arguments may refer to our own elements, so we construct the
+        // new element before growing.
+        T element(std::forward<Args>(args)...);
+        reserve(std::max(size_type(4), 2 * capacity()));
+        return buffer_.emplace_back(std::move(element));
+    }
+
+    void push_back(const T& value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(T&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    void pop_back()
+    {
+        buffer_.pop_back();
+    }
+
+    void clear()
+    {
+        buffer_.clear();
+    }
+
+    void resize(size_type size, const T& value = T())
+    {
+        while (this->size() > size) pop_back();
+        reserve(size);
+        while (this->size() < size) buffer_.emplace_back(value);
+    }
+
+    void swap(vector& other) noexcept
+    {
+        buffer_.swap(other.buffer_);
+    }
+
+private:
+    friend class Traceable<vector>;
+
+    traced_array<T, Allocator> buffer_;
+};
+
+// The elements are traced when the buffer is, so a vector is just one edge.
+template <typename T, typename Allocator>
+DEFINE_TRACEABLE(vector<T, Allocator>)
+{
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const vector<T, Allocator>& v)
+    {
+        TRACE(v.buffer_);
+    }
+};
+
+// A vector can go in a heap image; its buffer is checked separately (see
+// Heap_image.h).
+template <typename T, typename Allocator>
+struct imageable<vector<T, Allocator>> : std::true_type
+{ };
+
+template <typename T, typename Allocator>
+void swap(vector<T, Allocator>& a, vector<T, Allocator>& b) noexcept
+{
+    a.swap(b);
+};
+
+template <typename T, typename Allocator>
+bool operator==(const vector<T, Allocator>& a, const vector<T, Allocator>& b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+};
+
+template <typename T, typename Allocator>
+bool operator!=(const vector<T, Allocator>& a, const vector<T, Allocator>& b)
+{
+    return !(a == b);
+};
+
+} // end namespace gc
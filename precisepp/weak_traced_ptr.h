@@ -0,0 +1,110 @@
+// A weak_traced_ptr<T> refers to a garbage-collected T without keeping it
+// alive. When a collection finds the object dead, every weak_traced_ptr to it
+// is cleared (before any destructors run).
+
+#pragma once
+
+#include "forward.h"
+#include "Traceable.h"
+#include "Traced.h"
+#include "traced_ptr.h"
+#include "Typed_space.h"
+
+#include <cstddef>
+
+namespace gc
+{
+
+template <typename T, typename Allocator>
+class weak_traced_ptr
+{
+public:
+    using element_type = T;
+
+    weak_traced_ptr() : ptr_{nullptr}, prev_{nullptr}, next_{nullptr}
+    { }
+
+    weak_traced_ptr(std::nullptr_t) : weak_traced_ptr{}
+    { }
+
+    template <typename Barrier>
+    weak_traced_ptr(const traced_ptr<T, Allocator, Barrier>& other)
+            : weak_traced_ptr{}
+    {
+        assign_(other.ptr_);
+    }
+
+    weak_traced_ptr(const weak_traced_ptr& other) : weak_traced_ptr{}
+    {
+        assign_(other.ptr_);
+    }
+
+    template <typename Barrier>
+    weak_traced_ptr& operator=(const traced_ptr<T, Allocator, Barrier>& other)
+    {
+        assign_(other.ptr_);
+        return *this;
+    }
+
+    weak_traced_ptr& operator=(const weak_traced_ptr& other)
+    {
+        assign_(other.ptr_);
+        return *this;
+    }
+
+    ~weak_traced_ptr()
+    {
+        assign_(nullptr);
+    }
+
+    // Returns a strong pointer to the object, or null if it has been
+    // collected.
+    traced_ptr<T, Allocator> lock() const
+    {
+        traced_ptr<T, Allocator> result;
+        result.ptr_ = ptr_;
+        result.inc_();
+        return result;
+    }
+
+    // Whether the object has been collected (or there never was one).
+    bool expired() const
+    {
+        return ptr_ == nullptr;
+    }
+
+    void reset()
+    {
+        assign_(nullptr);
+    }
+
+private:
+    friend class Typed_space<T, Allocator>;
+
+    // Non-null weak pointers are kept on a doubly-linked list in the
+    // `Typed_space` so that they can be cleared.
+    Traced<T>*       ptr_;
+    weak_traced_ptr* prev_;
+    weak_traced_ptr* next_;
+
+    void assign_(Traced<T>* ptr)
+    {
+        if (ptr_ == ptr) return;
+
+        auto& space = Typed_space<T, Allocator>::instance();
+        if (ptr_ != nullptr) space.unlink_weak_(this);
+        ptr_ = ptr;
+        if (ptr_ != nullptr) space.link_weak_(this);
+    }
+};
+
+// A weak pointer is not an edge in the object graph, so there is nothing to
+// trace.
+template <typename T, typename Allocator>
+DEFINE_TRACEABLE(weak_traced_ptr<T, Allocator>)
+{
+    CONTAINS_POINTERS_IF(false);
+    TO_TRACE(const weak_traced_ptr<T, Allocator>&) { }
+};
+
+} // end namespace gc
@@ -0,0 +1,43 @@
+#include "write_barrier.h"
+
+#include <algorithm>
+
+namespace gc
+{
+namespace detail
+{
+
+unsigned char card_table[card_table_size];
+uint32_t heap_map[heap_map_size];
+
+namespace
+{
+
+// Adds `delta` to the entry of each chunk that `[begin, begin + size)`
+// overlaps. (A range longer than the map covers every entry once.)
+void count_heap_range(const void* begin, size_t size, uint32_t delta)
+{
+    if (size == 0) return;
+
+    uintptr_t first  = uintptr_t(begin) >> heap_chunk_shift;
+    uintptr_t last   = (uintptr_t(begin) + size - 1) >> heap_chunk_shift;
+    uintptr_t chunks = std::min(uintptr_t(last - first + 1),
+                                uintptr_t(heap_map_size));
+    for (uintptr_t chunk = first; chunk < first + chunks; ++chunk)
+        heap_map[chunk & (heap_map_size - 1)] += delta;
+}
+
+} // end anonymous namespace
+
+void add_heap_range(const void* begin, size_t size)
+{
+    count_heap_range(begin, size, 1);
+}
+
+void remove_heap_range(const void* begin, size_t size)
+{
+    count_heap_range(begin, size, uint32_t(-1));
+}
+
+} // end namespace detail
+} // end namespace gc
@@ -0,0 +1,79 @@
+// Write barrier policies for `traced_ptr`, chosen by its third template
+// parameter (`no_barrier` by default). A policy’s `write(slot)` runs after
+// the `traced_ptr` at address `slot` is overwritten, by assignment or swap.
+//
+// `card_marking_barrier` records each such write into the heap in the card
+// table, which has a byte for every `card_size` bytes of address space,
+// hashed into a table of fixed size so that the barrier is a shift, a mask,
+// and a store. A clean card means that no barriered pointer in the heap at
+// any address that maps to it has been overwritten since the cards were
+// last cleared; a dirty card means one may have been. This is groundwork
+// for a collection that looks at only part of the heap, which could then
+// rescan just the dirty parts of the rest. Writes outside the heap aren’t
+// recorded, since those pointers are roots, which it reads anyway.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gc
+{
+
+namespace detail
+{
+
+static constexpr size_t card_shift      = 9;
+static constexpr size_t card_size       = size_t(1) << card_shift;
+static constexpr size_t card_table_size = size_t(1) << 20;
+
+extern unsigned char card_table[card_table_size];
+
+inline size_t card_index(const void* addr)
+{
+    return (uintptr_t(addr) >> card_shift) & (card_table_size - 1);
+}
+
+inline void dirty_card(const void* addr)
+{
+    card_table[card_index(addr)] = 1;
+}
+
+// The heap map counts the pages and blocks of the heap that overlap each
+// `heap_chunk_size` bytes of address space, hashed like the cards. A slot
+// outside the heap whose chunk shares an entry with part of the heap still
+// looks like it’s in the heap, which costs only a needlessly dirty card.
+static constexpr size_t heap_chunk_shift = 16;
+static constexpr size_t heap_chunk_size  = size_t(1) << heap_chunk_shift;
+static constexpr size_t heap_map_size    = size_t(1) << 16;
+
+extern uint32_t heap_map[heap_map_size];
+
+inline bool in_heap(const void* addr)
+{
+    return heap_map[(uintptr_t(addr) >> heap_chunk_shift)
+                    & (heap_map_size - 1)] != 0;
+}
+
+// Spaces call these as they add memory to the heap and return it.
+void add_heap_range(const void* begin, size_t size);
+void remove_heap_range(const void* begin, size_t size);
+
+} // end namespace detail
+
+// Does nothing.
+struct no_barrier
+{
+    static void write(const void*) noexcept
+    { }
+};
+
+// Dirties the card of the overwritten pointer, if it’s in the heap.
+struct card_marking_barrier
+{
+    static void write(const void* slot) noexcept
+    {
+        if (detail::in_heap(slot)) detail::dirty_card(slot);
+    }
+};
+
+} // end namespace gc
@@ -1,7 +1,49 @@
+// The standard headers come first, because logger.h defines `log`.
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "precisepp/gc.h"
+#include "precisepp/stl/array.h"
+#include "precisepp/stl/tuple.h"
+#include "precisepp/stl/utility.h"
 #include "linked_list.h"
 
-#include <iostream>
+// The number of failed checks. Each check reports itself and the rest go
+// on, so one run shows everything that’s wrong.
+int failures = 0;
+
+void check(bool ok, const char* what, int line)
+{
+    if (ok) return;
+    std::cerr << "test/main.cpp:" << line << ": check failed: " << what
+              << '\n';
+    ++failures;
+}
+
+#define CHECK(...) check((__VA_ARGS__), #__VA_ARGS__, __LINE__)
 
 void collect()
 {
@@ -29,8 +71,1438 @@ list<int> make_loop(int size) {
     return result;
 }
 
-int main()
+// The length of a list without a loop.
+size_t length(list<int> lst)
+{
+    size_t result = 0;
+    for (; lst; lst = lst->rest) ++result;
+    return result;
+}
+
+// The number of list nodes alive, after a collection.
+size_t live_nodes()
+{
+    gc::Collector::instance().collect();
+    return gc::Typed_space<node<int>>::instance().used_slots();
+}
+
+// A traced array keeps its elements, and what they point to, alive until
+// it’s dropped.
+void test_traced_array()
+{
+    size_t before = live_nodes();
+    {
+        auto lists = gc::make_traced_array<list<int>>(16);
+        for (int i = 0; i < 16; ++i) lists[i] = make_list(i + 1);
+
+        CHECK(live_nodes() == before + 16 * 17 / 2);
+        CHECK(lists.size() == 16);
+        for (int i = 0; i < 16; ++i) {
+            CHECK(length(lists[i]) == size_t(i + 1));
+            CHECK(lists[i]->first == 0);
+        }
+    }
+    CHECK(live_nodes() == before);
+}
+
+// An object too big for a page, which gets a block of its own.
+struct big
+{
+    explicit big(list<int> l) : items{l} { }
+
+    char      bytes[2 * gc::large_object_size];
+    list<int> items;
+};
+
+template <>
+DEFINE_TRACEABLE(big) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const big& b)
+    {
+        TRACE(b.items);
+    }
+};
+
+// Big objects and arrays are freed, and their blocks returned, once they
+// die, and until then they keep what they point to alive.
+void test_large_objects()
+{
+    auto& collector = gc::Collector::instance();
+    auto& bigs      = gc::Typed_space<big>::instance();
+
+    size_t before = live_nodes();
+    size_t freed  = 8 * sizeof(big) + 100'000 * sizeof(long);
+    size_t alive;
+    {
+        std::vector<gc::traced_ptr<big>> objects;
+        for (int i = 0; i < 8; ++i)
+            objects.push_back(gc::make_traced<big>(make_list(10)));
+        auto array = gc::make_traced_array<long>(100'000, 7L);
+
+        CHECK(live_nodes() == before + 80);
+        CHECK(bigs.used_slots() == 8);
+        CHECK(length(objects[7]->items) == 10);
+        CHECK(array.size() == 100'000 && array[99'999] == 7);
+        alive = collector.heap_bytes();
+    }
+    CHECK(live_nodes() == before);
+    CHECK(bigs.used_slots() == 0);
+    CHECK(collector.heap_bytes() + freed <= alive);
+}
+
+// A weak pointer doesn’t keep its object alive, and is cleared when the
+// object is found dead.
+void test_weak_pointers()
+{
+    list<int> kept = make_list(3);
+    gc::weak_traced_ptr<node<int>> to_kept = kept;
+    gc::weak_traced_ptr<node<int>> to_loop = make_loop(5);
+
+    live_nodes();
+    CHECK(!to_kept.expired());
+    CHECK(to_kept.lock() == kept);
+    CHECK(to_loop.expired());
+    CHECK(!to_loop.lock());
+
+    kept = nullptr;
+    live_nodes();
+    CHECK(to_kept.expired());
+}
+
+// Counts its destructions.
+struct counted
+{
+    ~counted()
+    {
+        ++destroyed;
+    }
+
+    static size_t destroyed;
+};
+
+size_t counted::destroyed = 0;
+
+DEFINE_TRACEABLE_UNTRACED_REF(counted)
+
+void make_counted_garbage(int count)
+{
+    while (count--) gc::make_traced<counted>();
+}
+
+// Destructors run while sweeping or just after, or, when deferred, when
+// the program asks or the next collection starts.
+void test_finalization()
+{
+    auto& collector = gc::Collector::instance();
+    collector.collect();
+    counted::destroyed = 0;
+
+    for (auto when : {gc::finalization_t::during_sweep,
+                      gc::finalization_t::after_sweep}) {
+        collector.set_finalization(when);
+        make_counted_garbage(10);
+        CHECK(counted::destroyed == 0);
+        collector.collect();
+        CHECK(counted::destroyed == 10);
+        counted::destroyed = 0;
+    }
+
+    collector.set_finalization(gc::finalization_t::deferred);
+    make_counted_garbage(10);
+    collector.collect();
+    CHECK(counted::destroyed == 0);
+    CHECK(gc::Typed_space<counted>::instance().used_slots() == 10);
+    collector.run_finalizers();
+    CHECK(counted::destroyed == 10);
+    CHECK(gc::Typed_space<counted>::instance().used_slots() == 0);
+
+    make_counted_garbage(10);
+    collector.collect();
+    CHECK(counted::destroyed == 10);
+    collector.collect();
+    CHECK(counted::destroyed == 20);
+
+    collector.set_finalization(gc::finalization_t::during_sweep);
+}
+
+// A gc::vector keeps its elements alive through collections as it grows,
+// and lets go of those it drops.
+void test_vector()
+{
+    size_t before = live_nodes();
+    {
+        gc::vector<list<int>> lists;
+        for (int i = 0; i < 100; ++i) lists.push_back(make_list(3));
+
+        CHECK(live_nodes() == before + 300);
+        CHECK(lists.size() == 100);
+        for (const list<int>& lst : lists) CHECK(length(lst) == 3);
+
+        while (lists.size() > 50) lists.pop_back();
+        CHECK(live_nodes() == before + 150);
+    }
+    CHECK(live_nodes() == before);
+}
+
+// Gives every key the same probe sequence, so that a table fills up a
+// group at a time.
+struct same_hash
+{
+    size_t operator()(int) const
+    {
+        return 0;
+    }
+};
+
+// A gc::hash_map keeps its values alive, and keeps finding them through
+// collections, erasures, and rehashes.
+void test_hash_map()
+{
+    size_t before = live_nodes();
+    {
+        gc::hash_map<int, list<int>> map;
+        for (int key = 0; key < 1000; ++key)
+            map.emplace(key, cons(key, list<int>{}));
+        CHECK(live_nodes() == before + 1000);
+
+        for (int key = 0; key < 1000; key += 2) CHECK(map.erase(key) == 1);
+        CHECK(live_nodes() == before + 500);
+        CHECK(map.size() == 500);
+        for (int key = 0; key < 1000; ++key) {
+            CHECK(map.count(key) == size_t(key % 2));
+            if (key % 2) CHECK(map.at(key)->first == key);
+        }
+
+        // Filling a table’s groups leaves them without empty slots, so
+        // erasing from them leaves deleted ones. The next insertion then
+        // finds the table too full and rehashes it at the same size.
+        gc::hash_map<int, list<int>, same_hash> full;
+        for (int key = 0; key < 112; ++key)
+            full.emplace(key, cons(key, list<int>{}));
+        for (int key = 0; key < 100; ++key) CHECK(full.erase(key) == 1);
+        for (int key = 112; key < 212; ++key)
+            full.emplace(key, cons(key, list<int>{}));
+
+        CHECK(live_nodes() == before + 500 + 112);
+        CHECK(full.size() == 112);
+        for (int key = 0; key < 212; ++key) {
+            CHECK(full.count(key) == size_t(key >= 100));
+            if (key >= 100) CHECK(full.at(key)->first == key);
+        }
+    }
+    CHECK(live_nodes() == before);
+}
+
+// The sweep kernel, whichever the processor gets, agrees with the obvious
+// loop on every length up to two vectors and a bit, so that the vector
+// loops and the scalar tail are all covered, starting at an odd word too.
+void test_sweep_bits()
+{
+    using gc::detail::word_t;
+
+    std::mt19937_64 random{42};
+    for (size_t n = 0; n < 10; ++n) {
+        for (size_t start = 0; start < 2; ++start) {
+            for (int trial = 0; trial < 10; ++trial) {
+                std::vector<word_t> used(n + start), marks(n + start),
+                                    dead(n + start);
+                for (size_t w = 0; w < n + start; ++w) {
+                    used[w]  = random();
+                    marks[w] = random() & used[w];
+                    dead[w]  = random();
+                }
+
+                std::vector<word_t> expected_used  = used,
+                                    expected_marks = marks,
+                                    expected_dead  = dead;
+                for (size_t w = start; w < n + start; ++w) {
+                    expected_dead[w]  = used[w] & ~marks[w];
+                    expected_used[w]  = used[w] & marks[w];
+                    expected_marks[w] = 0;
+                }
+
+                gc::detail::sweep_bits(used.data() + start,
+                                       marks.data() + start,
+                                       dead.data() + start, n);
+                CHECK(used == expected_used);
+                CHECK(marks == expected_marks);
+                CHECK(dead == expected_dead);
+            }
+        }
+    }
+}
+
+// Traced by offset table, with a field the table sees through to a pointer
+// and one it can’t.
+struct inner
+{
+    list<int>            items;
+    gc::vector<list<int>> more;
+};
+
+GC_TRACE_FIELDS(inner, items, more);
+
+// Has pointers in every kind of field an offset table handles.
+struct fielded
+{
+    int                                      key = 0;
+    gc::traced_ptr<fielded>                  next;
+    std::pair<int, list<int>>                pair;
+    std::tuple<list<int>, double, list<int>> tuple;
+    std::array<list<int>, 3>                 array;
+    inner                                    nested;
+    gc::traced_array<list<int>>              lists;
+};
+
+GC_TRACE_FIELDS(fielded, key, next, pair, tuple, array, nested, lists);
+
+// Marking by offset table reaches everything a `GC_TRACE_FIELDS` object
+// points to, however deep in its fields.
+void test_trace_fields()
+{
+    size_t before = live_nodes();
+
+    auto first  = gc::make_traced<fielded>();
+    first->next = gc::make_traced<fielded>();
+    auto& object = *first->next;
+    object.pair.second         = make_list(1);
+    std::get<0>(object.tuple)  = make_list(2);
+    std::get<2>(object.tuple)  = make_list(3);
+    for (int i = 0; i < 3; ++i) object.array[size_t(i)] = make_list(4 + i);
+    object.nested.items        = make_loop(7);
+    object.nested.more.push_back(make_list(8));
+    object.lists               = gc::make_traced_array<list<int>>(2);
+    object.lists[1]            = make_list(9);
+
+    CHECK(live_nodes() == before + 45);
+    CHECK(length(object.pair.second) == 1);
+    CHECK(length(std::get<0>(object.tuple)) == 2);
+    CHECK(length(std::get<2>(object.tuple)) == 3);
+    for (int i = 0; i < 3; ++i)
+        CHECK(length(object.array[size_t(i)]) == size_t(4 + i));
+    CHECK(object.nested.items->rest->first == 1);
+    CHECK(length(object.nested.more[0]) == 8);
+    CHECK(length(object.lists[1]) == 9);
+
+    first = nullptr;
+    CHECK(live_nodes() == before);
+}
+
+// A vertex of a small graph to dump.
+struct vertex
+{
+    gc::traced_ptr<vertex> left;
+    gc::traced_ptr<vertex> right;
+};
+
+template <>
+DEFINE_TRACEABLE(vertex) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const vertex& v)
+    {
+        TRACE(v.left);
+        TRACE(v.right);
+    }
+};
+
+// What a heap dump says about an object.
+struct dumped
+{
+    size_t                 size  = 0;
+    size_t                 refs  = 0;
+    size_t                 roots = 0;
+    std::vector<uintptr_t> edges;
+};
+
+// Reads the objects of the space for `type` from a heap dump, by address.
+std::map<uintptr_t, dumped> read_dump(const std::string& path,
+                                      const std::string& type)
+{
+    std::map<uintptr_t, dumped> result;
+    std::ifstream in{path};
+    std::string   line;
+    bool          wanted = false;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 9, "{\"space\":") == 0) {
+            wanted = line.find("\"type\":\"" + type + "\"") !=
+                     std::string::npos;
+            continue;
+        }
+        if (!wanted) continue;
+
+        unsigned long long address = 0;
+        dumped object;
+        int edges = 0;
+        std::sscanf(line.c_str(),
+                    "{\"object\":%llu,\"space\":%*u,\"size\":%zu,"
+                    "\"refs\":%zu,\"roots\":%zu,\"edges\":[%n",
+                    &address, &object.size, &object.refs, &object.roots,
+                    &edges);
+        CHECK(edges > 0);
+        if (edges == 0) continue;
+        for (const char* p = line.c_str() + edges; *p != ']' && *p != 0; ) {
+            char* end;
+            object.edges.push_back(uintptr_t(std::strtoull(p, &end, 10)));
+            p = *end == ',' ? end + 1 : end;
+        }
+        result[uintptr_t(address)] = object;
+    }
+    return result;
+}
+
+// A dump lists each object with its counts and edges, and
+// precisepp-heap-dominators, which sits beside this program, works out from
+// it what each object keeps alive: here, a root with two children that
+// share a child, which is in a cycle with another.
+void test_heap_dump(const std::string& directory)
+{
+    auto& collector = gc::Collector::instance();
+    collector.collect();
+
+    auto root    = gc::make_traced<vertex>();
+    root->left   = gc::make_traced<vertex>();
+    root->right  = gc::make_traced<vertex>();
+    auto shared  = gc::make_traced<vertex>();
+    root->left->left  = shared;
+    root->right->left = shared;
+    shared->left       = gc::make_traced<vertex>();
+    shared->left->left = shared;
+    shared = nullptr;
+
+    std::string path = "precisepp-test.dump";
+    {
+        std::ofstream out{path};
+        collector.dump_heap(out);
+    }
+    auto objects = read_dump(path, "vertex");
+    CHECK(objects.size() == 5);
+
+    // Find the objects by following the edges from the root.
+    const dumped none;
+    auto object = [&objects, &none](uintptr_t address) -> const dumped& {
+        auto found = objects.find(address);
+        return found == objects.end() ? none : found->second;
+    };
+    auto edge = [&object](uintptr_t from, size_t i) {
+        const dumped& o = object(from);
+        return i < o.edges.size() ? o.edges[i] : 0;
+    };
+
+    uintptr_t r = 0;
+    for (const auto& entry : objects)
+        if (entry.second.roots > 0) {
+            CHECK(r == 0);
+            r = entry.first;
+        }
+    uintptr_t a = edge(r, 0), b = edge(r, 1), s = edge(a, 0), x = edge(s, 0);
+    CHECK(r != 0 && a != 0 && b != 0 && s != 0 && x != 0);
+    CHECK(std::set<uintptr_t>({r, a, b, s, x}).size() == 5);
+
+    CHECK(object(r).roots == 1);
+    CHECK(object(r).refs == 1);
+    CHECK(object(r).edges.size() == 2);
+    CHECK(object(a).edges == std::vector<uintptr_t>{s});
+    CHECK(object(b).edges == std::vector<uintptr_t>{s});
+    CHECK(object(s).edges == std::vector<uintptr_t>{x});
+    CHECK(object(x).edges == std::vector<uintptr_t>{s});
+    CHECK(object(s).refs == 3);
+    for (uintptr_t v : {a, b, x}) CHECK(object(v).refs == 1);
+    for (uintptr_t v : {a, b, s, x}) CHECK(object(v).roots == 0);
+    size_t size = object(r).size;
+    CHECK(size >= sizeof(vertex));
+
+    // The root dominates everything, and the shared child its partner in
+    // the cycle.
+    std::string command = directory + "/precisepp-heap-dominators " + path +
+                          " 1000000";
+    std::FILE* output = popen(command.c_str(), "r");
+    CHECK(output != nullptr);
+    if (output != nullptr) {
+        std::map<uintptr_t, unsigned long long> retained;
+        size_t type_count = 0;
+        unsigned long long type_shallow = 0, type_retained = 0;
+        char line[512];
+        while (std::fgets(line, sizeof line, output) != nullptr) {
+            unsigned long long bytes, address, shallow;
+            size_t count;
+            char   type[256];
+            if (std::sscanf(line, "  %llu\t0x%llx\t%255s", &bytes, &address,
+                            type) == 3) {
+                if (std::string{type} == "vertex")
+                    retained[uintptr_t(address)] = bytes;
+            } else if (std::sscanf(line, "  %zu\t%llu\t%llu\t%255s", &count,
+                                   &shallow, &bytes, type) == 4 &&
+                       std::string{type} == "vertex") {
+                type_count    = count;
+                type_shallow  = shallow;
+                type_retained = bytes;
+            }
+        }
+        int status = pclose(output);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+        CHECK(retained.size() == 5);
+        CHECK(retained[r] == 5 * size);
+        CHECK(retained[a] == size);
+        CHECK(retained[b] == size);
+        CHECK(retained[s] == 2 * size);
+        CHECK(retained[x] == size);
+        CHECK(type_count == 5);
+        CHECK(type_shallow == 5 * size);
+        CHECK(type_retained == 5 * size);
+    }
+
+    std::remove(path.c_str());
+    root = nullptr;
+    collector.collect();
+}
+
+// The samples and sampled deaths in a profiler report, by section (“type”
+// or “call”) and then by the type and tag each line is for.
+using profile_counts =
+        std::map<std::string, std::map<std::string, std::pair<size_t, size_t>>>;
+
+profile_counts read_profile(const std::string& report)
+{
+    profile_counts result;
+    std::istringstream in{report};
+    std::string line, section;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 3, "By ") == 0) {
+            section = line.substr(3, line.find(' ', 3) - 3);
+            continue;
+        }
+        size_t bytes, objects, dead_bytes, samples, deaths;
+        int    name = 0;
+        if (std::sscanf(line.c_str(), "  %zu\t%zu\t%zu\t%zu\t%zu\t%n",
+                        &bytes, &objects, &dead_bytes, &samples, &deaths,
+                        &name) == 5 && name > 0 && !section.empty()) {
+            CHECK(objects == samples);
+            result[section][line.substr(size_t(name))] = {samples, deaths};
+        }
+    }
+    return result;
+}
+
+// With every allocation sampled, the profiler counts allocations and deaths
+// by type and by the tag they were made under.
+void test_allocation_profiler()
+{
+    auto& collector = gc::Collector::instance();
+    auto& profiler  = gc::Allocation_profiler::instance();
+    collector.collect();
+    profiler.reset();
+    profiler.start(1);
+
+    list<int> kept;
+    {
+        gc::Allocation_tag tag{"kept"};
+        kept = make_list(30);
+    }
+    {
+        gc::Allocation_tag tag{"dropped"};
+        make_list(20);
+        make_counted_garbage(10);
+    }
+    make_counted_garbage(5);
+    profiler.stop();
+    collector.collect();
+
+    std::ostringstream report;
+    profiler.report(report);
+    auto counts = read_profile(report.str());
+    using counts_t = std::pair<size_t, size_t>;
+    CHECK(counts["type"].size() == 2);
+    CHECK(counts["type"]["node<int>"] == counts_t(50, 20));
+    CHECK(counts["type"]["counted"] == counts_t(15, 15));
+    CHECK(counts["call"].size() == 4);
+    CHECK(counts["call"]["node<int> [kept]"] == counts_t(30, 0));
+    CHECK(counts["call"]["node<int> [dropped]"] == counts_t(20, 20));
+    CHECK(counts["call"]["counted [dropped]"] == counts_t(10, 10));
+    CHECK(counts["call"]["counted"] == counts_t(5, 5));
+
+    kept = nullptr;
+    profiler.reset();
+    collector.collect();
+}
+
+// Runs `f` in a child process, and returns whether it aborted. What the
+// child writes to std::cerr is thrown away.
+template <typename F>
+bool aborts(F f)
+{
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::freopen("/dev/null", "w", stderr);
+        f();
+        std::_Exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+// Its `Traceable` is missing a TRACE.
+struct forgetful
+{
+    list<int> items;
+};
+
+template <>
+DEFINE_TRACEABLE(forgetful) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const forgetful&)
+    { }
+};
+
+// Its `Traceable` traces the same pointer twice.
+struct repetitive
+{
+    list<int> items;
+};
+
+template <>
+DEFINE_TRACEABLE(repetitive) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const repetitive& r)
+    {
+        TRACE(r.items);
+        TRACE(r.items);
+    }
+};
+
+// A verifying collection passes a sound heap, and aborts on a `Traceable`
+// that misreports its pointers.
+void test_verify()
+{
+    auto& collector = gc::Collector::instance();
+    collector.set_verify(true);
+    size_t before = live_nodes();
+    {
+        list<int> loop = make_loop(100);
+        make_loop(100);
+        CHECK(live_nodes() == before + 100);
+    }
+    CHECK(live_nodes() == before);
+    collector.set_verify(false);
+
+    auto collect_with = [&collector](auto object) {
+        collector.set_verify(true);
+        object->items = make_list(1);
+        collector.collect();
+    };
+
+#ifdef PRECISEPP_ROOT_REGISTRY
+    // Marking misses what only the forgotten pointer reaches.
+    CHECK(aborts([&] { collect_with(gc::make_traced<forgetful>()); }));
+#else
+    // Trial deletion takes the forgotten pointer for a root, which is
+    // harmless, but tracing a pointer twice uncounts it twice.
+    CHECK(!aborts([&] { collect_with(gc::make_traced<forgetful>()); }));
+    CHECK(aborts([&] { collect_with(gc::make_traced<repetitive>()); }));
+#endif
+}
+
+// Immortal objects are never swept, nor is anything they point to, even
+// with nothing else referring to them.
+void test_immortal()
+{
+    auto& collector = gc::Collector::instance();
+    size_t before = live_nodes();
+
+    gc::weak_traced_ptr<node<int>> to_immortal;
+    {
+        list<int> immortal = gc::make_traced_immortal<node<int>>(
+                42, make_list(5));
+        to_immortal = immortal;
+        list<int> mortal = cons(1, immortal);
+        CHECK(live_nodes() == before + 7);
+    }
+
+    collector.set_verify(true);
+    CHECK(live_nodes() == before + 6);
+    CHECK(live_nodes() == before + 6);
+    collector.set_verify(false);
+
+    CHECK(!to_immortal.expired());
+    list<int> immortal = to_immortal.lock();
+    CHECK(immortal->first == 42);
+    CHECK(length(immortal) == 6);
+}
+
+// A node whose link has the card-marking barrier.
+struct carded
+{
+    using link_t = gc::traced_ptr<carded, std::allocator<gc::Traced<carded>>,
+                                  gc::card_marking_barrier>;
+
+    link_t next;
+};
+
+template <>
+DEFINE_TRACEABLE(carded) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const carded& c)
+    {
+        TRACE(c.next);
+    }
+};
+
+// The barrier dirties the cards of pointers stored in the heap, and not
+// of those outside it, which are roots.
+void test_card_marking()
+{
+    using gc::detail::card_table;
+    using gc::detail::card_index;
+
+    carded::link_t first  = gc::make_traced<carded>();
+    carded::link_t second = gc::make_traced<carded>();
+    carded::link_t local;
+
+    std::fill(std::begin(card_table), std::end(card_table), 0);
+    first->next = second;
+    local       = second;
+    CHECK(card_table[card_index(&first->next)] != 0);
+    CHECK(gc::detail::in_heap(&local) ||
+          card_table[card_index(&local)] == 0);
+}
+
+// Its destructor can run on the sweep threads.
+struct leaf
+{
+    explicit leaf(long v) : value{v} { }
+
+    ~leaf()
+    {
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    long value;
+
+    static std::atomic<size_t> destroyed;
+};
+
+std::atomic<size_t> leaf::destroyed{0};
+
+DEFINE_TRACEABLE_UNTRACED_REF(leaf)
+
+namespace gc
+{
+
+template <>
+struct parallel_destructible<leaf> : std::true_type
+{ };
+
+} // end namespace gc
+
+// Sweeping on several threads frees the same objects as sweeping on one.
+void test_parallel_sweep()
+{
+    auto& collector = gc::Collector::instance();
+    auto& leaves    = gc::Typed_space<leaf>::instance();
+
+    for (size_t threads : {1, 4}) {
+        collector.set_sweep_threads(threads);
+        collector.collect();
+        leaf::destroyed = 0;
+
+        std::vector<gc::traced_ptr<leaf>> kept;
+        for (long i = 0; i < 50'000; ++i) {
+            auto object = gc::make_traced<leaf>(i);
+            if (i % 3 == 0) kept.push_back(object);
+        }
+        collector.collect();
+
+        CHECK(leaves.used_slots() == kept.size());
+        CHECK(leaf::destroyed == 50'000 - kept.size());
+        size_t intact = 0;
+        for (size_t i = 0; i < kept.size(); ++i)
+            intact += kept[i]->value == long(3 * i);
+        CHECK(intact == kept.size());
+    }
+
+    collector.set_sweep_threads(1);
+}
+
+// Holds a list, so that its type points to node<int> in the type graph.
+struct holder
+{
+    explicit holder(list<int> l) : items{l} { }
+
+    list<int> items;
+};
+
+template <>
+DEFINE_TRACEABLE(holder) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const holder& h)
+    {
+        TRACE(h.items);
+    }
+};
+
+// A partial collection frees garbage in spaces where no object lost a
+// reference, when only a dead object in a space that did points to it.
+void test_partial()
+{
+    auto& collector = gc::Collector::instance();
+    auto& holders   = gc::Typed_space<holder>::instance();
+    collector.set_partial(true);
+
+    size_t before = live_nodes();
+    auto   h      = gc::make_traced<holder>(make_list(10));
+    CHECK(live_nodes() == before + 10);
+    CHECK(holders.used_slots() == 1);
+
+    // Now only the holder’s space has lost a reference.
+    h = nullptr;
+    CHECK(live_nodes() == before);
+    CHECK(holders.used_slots() == 0);
+
+    collector.set_partial(false);
+}
+
+#ifdef PRECISEPP_BIASED_COUNTS
+
+// Other threads can copy and drop pointers inside shared scopes, and the
+// references they hold keep objects alive; no collection runs while a
+// scope is open.
+void test_biased_counts()
+{
+    auto& collector = gc::Collector::instance();
+    size_t before = live_nodes();
+
+    list<int> shared = make_list(1000);
+    std::vector<list<int>> held(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < held.size(); ++t) {
+        threads.emplace_back([&shared, &held, t] {
+            gc::Shared_scope scope;
+            list<int> lst = shared;
+            for (size_t i = 0; i < 250 * t; ++i) lst = lst->rest;
+            held[t] = lst;
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    threads.clear();
+
+    shared = nullptr;
+    CHECK(live_nodes() == before + 1000);
+    CHECK(held[3]->first == 750);
+
+    {
+        gc::Shared_scope scope;
+        size_t collections = collector.collections();
+        collector.collect();
+        CHECK(collector.collections() == collections);
+    }
+
+    // Dropped on another thread, the head leaves the first quarter dead.
+    std::thread{[&held] {
+        gc::Shared_scope scope;
+        held[0] = nullptr;
+    }}.join();
+    CHECK(live_nodes() == before + 750);
+    held.clear();
+    CHECK(live_nodes() == before);
+}
+
+#endif // PRECISEPP_BIASED_COUNTS
+
+#ifdef PRECISEPP_DEFERRED_COUNTS
+
+// Copies and drops go through the thread’s log, where a copy dropped right
+// away cancels out, and collections see the counts as if they had been
+// applied all along, however many have piled up.
+void test_deferred_counts()
+{
+    auto& log = gc::detail::this_thread_count_log();
+    size_t before = live_nodes();
+
+    list<int> lst = make_list(100);
+    uintptr_t* next = log.next;
+    {
+        list<int> copy = lst;
+    }
+    CHECK(log.next == next);
+
+    std::vector<list<int>> copies(100'000, lst);
+    for (size_t i = 0; i < copies.size(); i += 2) copies[i] = lst->rest;
+    lst = nullptr;
+    CHECK(live_nodes() == before + 100);
+
+    for (size_t i = 1; i < copies.size(); i += 2) copies[i] = nullptr;
+    CHECK(live_nodes() == before + 99);
+    copies.clear();
+    CHECK(live_nodes() == before);
+}
+
+#endif // PRECISEPP_DEFERRED_COUNTS
+
+#ifndef PRECISEPP_ROOT_REGISTRY
+
+namespace gc
+{
+
+template <>
+struct imageable<node<int>> : std::true_type
+{ };
+
+} // end namespace gc
+
+// A root for a heap image, with each kind of thing an image can hold.
+struct imaged
+{
+    list<int>                    items;
+    gc::vector<list<int>>        lists;
+    gc::hash_map<int, list<int>> table;
+};
+
+template <>
+DEFINE_TRACEABLE(imaged) {
+    CONTAINS_POINTERS_IF(true);
+    TO_TRACE(const imaged& i)
+    {
+        TRACE(i.items);
+        TRACE(i.lists);
+        TRACE(i.table);
+    }
+};
+
+namespace gc
+{
+
+template <>
+struct imageable<imaged> : std::true_type
+{ };
+
+} // end namespace gc
+
+// Whether loading the image at `path` as a `T` throws std::runtime_error.
+template <typename T>
+bool image_rejected(const std::string& path)
+{
+    try {
+        gc::load_image<T>(path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Writes `bytes` to the file at `path`.
+void write_file(const std::string& path, const std::string& bytes)
+{
+    std::ofstream out{path, std::ios::binary};
+    out.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+// A graph saved as an image loads back the same, and an image that is cut
+// short, has a root of another type, or has a pointer to the wrong type of
+// object is rejected.
+void test_heap_image()
+{
+    std::string path = "precisepp-test.img";
+
+    auto saved   = gc::make_traced<imaged>();
+    saved->items = make_list(10);
+    for (int i = 0; i < 20; ++i) saved->lists.push_back(make_list(i));
+    for (int i = 0; i < 50; ++i) saved->table.emplace(i, make_list(i));
+    saved->table.erase(7);
+    std::string image;
+    {
+        std::ostringstream out{std::ios::binary};
+        gc::save_image(out, saved);
+        image = out.str();
+    }
+    saved = nullptr;
+    write_file(path, image);
+
+    auto loaded = gc::load_image<imaged>(path);
+    gc::Collector::instance().collect();
+    CHECK(loaded != nullptr);
+    if (loaded != nullptr) {
+        CHECK(length(loaded->items) == 10);
+        CHECK(loaded->items->rest->first == 1);
+        CHECK(loaded->lists.size() == 20);
+        for (int i = 0; i < 20; ++i)
+            CHECK(length(loaded->lists[size_t(i)]) == size_t(i));
+        CHECK(loaded->table.size() == 49);
+        CHECK(loaded->table.find(7) == loaded->table.end());
+        for (int i = 0; i < 50; ++i) {
+            if (i == 7) continue;
+            auto found = loaded->table.find(i);
+            CHECK(found != loaded->table.end() &&
+                  length(found->second) == size_t(i));
+        }
+    }
+
+    CHECK(image_rejected<node<int>>(path));
+
+    write_file(path, image.substr(0, image.size() / 2));
+    CHECK(image_rejected<imaged>(path));
+    write_file(path, image.substr(0, image.size() - 1));
+    CHECK(image_rejected<imaged>(path));
+
+    // Point the first fixup at an object of another type, naming that type
+    // so that only the field’s own type gives it away. The image is 64-bit
+    // words, except for the type names, which aren’t padded.
+    size_t pos  = 0;
+    auto   word = [&image, &pos] {
+        uint64_t result;
+        std::memcpy(&result, &image[pos], sizeof result);
+        pos += sizeof result;
+        return result;
+    };
+    word();   // The magic number
+    for (uint64_t types = word(); types > 0; --types) {
+        pos += size_t(word());
+        word();
+    }
+    std::vector<uint64_t> object_types(static_cast<size_t>(word()));
+    for (uint64_t& type : object_types) {
+        type = word();
+        word();
+    }
+    pos += size_t(word());
+    CHECK(word() > 0);
+    size_t   fixup  = pos;
+    uint64_t target = 0;
+    std::memcpy(&target, &image[fixup + 3 * sizeof target], sizeof target);
+    for (uint64_t other = 0; other < object_types.size(); ++other)
+        if (object_types[other] != object_types[target]) {
+            std::memcpy(&image[fixup + 2 * sizeof other],
+                        &object_types[other], sizeof other);
+            std::memcpy(&image[fixup + 3 * sizeof other], &other,
+                        sizeof other);
+            break;
+        }
+    write_file(path, image);
+    CHECK(image_rejected<imaged>(path));
+
+    std::remove(path.c_str());
+}
+
+#endif // PRECISEPP_ROOT_REGISTRY
+
+#ifdef PRECISEPP_COMPACT_HEADERS
+
+// Each object carries 8 bytes of header, and a count that saturates keeps
+// its real value in the overflow table until it comes back down.
+void test_compact_headers()
+{
+    CHECK(sizeof(gc::Traced<node<int>>) == sizeof(node<int>) + 8);
+
+    using gc::detail::saturated_count;
+    uint32_t count  = saturated_count - 2;
+    long     object = 0;
+
+    for (int i = 0; i < 3; ++i) gc::detail::increment_count(count, &object);
+    CHECK(count == saturated_count);
+    CHECK(gc::detail::count_value(count, &object) ==
+          size_t(saturated_count) + 1);
+
+    for (int i = 0; i < 3; ++i) gc::detail::decrement_count(count, &object);
+    CHECK(count == saturated_count - 2);
+    CHECK(gc::detail::count_value(count, &object) == saturated_count - 2);
+}
+
+#endif // PRECISEPP_COMPACT_HEADERS
+
+// Trivially destructible and without pointers, so swept lazily.
+struct plain
+{
+    long value;
+};
+
+DEFINE_TRACEABLE_UNTRACED_REF(plain)
+
+// A space swept lazily hands out the slots of the dead before it grows,
+// threading them a word of used bits at a time in address order (where an
+// eager sweep would push them on the free list, the other way round), and
+// never a slot still in use; and its count of used slots stays right.
+void test_lazy_sweep()
+{
+    auto& collector = gc::Collector::instance();
+    auto& plains    = gc::Typed_space<plain>::instance();
+    collector.collect();
+
+    std::vector<gc::traced_ptr<plain>> kept;
+    for (long i = 0; i < 1000; ++i) {
+        auto object = gc::make_traced<plain>(plain{i});
+        if (i % 2 == 0) kept.push_back(object);
+    }
+    std::set<const plain*> live;
+    for (const auto& object : kept) live.insert(object.get());
+
+    collector.collect();
+    size_t slots = plains.total_slots();
+    CHECK(plains.used_slots() == 500);
+
+    std::vector<gc::traced_ptr<plain>> reused;
+    while (plains.used_slots() < slots)
+        reused.push_back(gc::make_traced<plain>(plain{-1}));
+    CHECK(plains.total_slots() == slots);
+    CHECK(reused.size() == slots - 500);
+    CHECK(std::is_sorted(reused.begin(), reused.end(),
+                         [](const gc::traced_ptr<plain>& a,
+                            const gc::traced_ptr<plain>& b) {
+                             return a.get() < b.get();
+                         }));
+    for (const auto& object : reused) CHECK(live.count(object.get()) == 0);
+
+    reused.clear();
+    collector.collect();
+    CHECK(plains.used_slots() == 500);
+    for (size_t i = 0; i < kept.size(); ++i)
+        CHECK(kept[i]->value == long(2 * i));
+    for (int i = 0; i < 100; ++i)
+        CHECK(live.count(gc::make_traced<plain>(plain{-1}).get()) == 0);
+    CHECK(plains.total_slots() == slots);
+
+    kept.clear();
+    collector.collect();
+    CHECK(plains.used_slots() == 0);
+}
+
+#ifdef PRECISEPP_ROOT_REGISTRY
+
+// Allocates garbage while it’s being constructed, when no collection can
+// run.
+struct grower
+{
+    explicit grower(int count)
+    {
+        for (int i = 0; i < count; ++i) gc::make_traced<big>(list<int>{});
+    }
+};
+
+DEFINE_TRACEABLE_UNTRACED_REF(grower)
+
+#endif // PRECISEPP_ROOT_REGISTRY
+
+// Under a heap limit, allocation collects before it grows, then calls the
+// limit handler, and throws std::bad_alloc only if that doesn’t help. When
+// no collection can run, it grows past the limit instead.
+void test_heap_limit()
+{
+    auto& collector = gc::Collector::instance();
+    collector.collect();
+    size_t limit = collector.heap_bytes() + 32 * sizeof(big);
+    collector.set_heap_limit(limit);
+
+    size_t calls = 0;
+    std::vector<gc::traced_ptr<big>> hoard;
+    collector.set_limit_handler([&calls](size_t) { ++calls; });
+
+    // Garbage is collected, so there’s always room.
+    for (int i = 0; i < 200; ++i) gc::make_traced<big>(list<int>{});
+    CHECK(calls == 0);
+
+    bool threw = false;
+    try {
+        for (int i = 0; i < 200; ++i)
+            hoard.push_back(gc::make_traced<big>(list<int>{}));
+    } catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(calls > 0);
+    CHECK(hoard.size() < 200);
+    CHECK(collector.heap_bytes() <= limit);
+
+    // A handler that drops references makes room.
+    calls = 0;
+    collector.set_limit_handler([&calls, &hoard](size_t) {
+        ++calls;
+        hoard.clear();
+    });
+    hoard.push_back(gc::make_traced<big>(list<int>{}));
+    CHECK(calls == 1);
+    CHECK(hoard.size() == 1);
+
+    calls = 0;
+    hoard.clear();
+    collector.collect();
+    size_t collections = collector.collections();
+#ifdef PRECISEPP_ROOT_REGISTRY
+    threw = false;
+    try {
+        gc::make_traced<grower>(200);
+    } catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    CHECK(!threw);
+    CHECK(calls == 0);
+    CHECK(collector.collections() == collections);
+#endif
+#ifdef PRECISEPP_BIASED_COUNTS
+    std::promise<void> opened, done;
+    std::thread holder{[&opened, &done] {
+        gc::Shared_scope scope;
+        opened.set_value();
+        done.get_future().wait();
+    }};
+    opened.get_future().wait();
+    threw = false;
+    try {
+        for (int i = 0; i < 200; ++i) gc::make_traced<big>(list<int>{});
+    } catch (const std::bad_alloc&) {
+        threw = true;
+    }
+    done.set_value();
+    holder.join();
+    CHECK(!threw);
+    CHECK(calls == 0);
+    CHECK(collector.collections() == collections);
+#endif
+    (void) collections;
+
+    collector.set_heap_limit(0);
+    collector.set_limit_handler(nullptr);
+    hoard.clear();
+    collector.collect();
+}
+
+#ifdef PRECISEPP_TRACE_RECORDER
+
+// Counts the events of each kind in the trace at `path`, in the format
+// written by Trace_recorder.cpp.
+std::map<gc::detail::Trace_event, size_t> count_events(const std::string& path)
+{
+    using gc::detail::Trace_event;
+
+    std::map<Trace_event, size_t> counts;
+    std::ifstream in{path, std::ios::binary};
+    std::string magic(sizeof gc::detail::trace_magic - 1, '\0');
+    in.read(&magic[0], std::streamsize(magic.size()));
+    if (magic != gc::detail::trace_magic) return counts;
+
+    auto number = [&in] {
+        uint64_t result = 0;
+        int      shift  = 0;
+        int      c;
+        do {
+            c = in.get();
+            result |= uint64_t(c & 0x7f) << shift;
+            shift += 7;
+        } while (c != EOF && (c & 0x80));
+        return result;
+    };
+
+    int c;
+    while ((c = in.get()) != EOF) {
+        auto kind = Trace_event(c);
+        ++counts[kind];
+        switch (kind) {
+        case Trace_event::type:
+            number();
+            in.ignore(std::streamsize(number()));
+            break;
+        case Trace_event::allocate:
+            for (int i = 0; i < 5; ++i) number();
+            break;
+        case Trace_event::deallocate:
+        case Trace_event::clear:
+        case Trace_event::collection:
+            number();
+            break;
+        case Trace_event::store:
+        case Trace_event::move:
+        case Trace_event::swap:
+            number();
+            number();
+            break;
+        case Trace_event::collect:
+            break;
+        default:
+            return counts;
+        }
+    }
+
+    return counts;
+}
+
+// Every object that dies while recording is logged, including those of
+// spaces that would otherwise sweep lazily, and the trace replays through
+// precisepp-replay, which sits beside this program.
+void test_trace_recorder(const std::string& directory)
+{
+    using gc::detail::Trace_event;
+
+    auto& collector = gc::Collector::instance();
+    auto& recorder  = gc::Trace_recorder::instance();
+    std::string path = "precisepp-test.trace";
+
+    collector.collect();
+    recorder.start(path);
+    for (int i = 0; i < 10; ++i) make_loop(100);
+    for (long i = 0; i < 1000; ++i) gc::make_traced<long>(i);
+    collector.collect();
+    recorder.stop();
+
+    auto counts = count_events(path);
+    CHECK(counts[Trace_event::allocate] == 2000);
+    CHECK(counts[Trace_event::deallocate] == 2000);
+    CHECK(counts[Trace_event::collect] == 1);
+    CHECK(counts[Trace_event::collection] == 1);
+
+    std::string command = directory + "/precisepp-replay " + path;
+    std::FILE* output = popen(command.c_str(), "r");
+    CHECK(output != nullptr);
+    if (output != nullptr) {
+        size_t events = 0, allocations = 0, recorded = 0, replayed = 0;
+        char   line[256];
+        while (std::fgets(line, sizeof line, output) != nullptr) {
+            std::sscanf(line, "%zu events, %zu allocations", &events,
+                        &allocations);
+            std::sscanf(line, "recorded: %zu collections", &recorded);
+            std::sscanf(line, "replayed: %zu collections", &replayed);
+        }
+        int status = pclose(output);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        CHECK(allocations == 2000);
+        CHECK(recorded == 1);
+        CHECK(replayed >= 1);
+    }
+
+    std::remove(path.c_str());
+}
+
+#endif // PRECISEPP_TRACE_RECORDER
+
+#ifndef PRECISEPP_ROOT_REGISTRY
+
+// What a region allocates is destroyed when it closes, cycles included,
+// without a collection; what escapes is promoted and lives on. (With a root
+// registry, regions have no effect.)
+void test_region()
+{
+    auto& collector = gc::Collector::instance();
+    auto& nodes     = gc::Typed_space<node<int>>::instance();
+    collector.collect();
+    size_t before      = nodes.used_slots();
+    size_t collections = collector.collections();
+    counted::destroyed = 0;
+
+    gc::weak_traced_ptr<node<int>> to_loop;
+    list<int> kept;
+    {
+        gc::region scratch;
+        make_counted_garbage(100);
+        to_loop = make_loop(100);
+        kept    = make_list(50);
+        CHECK(!to_loop.expired());
+    }
+    CHECK(collector.collections() == collections);
+    CHECK(counted::destroyed == 100);
+    CHECK(to_loop.expired());
+    CHECK(nodes.used_slots() == before + 50);
+    CHECK(length(kept) == 50);
+
+    CHECK(live_nodes() == before + 50);
+    CHECK(length(kept) == 50);
+    kept = nullptr;
+    CHECK(live_nodes() == before);
+}
+
+#endif // PRECISEPP_ROOT_REGISTRY
+
+// An immutable value for interning.
+struct point
 {
+    point(int x, int y) : x{x}, y{y} { }
+
+    bool operator==(const point& other) const
+    {
+        return x == other.x && y == other.y;
+    }
+
+    int x;
+    int y;
+};
+
+namespace std
+{
+
+template <>
+struct hash<point>
+{
+    size_t operator()(const point& p) const
+    {
+        return hash<int>{}(p.x) * 31 + hash<int>{}(p.y);
+    }
+};
+
+} // end namespace std
+
+DEFINE_TRACEABLE_UNTRACED_REF(point)
+
+// Equal interned objects are the same object, and the table forgets the
+// dead ones when they’re swept.
+void test_interning()
+{
+    auto& collector = gc::Collector::instance();
+    auto& points    = gc::Typed_space<point>::instance();
+    collector.collect();
+
+    auto a = gc::make_interned<point>(1, 2);
+    auto b = gc::make_interned<point>(1, 2);
+    auto c = gc::make_interned<point>(2, 1);
+    CHECK(a == b);
+    CHECK(a != c);
+    CHECK(points.interned_size() == 2);
+
+    for (int i = 0; i < 100; ++i) gc::make_interned<point>(i, -1);
+    CHECK(points.interned_size() == 102);
+
+    collector.collect();
+    CHECK(points.interned_size() == 2);
+    CHECK(points.used_slots() == 2);
+    CHECK(gc::make_interned<point>(1, 2) == a);
+    CHECK(gc::make_interned<point>(2, 1) == c);
+
+    a = b = c = nullptr;
+    collector.collect();
+    CHECK(points.interned_size() == 0);
+}
+
+// Cycle collection frees a dead cycle by looking at just the objects
+// reachable from those that lost a reference, without a full collection.
+void test_cycle_collection()
+{
+    auto& collector = gc::Collector::instance();
+    auto& nodes     = gc::Typed_space<node<int>>::instance();
+    size_t before   = live_nodes();
+    collector.set_cycle_collection(true);
+
+    list<int> kept = make_list(10);
+    make_loop(100);
+    make_list(50);
+    CHECK(nodes.used_slots() == before + 160);
+
+    size_t collections = collector.collections();
+    collector.collect_cycles();
+    CHECK(collector.collections() == collections);
+    CHECK(nodes.used_slots() == before + 10);
+    CHECK(length(kept) == 10);
+
+    collector.set_cycle_collection(false);
+    kept = nullptr;
+    CHECK(live_nodes() == before);
+}
+
+int main(int, char* argv[])
+{
+    // The tools are built beside this program.
+    std::string program   = argv[0];
+    auto        slash     = program.rfind('/');
+    std::string directory = slash == std::string::npos
+                                    ? std::string{"."}
+                                    : program.substr(0, slash);
+
     collect();
 
     for (int i = 0; i < 10; ++i) {
@@ -38,4 +1510,47 @@ int main()
     }
 
     collect();
-}
\ No newline at end of file
+
+    test_traced_array();
+    test_large_objects();
+    test_weak_pointers();
+    test_finalization();
+    test_vector();
+    test_hash_map();
+    test_sweep_bits();
+    test_trace_fields();
+    test_heap_dump(directory);
+    test_allocation_profiler();
+    test_verify();
+    test_immortal();
+    test_card_marking();
+    test_parallel_sweep();
+    test_partial();
+#ifdef PRECISEPP_BIASED_COUNTS
+    test_biased_counts();
+#endif
+#ifdef PRECISEPP_DEFERRED_COUNTS
+    test_deferred_counts();
+#endif
+#ifndef PRECISEPP_ROOT_REGISTRY
+    test_heap_image();
+#endif
+#ifdef PRECISEPP_COMPACT_HEADERS
+    test_compact_headers();
+#endif
+    test_lazy_sweep();
+    test_heap_limit();
+#ifdef PRECISEPP_TRACE_RECORDER
+    test_trace_recorder(directory);
+#endif
+#ifndef PRECISEPP_ROOT_REGISTRY
+    test_region();
+#endif
+    test_interning();
+    test_cycle_collection();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+}
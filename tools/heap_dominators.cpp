@@ -0,0 +1,335 @@
+// Reads a heap dump written by `gc::Collector::dump_heap` and reports where
+// the memory is retained: the objects and types with the largest retained
+// sizes, computed from the dominator tree of the object graph.
+//
+// An object’s retained size is the memory that would be freed if it were
+// collected: its own size plus that of every object it dominates (that is,
+// every object only reachable through it). The dominator tree is rooted at
+// a virtual object with an edge to each root.
+//
+// Usage: precisepp-heap-dominators DUMP [TOP]
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// The dump, with objects numbered from 1 (0 is the virtual root), and
+// edges in compressed sparse row form.
+struct Graph
+{
+    std::vector<std::string> type_names;     // By space
+    std::vector<uint64_t>    address{0};     // By object
+    std::vector<uint32_t>    space{0};
+    std::vector<uint64_t>    size{0};
+    std::vector<size_t>      edge_start{0};  // Edges of `v` are
+    std::vector<uint64_t>    edge_target;    // [edge_start[v], edge_start[v+1])
+};
+
+// Minimal parsing of our own one-object-per-line JSON.
+
+bool find_key(const std::string& line, const char* key, size_t& pos)
+{
+    std::string pattern = std::string{"\""} + key + "\":";
+    size_t found = line.find(pattern);
+    if (found == std::string::npos) return false;
+    pos = found + pattern.size();
+    return true;
+}
+
+uint64_t number_at(const std::string& line, size_t& pos)
+{
+    uint64_t result = 0;
+    while (pos < line.size() && line[pos] >= '0' && line[pos] <= '9')
+        result = result * 10 + uint64_t(line[pos++] - '0');
+    return result;
+}
+
+uint64_t number_field(const std::string& line, const char* key)
+{
+    size_t pos;
+    return find_key(line, key, pos) ? number_at(line, pos) : 0;
+}
+
+std::string string_field(const std::string& line, const char* key)
+{
+    size_t pos;
+    std::string result;
+    if (!find_key(line, key, pos) || line[pos] != '"') return result;
+    for (++pos; pos < line.size() && line[pos] != '"'; ++pos) {
+        if (line[pos] == '\\') ++pos;
+        result += line[pos];
+    }
+    return result;
+}
+
+Graph read_dump(std::istream& in)
+{
+    Graph g;
+    std::vector<size_t> roots;
+    std::string line;
+
+    while (std::getline(in, line)) {
+        size_t pos;
+        if (find_key(line, "object", pos)) {
+            size_t v = g.address.size();
+            g.address.push_back(number_at(line, pos));
+            g.space.push_back(uint32_t(number_field(line, "space")));
+            g.size.push_back(number_field(line, "size"));
+            if (number_field(line, "roots") > 0) roots.push_back(v);
+
+            if (find_key(line, "edges", pos)) {
+                ++pos;  // '['
+                while (pos < line.size() && line[pos] != ']') {
+                    g.edge_target.push_back(number_at(line, pos));
+                    if (line[pos] == ',') ++pos;
+                }
+            }
+            g.edge_start.push_back(g.edge_target.size());
+        } else if (find_key(line, "space", pos)) {
+            std::string name = string_field(line, "type");
+            if (string_field(line, "kind") == "array") name += "[]";
+            g.type_names.push_back(name);
+        }
+    }
+
+    // Resolve edge addresses to object numbers. Edges to unknown addresses
+    // (which shouldn’t happen) point to the virtual root, and are ignored.
+    std::unordered_map<uint64_t, uint64_t> index;
+    index.reserve(g.address.size());
+    for (size_t v = 1; v < g.address.size(); ++v)
+        index.emplace(g.address[v], v);
+    for (uint64_t& target : g.edge_target) {
+        auto found = index.find(target);
+        target = found == index.end() ? 0 : found->second;
+    }
+
+    // The virtual root’s edges go last, so its edge range is special-cased
+    // by `successors`.
+    g.edge_start.push_back(g.edge_target.size());
+    for (size_t r : roots) g.edge_target.push_back(r);
+    g.edge_start.push_back(g.edge_target.size());
+
+    return g;
+}
+
+template <typename F>
+void successors(const Graph& g, size_t v, F f)
+{
+    size_t n     = g.address.size();
+    size_t begin = v == 0 ? g.edge_start[n] : g.edge_start[v - 1];
+    size_t end   = v == 0 ? g.edge_start[n + 1] : g.edge_start[v];
+    for (size_t e = begin; e < end; ++e)
+        if (g.edge_target[e] != 0) f(size_t(g.edge_target[e]));
+}
+
+const size_t none = size_t(-1);
+
+struct Dominators
+{
+    std::vector<size_t> order;  // Reachable objects in reverse postorder
+    std::vector<size_t> rpo;    // Position of each object in `order`
+    std::vector<size_t> idom;   // Immediate dominator, or `none`
+};
+
+// The iterative algorithm of Cooper, Harvey and Kennedy, “A Simple, Fast
+// Dominance Algorithm”.
+Dominators dominators(const Graph& g)
+{
+    size_t n = g.address.size();
+    Dominators d;
+    d.rpo.assign(n, none);
+    d.idom.assign(n, none);
+
+    // Postorder by iterative DFS.
+    std::vector<size_t> postorder;
+    std::vector<bool> seen(n, false);
+    std::vector<std::pair<size_t, std::vector<size_t>>> stack;
+    auto push = [&](size_t v) {
+        seen[v] = true;
+        std::vector<size_t> next;
+        successors(g, v, [&](size_t w) { next.push_back(w); });
+        stack.emplace_back(v, std::move(next));
+    };
+    push(0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        if (top.second.empty()) {
+            postorder.push_back(top.first);
+            stack.pop_back();
+        } else {
+            size_t w = top.second.back();
+            top.second.pop_back();
+            if (!seen[w]) push(w);
+        }
+    }
+
+    d.order.assign(postorder.rbegin(), postorder.rend());
+    for (size_t i = 0; i < d.order.size(); ++i) d.rpo[d.order[i]] = i;
+
+    // Predecessors, restricted to reachable objects.
+    std::vector<size_t> pred_start(n + 1, 0), preds;
+    for (size_t v : d.order)
+        successors(g, v, [&](size_t w) { ++pred_start[w + 1]; });
+    for (size_t v = 0; v < n; ++v) pred_start[v + 1] += pred_start[v];
+    preds.resize(pred_start[n]);
+    std::vector<size_t> fill(pred_start.begin(), pred_start.end() - 1);
+    for (size_t v : d.order)
+        successors(g, v, [&](size_t w) { preds[fill[w]++] = v; });
+
+    auto intersect = [&](size_t a, size_t b) {
+        while (a != b) {
+            while (d.rpo[a] > d.rpo[b]) a = d.idom[a];
+            while (d.rpo[b] > d.rpo[a]) b = d.idom[b];
+        }
+        return a;
+    };
+
+    d.idom[0] = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t i = 1; i < d.order.size(); ++i) {
+            size_t v = d.order[i];
+            size_t new_idom = none;
+            for (size_t p = pred_start[v]; p < pred_start[v + 1]; ++p) {
+                size_t u = preds[p];
+                if (d.idom[u] == none) continue;
+                new_idom = new_idom == none ? u : intersect(u, new_idom);
+            }
+            if (d.idom[v] != new_idom) {
+                d.idom[v] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    return d;
+}
+
+std::string type_of(const Graph& g, size_t v)
+{
+    return g.space[v] < g.type_names.size() ? g.type_names[g.space[v]]
+                                            : "?";
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " DUMP [TOP]\n";
+        return 2;
+    }
+
+    std::ifstream in{argv[1]};
+    if (!in) {
+        std::cerr << argv[0] << ": cannot open " << argv[1] << '\n';
+        return 1;
+    }
+    size_t top = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+
+    Graph      g = read_dump(in);
+    Dominators d = dominators(g);
+    size_t     n = g.address.size();
+
+    // Retained sizes, children before parents.
+    std::vector<uint64_t> retained(n, 0);
+    for (size_t i = d.order.size(); i-- > 1; ) {
+        size_t v = d.order[i];
+        retained[v] += g.size[v];
+        retained[d.idom[v]] += retained[v];
+    }
+
+    uint64_t total = 0, unreachable = 0;
+    for (size_t v = 1; v < n; ++v) {
+        total += g.size[v];
+        if (d.rpo[v] == none) unreachable += g.size[v];
+    }
+
+    std::cout << n - 1 << " objects, " << total << " bytes; "
+              << unreachable << " bytes unreachable\n\n";
+
+    // The objects with the largest retained sizes.
+    std::vector<size_t> objects(d.order.begin() + 1, d.order.end());
+    size_t shown = std::min(top, objects.size());
+    std::partial_sort(objects.begin(), objects.begin() + shown, objects.end(),
+                      [&](size_t a, size_t b) {
+                          return retained[a] > retained[b];
+                      });
+    std::cout << "Largest retained sizes by object:\n";
+    for (size_t i = 0; i < shown; ++i) {
+        size_t v = objects[i];
+        std::cout << "  " << retained[v] << "\t0x" << std::hex << g.address[v]
+                  << std::dec << '\t' << type_of(g, v) << '\n';
+    }
+
+    // By type: an object’s retained size counts toward its type unless it’s
+    // dominated by another object of the same type, which counts it
+    // already. Walk the dominator tree keeping count of the types of the
+    // objects on the path from the root.
+    struct Type_stats { uint64_t count = 0, shallow = 0, retained = 0; };
+    std::vector<Type_stats> by_type(g.type_names.size() + 1);
+    std::vector<size_t>     on_path(g.type_names.size() + 1, 0);
+
+    std::vector<size_t> child_start(n + 1, 0), children;
+    for (size_t i = 1; i < d.order.size(); ++i)
+        ++child_start[d.idom[d.order[i]] + 1];
+    for (size_t v = 0; v < n; ++v) child_start[v + 1] += child_start[v];
+    children.resize(child_start[n]);
+    std::vector<size_t> fill(child_start.begin(), child_start.end() - 1);
+    for (size_t i = 1; i < d.order.size(); ++i) {
+        size_t v = d.order[i];
+        children[fill[d.idom[v]]++] = v;
+    }
+
+    auto type_index = [&](size_t v) {
+        return std::min(size_t(g.space[v]), g.type_names.size());
+    };
+
+    std::vector<std::pair<size_t, bool>> stack{{0, true}};
+    while (!stack.empty()) {
+        size_t v     = stack.back().first;
+        bool   enter = stack.back().second;
+        stack.pop_back();
+        if (v != 0) {
+            Type_stats& stats = by_type[type_index(v)];
+            if (enter) {
+                ++stats.count;
+                stats.shallow += g.size[v];
+                if (on_path[type_index(v)]++ == 0)
+                    stats.retained += retained[v];
+            } else {
+                --on_path[type_index(v)];
+                continue;
+            }
+        } else if (!enter) {
+            continue;
+        }
+        stack.emplace_back(v, false);
+        for (size_t c = child_start[v]; c < child_start[v + 1]; ++c)
+            stack.emplace_back(children[c], true);
+    }
+
+    std::vector<size_t> types;
+    for (size_t t = 0; t < by_type.size(); ++t)
+        if (by_type[t].count > 0) types.push_back(t);
+    std::sort(types.begin(), types.end(), [&](size_t a, size_t b) {
+        return by_type[a].retained > by_type[b].retained;
+    });
+
+    std::cout << "\nRetained size by type (count, shallow, retained):\n";
+    for (size_t i = 0; i < std::min(top, types.size()); ++i) {
+        size_t t = types[i];
+        std::cout << "  " << by_type[t].count << '\t' << by_type[t].shallow
+                  << '\t' << by_type[t].retained << '\t'
+                  << (t < g.type_names.size() ? g.type_names[t] : "?")
+                  << '\n';
+    }
+}
@@ -0,0 +1,492 @@
+// Replays a trace written by `gc::Trace_recorder` (see
+// precisepp/Trace_recorder.h) against the collector, under the policies
+// given on the command line, and reports the collections it took, their
+// pauses, and the peak size of the heap, beside those of the recorded run.
+//
+// Each recorded object is replayed as an object holding an array of
+// traced pointers, one for each word of the original, so the replayed heap
+// has the same shape and size, though each object costs an extra header
+// and all of them share one space. Slots outside every live object are
+// roots. Collections happen as they would in a program making the same
+// allocations, except that calls to `collect` are replayed too.
+//
+// The replay has to be built with the same modes as the recorded program,
+// so that addresses within objects mean the same. Objects allocated before
+// recording started are unknown to the replay, and pointers to them are
+// replayed as null.
+//
+// Usage: precisepp-replay [OPTION]... TRACE
+//
+//     --partial                  collect partially (Collector::set_partial)
+//     --finalization=WHEN        during_sweep, after_sweep or deferred
+//     --sweep-threads=N          (Collector::set_sweep_threads)
+//     --heap-limit=BYTES         (Collector::set_heap_limit)
+//     --soft-heap-limit=BYTES    (Collector::set_soft_heap_limit)
+//     --verify                   verify the heap in each collection
+//     --ignore-collect           don’t replay calls to `collect`
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "precisepp/gc.h"
+#include "precisepp/Trace_recorder.h"
+
+namespace
+{
+
+struct Replay_object;
+
+using Replay_ptr = gc::traced_ptr<Replay_object>;
+
+struct Replay_object
+{
+    explicit Replay_object(size_t words)
+    {
+        if (words > 0) fields = gc::make_traced_array<Replay_ptr>(words);
+    }
+
+    gc::traced_array<Replay_ptr> fields;
+};
+
+} // end anonymous namespace
+
+template <>
+DEFINE_TRACEABLE(Replay_object)
+{
+    CONTAINS_POINTERS_IF(true);
+
+    TO_TRACE(const Replay_object& object)
+    {
+        TRACE(object.fields);
+    }
+};
+
+namespace
+{
+
+using gc::detail::Trace_event;
+
+// Reads a trace through a buffer.
+class Trace_reader
+{
+public:
+    explicit Trace_reader(std::FILE* file) : file_{file}
+    { }
+
+    // Reads the next event kind, returning false at the end of the trace.
+    bool event(Trace_event& kind)
+    {
+        int c = byte_();
+        if (c == EOF) return false;
+        kind = Trace_event(c);
+        return true;
+    }
+
+    uint64_t number()
+    {
+        uint64_t result = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            int c = byte_();
+            if (c == EOF) truncated_();
+            result |= uint64_t(c & 0x7f) << shift;
+            if ((c & 0x80) == 0) return result;
+        }
+        throw std::runtime_error{"bad number in trace"};
+    }
+
+    uintptr_t address()
+    {
+        uint64_t zigzag = number();
+        last_address_ += uintptr_t((zigzag >> 1) ^ (0 - (zigzag & 1)));
+        return last_address_;
+    }
+
+    std::string bytes(size_t count)
+    {
+        std::string result;
+        for (size_t i = 0; i < count; ++i) {
+            int c = byte_();
+            if (c == EOF) truncated_();
+            result += char(c);
+        }
+        return result;
+    }
+
+private:
+    std::FILE*                  file_;
+    std::vector<unsigned char>  buffer_ = std::vector<unsigned char>(65536);
+    size_t                      next_ = 0;
+    size_t                      end_ = 0;
+    uintptr_t                   last_address_ = 0;
+
+    int byte_()
+    {
+        if (next_ == end_) {
+            next_ = 0;
+            end_  = std::fread(buffer_.data(), 1, buffer_.size(), file_);
+            if (end_ == 0) return EOF;
+        }
+        return buffer_[next_++];
+    }
+
+    [[noreturn]] static void truncated_()
+    {
+        throw std::runtime_error{"trace is truncated"};
+    }
+};
+
+// Pause times, in nanoseconds.
+struct Pauses
+{
+    std::vector<uint64_t> times;
+
+    void add(uint64_t ns)
+    {
+        times.push_back(ns);
+    }
+
+    void report(std::ostream& out, const char* what)
+    {
+        out << what << ": " << times.size() << " collections";
+        if (times.empty()) {
+            out << '\n';
+            return;
+        }
+
+        std::sort(times.begin(), times.end());
+        uint64_t total = 0;
+        for (uint64_t t : times) total += t;
+        auto ms = [](uint64_t ns) { return double(ns) / 1e6; };
+        auto at = [this](double q) {
+            return times[std::min(times.size() - 1,
+                                  size_t(q * double(times.size())))];
+        };
+
+        out << ", pauses " << ms(total) << " ms in all; mean "
+            << ms(total / times.size()) << ", median " << ms(at(0.5))
+            << ", 99th percentile " << ms(at(0.99)) << ", max "
+            << ms(times.back()) << " ms\n";
+    }
+};
+
+// The recorded objects that are live, by address, and the roots, by slot.
+class Replay
+{
+public:
+    // Replays one event.
+    void event(Trace_event kind, Trace_reader& in)
+    {
+        switch (kind) {
+        case Trace_event::type: {
+            uint64_t index = in.number();
+            std::string name = in.bytes(size_t(in.number()));
+            if (index >= types_.size()) types_.resize(size_t(index) + 1);
+            types_[size_t(index)] = name;
+            break;
+        }
+
+        case Trace_event::allocate: {
+            in.number();   // The type
+            uintptr_t address  = in.address();
+            uint64_t  header   = in.number();
+            uint64_t  bytes    = in.number();
+            bool      immortal = in.number() != 0;
+            allocate_(address, uintptr_t(address + header), size_t(bytes),
+                      immortal);
+            break;
+        }
+
+        case Trace_event::deallocate: {
+            uintptr_t address = in.address();
+            objects_.erase(address);
+            pending_.erase(address);
+            break;
+        }
+
+        case Trace_event::store: {
+            uintptr_t slot   = in.address();
+            uintptr_t target = in.address();
+            store_(slot, target);
+            break;
+        }
+
+        case Trace_event::clear:
+            clear_(in.address());
+            break;
+
+        case Trace_event::move: {
+            uintptr_t from = in.address();
+            uintptr_t to   = in.address();
+            move_(from, to);
+            break;
+        }
+
+        case Trace_event::swap: {
+            uintptr_t slot1 = in.address();
+            uintptr_t slot2 = in.address();
+            swap_(slot1, slot2);
+            break;
+        }
+
+        case Trace_event::collect:
+            if (!ignore_collect) gc::Collector::instance().collect();
+            break;
+
+        case Trace_event::collection:
+            recorded.add(in.number());
+            break;
+
+        default:
+            throw std::runtime_error{"bad event in trace"};
+        }
+    }
+
+    bool     ignore_collect = false;
+    Pauses   recorded;
+    size_t   allocations = 0;
+    uint64_t allocated_bytes = 0;
+    size_t   unknown_targets = 0;   // Stores of objects we never saw
+
+    size_t types() const
+    {
+        return types_.size();
+    }
+
+private:
+    struct Object
+    {
+        uintptr_t elements;
+        size_t    bytes;
+        gc::weak_traced_ptr<Replay_object> object;
+    };
+
+    std::vector<std::string>                types_;
+    std::map<uintptr_t, Object>             objects_;   // By address
+    std::unordered_map<uintptr_t, Replay_ptr> roots_;   // By slot
+
+    // Objects that nothing points to yet. An object is allocated before
+    // its constructor runs, so it has to be kept alive until it’s stored.
+    std::unordered_map<uintptr_t, Replay_ptr> pending_;
+
+    void allocate_(uintptr_t address, uintptr_t elements, size_t bytes,
+                   bool immortal)
+    {
+        size_t words = (bytes + sizeof(void*) - 1) / sizeof(void*);
+        Replay_ptr object =
+                immortal ? gc::make_traced_immortal<Replay_object>(words)
+                         : gc::make_traced<Replay_object>(words);
+
+        Object& entry = objects_[address];
+        entry.elements = elements;
+        entry.bytes    = bytes;
+        entry.object   = object;
+        pending_[address] = std::move(object);
+
+        ++allocations;
+        allocated_bytes += bytes;
+    }
+
+    // The replayed object at `address`, or null if there isn’t one.
+    Replay_ptr object_(uintptr_t address) const
+    {
+        auto found = objects_.find(address);
+        return found == objects_.end() ? Replay_ptr{}
+                                       : found->second.object.lock();
+    }
+
+    // The replayed pointer for `slot`: a field if the slot lies in a live
+    // object, or else a root, which is added if `add` is true. Null if
+    // there isn’t one.
+    Replay_ptr* slot_(uintptr_t slot, bool add)
+    {
+        auto found = objects_.upper_bound(slot);
+        if (found != objects_.begin()) {
+            const Object& entry = (--found)->second;
+            if (slot >= entry.elements && slot < entry.elements + entry.bytes) {
+                Replay_ptr object = entry.object.lock();
+                if (!object) return nullptr;
+                return &object->fields[(slot - entry.elements) / sizeof(void*)];
+            }
+        }
+
+        if (add) return &roots_[slot];
+        auto root = roots_.find(slot);
+        return root == roots_.end() ? nullptr : &root->second;
+    }
+
+    // Forgets a root slot once it’s null.
+    void prune_(uintptr_t slot)
+    {
+        auto root = roots_.find(slot);
+        if (root != roots_.end() && !root->second) roots_.erase(root);
+    }
+
+    void store_(uintptr_t slot, uintptr_t target)
+    {
+        Replay_ptr object = object_(target);
+        if (!object) ++unknown_targets;
+
+        if (Replay_ptr* ptr = slot_(slot, bool(object))) *ptr = object;
+        pending_.erase(target);
+        prune_(slot);
+    }
+
+    void clear_(uintptr_t slot)
+    {
+        if (Replay_ptr* ptr = slot_(slot, false)) *ptr = nullptr;
+        prune_(slot);
+    }
+
+    void move_(uintptr_t from, uintptr_t to)
+    {
+        Replay_ptr* to_ptr   = slot_(to, true);
+        Replay_ptr* from_ptr = slot_(from, false);
+        if (to_ptr != nullptr) {
+            if (from_ptr != nullptr)
+                *to_ptr = std::move(*from_ptr);
+            else
+                *to_ptr = nullptr;
+        }
+        prune_(from);
+        prune_(to);
+    }
+
+    void swap_(uintptr_t slot1, uintptr_t slot2)
+    {
+        Replay_ptr* ptr1 = slot_(slot1, true);
+        Replay_ptr* ptr2 = slot_(slot2, true);
+        if (ptr1 != nullptr && ptr2 != nullptr) ptr1->swap(*ptr2);
+        prune_(slot1);
+        prune_(slot2);
+    }
+};
+
+[[noreturn]] void usage(const char* program)
+{
+    std::cerr << "usage: " << program << " [--partial]"
+              << " [--finalization=during_sweep|after_sweep|deferred]"
+              << " [--sweep-threads=N] [--heap-limit=BYTES]"
+              << " [--soft-heap-limit=BYTES] [--verify] [--ignore-collect]"
+              << " TRACE\n";
+    std::exit(2);
+}
+
+// Whether `arg` is `option`, followed by `=value` if `value` isn’t null.
+bool option(const char* arg, const char* option, const char** value)
+{
+    size_t length = std::strlen(option);
+    if (std::strncmp(arg, option, length) != 0) return false;
+    if (value == nullptr) return arg[length] == '\0';
+    if (arg[length] != '=') return false;
+    *value = arg + length + 1;
+    return true;
+}
+
+} // end anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    auto& collector = gc::Collector::instance();
+    Replay replay;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value;
+        if (option(arg, "--partial", nullptr))
+            collector.set_partial(true);
+        else if (option(arg, "--verify", nullptr))
+            collector.set_verify(true);
+        else if (option(arg, "--ignore-collect", nullptr))
+            replay.ignore_collect = true;
+        else if (option(arg, "--sweep-threads", &value))
+            collector.set_sweep_threads(std::strtoul(value, nullptr, 10));
+        else if (option(arg, "--heap-limit", &value))
+            collector.set_heap_limit(std::strtoull(value, nullptr, 10));
+        else if (option(arg, "--soft-heap-limit", &value))
+            collector.set_soft_heap_limit(std::strtoull(value, nullptr, 10));
+        else if (option(arg, "--finalization", &value)) {
+            std::string when = value;
+            if (when == "during_sweep")
+                collector.set_finalization(gc::finalization_t::during_sweep);
+            else if (when == "after_sweep")
+                collector.set_finalization(gc::finalization_t::after_sweep);
+            else if (when == "deferred")
+                collector.set_finalization(gc::finalization_t::deferred);
+            else
+                usage(argv[0]);
+        } else if (arg[0] == '-' || path != nullptr)
+            usage(argv[0]);
+        else
+            path = arg;
+    }
+    if (path == nullptr) usage(argv[0]);
+
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        std::cerr << argv[0] << ": cannot open " << path << '\n';
+        return 1;
+    }
+
+    Trace_reader in{file};
+    Pauses       replayed;
+    size_t       events = 0, peak_heap = 0;
+    size_t       collections = collector.collections();
+    int          status = 0;
+    auto         start = std::chrono::steady_clock::now();
+
+    try {
+        size_t magic_size = sizeof gc::detail::trace_magic - 1;
+        if (in.bytes(magic_size) !=
+                std::string{gc::detail::trace_magic, magic_size})
+            throw std::runtime_error{"not a trace"};
+
+        Trace_event kind;
+        while (in.event(kind)) {
+            replay.event(kind, in);
+            ++events;
+
+            if (collector.collections() != collections) {
+                collections = collector.collections();
+                replayed.add(uint64_t(collector.last_pause().count()));
+            }
+            if (kind == Trace_event::allocate)
+                peak_heap = std::max(peak_heap, collector.heap_bytes());
+        }
+    } catch (const std::bad_alloc&) {
+        std::cerr << argv[0] << ": out of memory after " << events
+                  << " events\n";
+        status = 1;
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << path << ": " << e.what() << '\n';
+        status = 1;
+    }
+    std::fclose(file);
+
+    double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+    std::cout << events << " events, " << replay.allocations
+              << " allocations of " << replay.types() << " types ("
+              << replay.allocated_bytes << " bytes)\n";
+    replay.recorded.report(std::cout, "recorded");
+    replayed.report(std::cout, "replayed");
+    std::cout << "peak heap " << peak_heap << " bytes; replay took "
+              << seconds << " s\n";
+    if (replay.unknown_targets > 0)
+        std::cout << replay.unknown_targets
+                  << " pointers to objects allocated before recording\n";
+
+    return status;
+}